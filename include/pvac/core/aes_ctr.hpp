@@ -0,0 +1,291 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "cpu.hpp"
+
+#if defined(__AES__) && defined(__SSE2__)
+#include <wmmintrin.h>
+#include <emmintrin.h>
+#define PVAC_USE_AESNI 1
+#else
+#define PVAC_USE_AESNI 0
+#endif
+
+#if PVAC_USE_AESNI && defined(__VAES__) && defined(__AVX512F__)
+#include <immintrin.h>
+#define PVAC_USE_VAES 1
+#else
+#define PVAC_USE_VAES 0
+#endif
+
+namespace pvac {
+
+#if PVAC_USE_AESNI
+
+// whole-block keystream paths behind fill_u64, all give the same stream
+enum class AesImpl { X1, X8, VAES };
+
+namespace aes_detail {
+    inline const char * const NAMES[3] = {"x1", "x8", "vaes"};
+
+    inline void avail(bool ok[3]) {
+        const CpuFeatures & f = cpu_features();
+        ok[0] = true;
+        ok[1] = true;
+        ok[2] = PVAC_USE_VAES && f.vaes && f.avx512f;
+    }
+
+    inline AesImpl pick() {
+        bool ok[3];
+        avail(ok);
+        return (AesImpl)impl_pick("aes", NAMES, ok, 3, ok[2] ? 2 : 1);
+    }
+}
+
+inline AesImpl aes_impl() {
+    static const AesImpl impl = aes_detail::pick();
+    return impl;
+}
+
+inline const char * aes_impl_name() {
+    return aes_detail::NAMES[(int)aes_impl()];
+}
+
+inline std::string aes_impl_avail() {
+    bool ok[3];
+    aes_detail::avail(ok);
+    return impl_avail_list(aes_detail::NAMES, ok, 3);
+}
+
+inline const bool g_aes_impl_reg = impl_register("aes", &aes_impl_name, &aes_impl_avail);
+
+struct AesCtr256 {
+    __m128i rk[15];
+    __m128i ctr;
+    alignas(16) uint64_t buf[2] = {0, 0};
+    bool has_buf = false;
+
+    static inline __m128i key_expand(__m128i k, __m128i t) {
+        t = _mm_shuffle_epi32(t, 0xFF);
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+        return _mm_xor_si128(k, t);
+    }
+
+    static inline __m128i key_expand2(__m128i k1, __m128i k2) {
+        __m128i t = _mm_aeskeygenassist_si128(k2, 0);
+        t = _mm_shuffle_epi32(t, 0xAA);
+        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+        return _mm_xor_si128(k1, t);
+    }
+
+    void init(const uint8_t key[32], uint64_t nonce) {
+        __m128i k0 = _mm_loadu_si128((const __m128i*)key);
+        __m128i k1 = _mm_loadu_si128((const __m128i*)(key + 16));
+
+        rk[0] = k0;
+        rk[1] = k1;
+        rk[2] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x01)); k0 = rk[2];
+        rk[3] = key_expand2(k1, k0); k1 = rk[3];
+        rk[4] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x02)); k0 = rk[4];
+        rk[5] = key_expand2(k1, k0); k1 = rk[5];
+        rk[6] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x04)); k0 = rk[6];
+        rk[7] = key_expand2(k1, k0); k1 = rk[7];
+        rk[8] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x08)); k0 = rk[8];
+        rk[9] = key_expand2(k1, k0); k1 = rk[9];
+        rk[10] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x10)); k0 = rk[10];
+        rk[11] = key_expand2(k1, k0); k1 = rk[11];
+        rk[12] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x20)); k0 = rk[12];
+        rk[13] = key_expand2(k1, k0); k1 = rk[13];
+        rk[14] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x40));
+
+        ctr = _mm_set_epi64x(0, (long long)nonce);
+        has_buf = false;
+    }
+
+    // one block through the cipher, no counter side effects
+    inline __m128i enc_block(__m128i t) const {
+        t = _mm_xor_si128(t, rk[0]);
+        t = _mm_aesenc_si128(t, rk[1]);
+        t = _mm_aesenc_si128(t, rk[2]);
+        t = _mm_aesenc_si128(t, rk[3]);
+        t = _mm_aesenc_si128(t, rk[4]);
+        t = _mm_aesenc_si128(t, rk[5]);
+        t = _mm_aesenc_si128(t, rk[6]);
+        t = _mm_aesenc_si128(t, rk[7]);
+        t = _mm_aesenc_si128(t, rk[8]);
+        t = _mm_aesenc_si128(t, rk[9]);
+        t = _mm_aesenc_si128(t, rk[10]);
+        t = _mm_aesenc_si128(t, rk[11]);
+        t = _mm_aesenc_si128(t, rk[12]);
+        t = _mm_aesenc_si128(t, rk[13]);
+        return _mm_aesenclast_si128(t, rk[14]);
+    }
+
+    inline __m128i encrypt_ctr() {
+        __m128i t = enc_block(ctr);
+        ctr = _mm_add_epi64(ctr, _mm_set_epi64x(0, 1));
+        return t;
+    }
+
+    // nb whole blocks straight into out (2 * nb words), one at a time
+    inline void blocks_x1(uint64_t* out, size_t nb) {
+        for (size_t b = 0; b < nb; b++) {
+            _mm_storeu_si128((__m128i*)(out + 2 * b), encrypt_ctr());
+        }
+    }
+
+    // 8 counters in flight so the aesenc latency overlaps; the counter only
+    // moves in the low lane, same as encrypt_ctr
+    inline void blocks_x8(uint64_t* out, size_t nb) {
+        size_t b = 0;
+        for (; b + 8 <= nb; b += 8) {
+            __m128i c0 = ctr;
+            __m128i c1 = _mm_add_epi64(ctr, _mm_set_epi64x(0, 1));
+            __m128i c2 = _mm_add_epi64(ctr, _mm_set_epi64x(0, 2));
+            __m128i c3 = _mm_add_epi64(ctr, _mm_set_epi64x(0, 3));
+            __m128i c4 = _mm_add_epi64(ctr, _mm_set_epi64x(0, 4));
+            __m128i c5 = _mm_add_epi64(ctr, _mm_set_epi64x(0, 5));
+            __m128i c6 = _mm_add_epi64(ctr, _mm_set_epi64x(0, 6));
+            __m128i c7 = _mm_add_epi64(ctr, _mm_set_epi64x(0, 7));
+            ctr = _mm_add_epi64(ctr, _mm_set_epi64x(0, 8));
+
+            c0 = _mm_xor_si128(c0, rk[0]); c1 = _mm_xor_si128(c1, rk[0]);
+            c2 = _mm_xor_si128(c2, rk[0]); c3 = _mm_xor_si128(c3, rk[0]);
+            c4 = _mm_xor_si128(c4, rk[0]); c5 = _mm_xor_si128(c5, rk[0]);
+            c6 = _mm_xor_si128(c6, rk[0]); c7 = _mm_xor_si128(c7, rk[0]);
+
+            for (int r = 1; r < 14; r++) {
+                __m128i k = rk[r];
+                c0 = _mm_aesenc_si128(c0, k); c1 = _mm_aesenc_si128(c1, k);
+                c2 = _mm_aesenc_si128(c2, k); c3 = _mm_aesenc_si128(c3, k);
+                c4 = _mm_aesenc_si128(c4, k); c5 = _mm_aesenc_si128(c5, k);
+                c6 = _mm_aesenc_si128(c6, k); c7 = _mm_aesenc_si128(c7, k);
+            }
+
+            __m128i k = rk[14];
+            __m128i* o = (__m128i*)(out + 2 * b);
+            _mm_storeu_si128(o + 0, _mm_aesenclast_si128(c0, k));
+            _mm_storeu_si128(o + 1, _mm_aesenclast_si128(c1, k));
+            _mm_storeu_si128(o + 2, _mm_aesenclast_si128(c2, k));
+            _mm_storeu_si128(o + 3, _mm_aesenclast_si128(c3, k));
+            _mm_storeu_si128(o + 4, _mm_aesenclast_si128(c4, k));
+            _mm_storeu_si128(o + 5, _mm_aesenclast_si128(c5, k));
+            _mm_storeu_si128(o + 6, _mm_aesenclast_si128(c6, k));
+            _mm_storeu_si128(o + 7, _mm_aesenclast_si128(c7, k));
+        }
+        blocks_x1(out + 2 * b, nb - b);
+    }
+
+#if PVAC_USE_VAES
+    // 4 x 4 blocks per round with vaes, 16 in flight
+    inline void blocks_vaes(uint64_t* out, size_t nb) {
+        size_t b = 0;
+        if (nb >= 16) {
+            // maskz forms, gcc 12 warns on the undefined passthrough otherwise
+            const __mmask16 all = 0xFFFF;
+            __m512i k[15];
+            for (int r = 0; r < 15; r++) k[r] = _mm512_maskz_broadcast_i32x4(all, rk[r]);
+
+            __m512i c = _mm512_add_epi64(_mm512_maskz_broadcast_i32x4(all, ctr),
+                                         _mm512_set_epi64(0, 3, 0, 2, 0, 1, 0, 0));
+            const __m512i inc4 = _mm512_set_epi64(0, 4, 0, 4, 0, 4, 0, 4);
+
+            for (; b + 16 <= nb; b += 16) {
+                __m512i c0 = c;
+                __m512i c1 = _mm512_add_epi64(c0, inc4);
+                __m512i c2 = _mm512_add_epi64(c1, inc4);
+                __m512i c3 = _mm512_add_epi64(c2, inc4);
+                c = _mm512_add_epi64(c3, inc4);
+
+                c0 = _mm512_xor_si512(c0, k[0]); c1 = _mm512_xor_si512(c1, k[0]);
+                c2 = _mm512_xor_si512(c2, k[0]); c3 = _mm512_xor_si512(c3, k[0]);
+
+                for (int r = 1; r < 14; r++) {
+                    c0 = _mm512_aesenc_epi128(c0, k[r]); c1 = _mm512_aesenc_epi128(c1, k[r]);
+                    c2 = _mm512_aesenc_epi128(c2, k[r]); c3 = _mm512_aesenc_epi128(c3, k[r]);
+                }
+
+                uint64_t* o = out + 2 * b;
+                _mm512_storeu_si512((void*)(o + 0), _mm512_aesenclast_epi128(c0, k[14]));
+                _mm512_storeu_si512((void*)(o + 8), _mm512_aesenclast_epi128(c1, k[14]));
+                _mm512_storeu_si512((void*)(o + 16), _mm512_aesenclast_epi128(c2, k[14]));
+                _mm512_storeu_si512((void*)(o + 24), _mm512_aesenclast_epi128(c3, k[14]));
+            }
+
+            alignas(64) uint64_t nc[8];
+            _mm512_store_si512((void*)nc, c);
+            ctr = _mm_load_si128((const __m128i*)nc);
+        }
+        blocks_x8(out + 2 * b, nb - b);
+    }
+#endif
+
+    inline uint64_t next_u64() {
+        if (has_buf) {
+            has_buf = false;
+            return buf[1];
+        }
+        __m128i ct = encrypt_ctr();
+        _mm_store_si128((__m128i*)buf, ct);
+        has_buf = true;
+        return buf[0];
+    }
+
+    using Impl = AesImpl;
+
+    // same stream whatever the impl: a pending half block goes out first,
+    // an odd tail leaves the other half in buf
+    inline void fill_u64_with(uint64_t* out, size_t n, Impl impl) {
+        size_t i = 0;
+        if (has_buf && n > 0) {
+            out[0] = buf[1];
+            has_buf = false;
+            i = 1;
+        }
+
+        size_t nb = (n - i) / 2;
+        switch (impl) {
+#if PVAC_USE_VAES
+        case Impl::VAES: blocks_vaes(out + i, nb); break;
+#endif
+        case Impl::X1: blocks_x1(out + i, nb); break;
+        default: blocks_x8(out + i, nb); break;
+        }
+        i += 2 * nb;
+
+        if (i < n) {
+            __m128i ct = encrypt_ctr();
+            _mm_store_si128((__m128i*)buf, ct);
+            out[i] = buf[0];
+            has_buf = true;
+        }
+    }
+
+    inline void fill_u64(uint64_t* out, size_t n) {
+        fill_u64_with(out, n, aes_impl());
+    }
+
+    inline uint64_t bounded(uint64_t M) {
+        if (M <= 1) return 0;
+        uint64_t lim = UINT64_MAX - (UINT64_MAX % M);
+        for (;;) {
+            uint64_t x = next_u64();
+            if (x < lim) return x % M;
+        }
+    }
+};
+
+#else
+
+#error "hfhe requires aes-ni support (compile with -march=native or -maes on x86_64)"
+
+#endif
+
+}
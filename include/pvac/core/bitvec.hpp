@@ -1,8 +1,16 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <vector>
 #include <algorithm>
+#include <string>
+
+#include "cpu.hpp"
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace pvac {
 
@@ -36,6 +44,180 @@ struct BitVec {
         return s;
     }
 };
+// out ^= src[0] ^ ... ^ src[k - 1], all `words` long
+inline void bv_xor_many_scalar(
+    uint64_t * out,
+    const uint64_t * const * src,
+    size_t k,
+    size_t words
+) {
+    for (size_t j = 0; j < k; j++) {
+        const uint64_t * p = src[j];
+        for (size_t i = 0; i < words; i++) {
+            out[i] ^= p[i];
+        }
+    }
+}
+
+#if defined(__AVX2__)
+
+// 8 ymm accumulators (2 KiB of output) stay in registers while every
+// source streams through them, so out is read and written once per block
+inline void bv_xor_many_avx2(
+    uint64_t * out,
+    const uint64_t * const * src,
+    size_t k,
+    size_t words
+) {
+    constexpr size_t R = 8;
+    constexpr size_t BLK = R * 4;
+    size_t i = 0;
+
+    for (; i + BLK <= words; i += BLK) {
+        __m256i acc[R];
+        for (size_t r = 0; r < R; r++) {
+            acc[r] = _mm256_loadu_si256((const __m256i *)(out + i + 4 * r));
+        }
+
+        for (size_t j = 0; j < k; j++) {
+            const uint64_t * p = src[j] + i;
+            for (size_t r = 0; r < R; r++) {
+                acc[r] = _mm256_xor_si256(acc[r], _mm256_loadu_si256((const __m256i *)(p + 4 * r)));
+            }
+        }
+
+        for (size_t r = 0; r < R; r++) {
+            _mm256_storeu_si256((__m256i *)(out + i + 4 * r), acc[r]);
+        }
+    }
+
+    for (; i + 4 <= words; i += 4) {
+        __m256i acc = _mm256_loadu_si256((const __m256i *)(out + i));
+        for (size_t j = 0; j < k; j++) {
+            acc = _mm256_xor_si256(acc, _mm256_loadu_si256((const __m256i *)(src[j] + i)));
+        }
+        _mm256_storeu_si256((__m256i *)(out + i), acc);
+    }
+
+    for (; i < words; i++) {
+        uint64_t acc = out[i];
+        for (size_t j = 0; j < k; j++) acc ^= src[j][i];
+        out[i] = acc;
+    }
+}
+
+#endif
+
+#if defined(__AVX512F__)
+
+// same as avx2 with 16 zmm accumulators, one 8192 bit sigma per block
+inline void bv_xor_many_avx512(
+    uint64_t * out,
+    const uint64_t * const * src,
+    size_t k,
+    size_t words
+) {
+    constexpr size_t R = 16;
+    constexpr size_t BLK = R * 8;
+    size_t i = 0;
+
+    for (; i + BLK <= words; i += BLK) {
+        __m512i acc[R];
+        for (size_t r = 0; r < R; r++) {
+            acc[r] = _mm512_loadu_si512((const void *)(out + i + 8 * r));
+        }
+
+        for (size_t j = 0; j < k; j++) {
+            const uint64_t * p = src[j] + i;
+            for (size_t r = 0; r < R; r++) {
+                acc[r] = _mm512_xor_si512(acc[r], _mm512_loadu_si512((const void *)(p + 8 * r)));
+            }
+        }
+
+        for (size_t r = 0; r < R; r++) {
+            _mm512_storeu_si512((void *)(out + i + 8 * r), acc[r]);
+        }
+    }
+
+    for (; i + 8 <= words; i += 8) {
+        __m512i acc = _mm512_loadu_si512((const void *)(out + i));
+        for (size_t j = 0; j < k; j++) {
+            acc = _mm512_xor_si512(acc, _mm512_loadu_si512((const void *)(src[j] + i)));
+        }
+        _mm512_storeu_si512((void *)(out + i), acc);
+    }
+
+    for (; i < words; i++) {
+        uint64_t acc = out[i];
+        for (size_t j = 0; j < k; j++) acc ^= src[j][i];
+        out[i] = acc;
+    }
+}
+
+#endif
+
+// simd width for the bit vector kernels (xor_many, lpn row dots)
+enum class BvImpl { SCALAR, AVX2, AVX512 };
+
+namespace bv_detail {
+    inline const char * const NAMES[3] = {"scalar", "avx2", "avx512"};
+
+    inline void avail(bool ok[3]) {
+        const CpuFeatures & f = cpu_features();
+        ok[0] = true;
+#if defined(__AVX2__)
+        ok[1] = f.avx2;
+#else
+        ok[1] = false;
+#endif
+#if defined(__AVX512F__)
+        ok[2] = f.avx512f;
+#else
+        ok[2] = false;
+#endif
+    }
+
+    inline BvImpl pick() {
+        bool ok[3];
+        avail(ok);
+        return (BvImpl)impl_pick("bitvec", NAMES, ok, 3, ok[2] ? 2 : ok[1] ? 1 : 0);
+    }
+}
+
+inline BvImpl bv_impl() {
+    static const BvImpl impl = bv_detail::pick();
+    return impl;
+}
+
+inline const char * bv_impl_name() {
+    return bv_detail::NAMES[(int)bv_impl()];
+}
+
+inline std::string bv_impl_avail() {
+    bool ok[3];
+    bv_detail::avail(ok);
+    return impl_avail_list(bv_detail::NAMES, ok, 3);
+}
+
+inline const bool g_bv_impl_reg = impl_register("bitvec", &bv_impl_name, &bv_impl_avail);
+
+inline void bv_xor_many(
+    uint64_t * out,
+    const uint64_t * const * src,
+    size_t k,
+    size_t words
+) {
+    switch (bv_impl()) {
+#if defined(__AVX512F__)
+    case BvImpl::AVX512: bv_xor_many_avx512(out, src, k, words); return;
+#endif
+#if defined(__AVX2__)
+    case BvImpl::AVX2: bv_xor_many_avx2(out, src, k, words); return;
+#endif
+    default: bv_xor_many_scalar(out, src, k, words); return;
+    }
+}
+
     // pure xor shift + the same time for any x
     inline int parity64(uint64_t x) {
         x ^= x >> 32;
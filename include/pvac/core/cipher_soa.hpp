@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#include <vector>
+
+#include "types.hpp"
+
+namespace pvac {
+
+template <class T, size_t A>
+struct AlignedAlloc {
+    using value_type = T;
+
+    template <class U>
+    struct rebind { using other = AlignedAlloc<U, A>; };
+
+    AlignedAlloc() = default;
+
+    template <class U>
+    AlignedAlloc(const AlignedAlloc<U, A> &) {}
+
+    T * allocate(size_t n) {
+        return (T *)::operator new(n * sizeof(T), std::align_val_t(A));
+    }
+
+    void deallocate(T * p, size_t) {
+        ::operator delete(p, std::align_val_t(A));
+    }
+
+    template <class U>
+    bool operator==(const AlignedAlloc<U, A> &) const { return true; }
+
+    template <class U>
+    bool operator!=(const AlignedAlloc<U, A> &) const { return false; }
+};
+
+using SigmaSlab = std::vector<uint64_t, AlignedAlloc<uint64_t, 64>>;
+
+// edge without its sigma, what the weight side of every op looks at
+struct EdgeMeta {
+    uint32_t layer_id;
+    uint16_t idx;
+    uint8_t ch;
+    Fp w;
+};
+
+// struct of arrays Cipher: edge fields in parallel arrays and all sigmas
+// back to back in one 64 byte aligned slab. edge i owns
+// sig[i * stride .. i * stride + words()), the rest of its stride is
+// zero padding up to a whole cache line (128 words at m_bits = 8192)
+struct CipherSoA {
+    std::vector<Layer> L;
+
+    std::vector<uint32_t> layer_id;
+    std::vector<uint16_t> idx;
+    std::vector<uint8_t> ch;
+    std::vector<Fp> w;
+
+    size_t nbits = 0;
+    size_t stride = 0;
+    SigmaSlab sig;
+
+    static size_t stride_for(size_t bits) {
+        return (((bits + 63) / 64) + 7) & ~(size_t)7;
+    }
+
+    static CipherSoA make(size_t bits) {
+        CipherSoA C;
+        C.nbits = bits;
+        C.stride = stride_for(bits);
+        return C;
+    }
+
+    size_t size() const { return idx.size(); }
+    bool empty() const { return idx.empty(); }
+    size_t words() const { return (nbits + 63) / 64; }
+
+    uint64_t * sigma(size_t i) { return sig.data() + i * stride; }
+    const uint64_t * sigma(size_t i) const { return sig.data() + i * stride; }
+
+    EdgeMeta meta(size_t i) const {
+        return EdgeMeta{layer_id[i], idx[i], ch[i], w[i]};
+    }
+
+    void reserve(size_t n) {
+        layer_id.reserve(n);
+        idx.reserve(n);
+        ch.reserve(n);
+        w.reserve(n);
+        sig.reserve(n * stride);
+    }
+
+    // appends an edge with a zero sigma and hands the sigma back
+    uint64_t * push(uint32_t lid, uint16_t k, uint8_t c, const Fp & x) {
+        layer_id.push_back(lid);
+        idx.push_back(k);
+        ch.push_back(c);
+        w.push_back(x);
+        sig.resize(sig.size() + stride, 0);
+        return sigma(size() - 1);
+    }
+
+    void push(uint32_t lid, uint16_t k, uint8_t c, const Fp & x, const uint64_t * s) {
+        std::memcpy(push(lid, k, c, x), s, words() * sizeof(uint64_t));
+    }
+
+    // keeps the first n edges
+    void truncate(size_t n) {
+        layer_id.resize(n);
+        idx.resize(n);
+        ch.resize(n);
+        w.resize(n);
+        sig.resize(n * stride);
+    }
+};
+
+inline std::vector<EdgeMeta> ct_edge_meta(const Cipher & C) {
+    std::vector<EdgeMeta> m;
+    m.reserve(C.E.size());
+    for (const auto & e : C.E) m.push_back(EdgeMeta{e.layer_id, e.idx, e.ch, e.w});
+    return m;
+}
+
+inline std::vector<EdgeMeta> ct_edge_meta(const CipherSoA & C) {
+    std::vector<EdgeMeta> m;
+    m.reserve(C.size());
+    for (size_t i = 0; i < C.size(); i++) m.push_back(C.meta(i));
+    return m;
+}
+
+inline CipherSoA to_soa(const PubKey & pk, const Cipher & C) {
+    CipherSoA S = CipherSoA::make((size_t)pk.prm.m_bits);
+    S.L = C.L;
+    S.reserve(C.E.size());
+
+    size_t words = S.words();
+    for (const auto & e : C.E) {
+        uint64_t * s = S.push(e.layer_id, e.idx, e.ch, e.w);
+        std::memcpy(s, e.s.w.data(), std::min(words, e.s.w.size()) * sizeof(uint64_t));
+    }
+    return S;
+}
+
+inline Cipher from_soa(const CipherSoA & S) {
+    Cipher C;
+    C.L = S.L;
+    C.E.reserve(S.size());
+
+    size_t words = S.words();
+    for (size_t i = 0; i < S.size(); i++) {
+        BitVec s;
+        s.nbits = S.nbits;
+        s.w.assign(S.sigma(i), S.sigma(i) + words);
+        C.E.push_back(Edge{S.layer_id[i], S.idx[i], S.ch[i], S.w[i], std::move(s)});
+    }
+    return C;
+}
+
+}
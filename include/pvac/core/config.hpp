@@ -3,6 +3,7 @@
 
 #include <cstdlib>
 #include <algorithm>
+#include <thread>
 
 namespace pvac {
 
@@ -20,4 +21,16 @@ inline int get_debug_level() {
     return g_dbg;
 }
 
-}
\ No newline at end of file
+// worker count for the thread pool, PVAC_THREADS=n, 0 or unset = all cores
+inline int g_threads = []() {
+    const char * s = std::getenv("PVAC_THREADS");
+    int n = s ? std::atoi(s) : 0;
+    if (n <= 0) n = (int)std::thread::hardware_concurrency();
+    return std::max(1, std::min(256, n));
+}();
+
+inline int get_num_threads() {
+    return g_threads;
+}
+
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define PVAC_X86 1
+#else
+#define PVAC_X86 0
+#endif
+
+namespace pvac {
+
+// what the running cpu (and os, for the wide register state) supports;
+// a kernel is usable when it was compiled in and the feature is here
+struct CpuFeatures {
+    bool aes = false;
+    bool pclmul = false;
+    bool avx2 = false;
+    bool bmi2 = false;
+    bool avx512f = false;
+    bool avx512bw = false;
+    bool avx512ifma = false;
+    bool vaes = false;
+    bool vpclmulqdq = false;
+    bool sha = false;
+};
+
+#if PVAC_X86
+inline uint64_t xgetbv0() {
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return ((uint64_t)d << 32) | a;
+}
+#endif
+
+inline CpuFeatures detect_cpu_features() {
+    CpuFeatures f;
+#if PVAC_X86
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return f;
+
+    f.aes = (c >> 25) & 1;
+    f.pclmul = (c >> 1) & 1;
+
+    bool osxsave = (c >> 27) & 1;
+    uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+    bool ymm = (xcr0 & 0x06) == 0x06;
+    bool zmm = (xcr0 & 0xe6) == 0xe6;
+
+    if (!__get_cpuid_count(7, 0, &a, &b, &c, &d)) return f;
+
+    f.avx2 = ymm && ((b >> 5) & 1);
+    f.bmi2 = (b >> 8) & 1;
+    f.avx512f = zmm && ((b >> 16) & 1);
+    f.avx512bw = zmm && ((b >> 30) & 1);
+    f.avx512ifma = zmm && ((b >> 21) & 1);
+    f.sha = (b >> 29) & 1;
+    f.vaes = ymm && ((c >> 9) & 1);
+    f.vpclmulqdq = ymm && ((c >> 10) & 1);
+#endif
+    return f;
+}
+
+inline const CpuFeatures & cpu_features() {
+    static const CpuFeatures f = detect_cpu_features();
+    return f;
+}
+
+// PVAC_IMPL picks kernels by hand:
+//   PVAC_IMPL=scalar                  portable code everywhere
+//   PVAC_IMPL=toeplitz=scalar,aes=x8  per kernel family
+// spec lookup for one family, "" when it says nothing about it
+inline std::string impl_spec_lookup(const char * spec, const char * kernel) {
+    if (!spec) return "";
+
+    std::string s(spec);
+    size_t klen = std::strlen(kernel);
+    std::string global;
+
+    size_t p = 0;
+    while (p <= s.size()) {
+        size_t e = s.find(',', p);
+        if (e == std::string::npos) e = s.size();
+        std::string tok = s.substr(p, e - p);
+        p = e + 1;
+
+        size_t eq = tok.find_first_of("=:");
+        if (eq == std::string::npos) {
+            if (!tok.empty()) global = tok;
+        } else if (eq == klen && tok.compare(0, klen, kernel) == 0) {
+            return tok.substr(eq + 1);
+        }
+    }
+    return global;
+}
+
+inline std::string impl_request(const char * kernel) {
+    static const char * spec = std::getenv("PVAC_IMPL");
+    return impl_spec_lookup(spec, kernel);
+}
+
+// names[0] is the portable one and answers to "scalar" too
+inline int impl_pick(const char * kernel, const char * const * names, const bool * ok, int n, int best) {
+    std::string want = impl_request(kernel);
+    if (want.empty()) return best;
+    if (want == "scalar") return 0;
+
+    for (int i = 0; i < n; i++) {
+        if (want != names[i]) continue;
+        if (ok[i]) return i;
+        std::cerr << "[pvac] PVAC_IMPL " << kernel << "=" << want
+                  << " not available, using " << names[best] << "\n";
+        return best;
+    }
+
+    std::cerr << "[pvac] PVAC_IMPL " << kernel << "=" << want
+              << " unknown, using " << names[best] << "\n";
+    return best;
+}
+
+// each kernel family registers how to name its pick for impl_report
+struct ImplEntry {
+    const char * kernel;
+    const char * (*chosen)();
+    std::string (*avail)();
+};
+
+inline std::vector<ImplEntry> & impl_registry() {
+    static std::vector<ImplEntry> r;
+    return r;
+}
+
+inline std::mutex & impl_registry_mu() {
+    static std::mutex mu;
+    return mu;
+}
+
+inline bool impl_register(const char * kernel, const char * (*chosen)(), std::string (*avail)()) {
+    std::lock_guard<std::mutex> lk(impl_registry_mu());
+    for (const auto & e : impl_registry()) {
+        if (std::strcmp(e.kernel, kernel) == 0) return true;
+    }
+    impl_registry().push_back({kernel, chosen, avail});
+    return true;
+}
+
+inline std::string impl_avail_list(const char * const * names, const bool * ok, int n) {
+    std::string s;
+    for (int i = 0; i < n; i++) {
+        if (!ok[i]) continue;
+        if (!s.empty()) s += " ";
+        s += names[i];
+    }
+    return s;
+}
+
+inline std::string cpu_feature_string() {
+    const CpuFeatures & f = cpu_features();
+    std::string s;
+    auto add = [&](bool on, const char * name) {
+        if (!on) return;
+        if (!s.empty()) s += " ";
+        s += name;
+    };
+    add(f.aes, "aes");
+    add(f.pclmul, "pclmul");
+    add(f.avx2, "avx2");
+    add(f.bmi2, "bmi2");
+    add(f.avx512f, "avx512f");
+    add(f.avx512bw, "avx512bw");
+    add(f.avx512ifma, "avx512ifma");
+    add(f.vaes, "vaes");
+    add(f.vpclmulqdq, "vpclmulqdq");
+    add(f.sha, "sha");
+    return s.empty() ? "none" : s;
+}
+
+// one line per kernel family: chosen impl and what else could run
+inline std::string impl_report() {
+    std::string s = "cpu: " + cpu_feature_string() + "\n";
+    std::lock_guard<std::mutex> lk(impl_registry_mu());
+    for (const auto & e : impl_registry()) {
+        s += e.kernel;
+        s += ": ";
+        s += e.chosen();
+        s += " [";
+        s += e.avail();
+        s += "]\n";
+    }
+    return s;
+}
+
+}
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <cstdlib>
 #include <algorithm>
+#include <vector>
 
 #if !defined(__SIZEOF_INT128__) && !(defined(_MSC_VER) && defined(__clang__))
 #error "Needs unsigned __int128"
@@ -108,51 +109,6 @@ inline void mul128x128(uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1,
     z3 = h11 + c2;
 }
 
-#elif defined(__x86_64__) && defined(__GNUC__) && !defined(_MSC_VER)
-
-inline void mul128x128(uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1,
-                       uint64_t& z0, uint64_t& z1, uint64_t& z2, uint64_t& z3) {
-    uint64_t p00_lo, p00_hi;
-    uint64_t p01_lo, p01_hi;
-    uint64_t p10_lo, p10_hi;
-    uint64_t p11_lo, p11_hi;
-
-    __asm__ volatile(
-        "movq %[a0], %%rax\n\t"
-        "mulq %[b0]\n\t"
-        "movq %%rax, %[p00_lo]\n\t"
-        "movq %%rdx, %[p00_hi]\n\t"
-        "movq %[a0], %%rax\n\t"
-        "mulq %[b1]\n\t"
-        "movq %%rax, %[p01_lo]\n\t"
-        "movq %%rdx, %[p01_hi]\n\t"
-        "movq %[a1], %%rax\n\t"
-        "mulq %[b0]\n\t"
-        "movq %%rax, %[p10_lo]\n\t"
-        "movq %%rdx, %[p10_hi]\n\t"
-        "movq %[a1], %%rax\n\t"
-        "mulq %[b1]\n\t"
-        "movq %%rax, %[p11_lo]\n\t"
-        "movq %%rdx, %[p11_hi]\n\t"
-        : [p00_lo]"=&r"(p00_lo), [p00_hi]"=&r"(p00_hi),
-          [p01_lo]"=&r"(p01_lo), [p01_hi]"=&r"(p01_hi),
-          [p10_lo]"=&r"(p10_lo), [p10_hi]"=&r"(p10_hi),
-          [p11_lo]"=&r"(p11_lo), [p11_hi]"=&r"(p11_hi)
-        : [a0]"r"(a0), [a1]"r"(a1), [b0]"r"(b0), [b1]"r"(b1)
-        : "rax", "rdx", "cc"
-    );
-
-    z0 = p00_lo;
-
-    u128 m1 = (u128)p00_hi + (u128)p01_lo + (u128)p10_lo;
-    z1 = (uint64_t)m1;
-
-    u128 m2 = (u128)p01_hi + (u128)p10_hi + (u128)p11_lo + (m1 >> 64);
-    z2 = (uint64_t)m2;
-
-    z3 = p11_hi + (uint64_t)(m2 >> 64);
-}
-
 #else
 
 inline void mul128x128(uint64_t a0, uint64_t a1, uint64_t b0, uint64_t b1,
@@ -212,6 +168,59 @@ inline Fp fp_mul(const Fp& a, const Fp& b) {
     return fp_reduce256(z0, z1, z2, z3);
 }
 
+// unreduced sum for long runs of adds: terms land in a 192 bit counter
+// and are reduced once in get(). every term is below 2^128 and
+// 2^128 = 2 mod p, so 2^64 terms fit. products are folded once
+// (2^127 = 1) into a 128 bit term, subtractions add 2p - x instead
+struct FpAcc {
+    uint64_t w0 = 0, w1 = 0, w2 = 0;
+
+    static constexpr u128 M127 = (((u128)1) << 127) - 1;
+    static constexpr u128 TWO_P = M127 << 1;
+
+    void add128(u128 v) {
+        u128 t = (((u128)w1 << 64) | w0) + v;
+        w2 += (uint64_t)(t < v);
+        w0 = (uint64_t)t;
+        w1 = (uint64_t)(t >> 64);
+    }
+
+    static u128 words(const Fp& x) {
+        return ((u128)x.hi << 64) | x.lo;
+    }
+
+    // a * b folded to below 2^128
+    static u128 mul_fold(const Fp& a, const Fp& b) {
+        uint64_t z0, z1, z2, z3;
+        mul128x128(a.lo, a.hi, b.lo, b.hi, z0, z1, z2, z3);
+        u128 lo = ((u128)(z1 & MASK63) << 64) | z0;
+        u128 hi = ((u128)z3 << 65) + ((u128)z2 << 1) + (z1 >> 63);
+        return lo + hi;
+    }
+
+    void add(const Fp& x) { add128(words(x)); }
+    void sub(const Fp& x) { add128(TWO_P - words(x)); }
+
+    void mul_add(const Fp& a, const Fp& b) { add128(mul_fold(a, b)); }
+
+    void mul_sub(const Fp& a, const Fp& b) {
+        u128 v = mul_fold(a, b);
+        v = (v & M127) + (v >> 127);
+        add128(TWO_P - v);
+    }
+
+    void add(const FpAcc& o) {
+        add128(((u128)o.w1 << 64) | o.w0);
+        w2 += o.w2;
+    }
+
+    Fp get() const {
+        u128 t = ((u128)w1 << 64) | w0;
+        u128 r = (t & M127) + (t >> 127) + ((u128)w2 << 1);
+        return fp_from_words((uint64_t)r, (uint64_t)(r >> 64));
+    }
+};
+
 inline Fp fp_pow_u64(Fp a, uint64_t e) {
     Fp r = fp_from_u64(1);
 
@@ -272,4 +281,41 @@ inline Fp fp_inv(const Fp& a) {
     return fp_inv_ct(a);
 }
 
+// montgomery's trick: n inverses for one fp_inv and 3(n - 1) fp_mul.
+// zeros map to zero like fp_inv, without a branch on the value
+inline void fp_batch_inv(Fp* a, size_t n) {
+    if (n == 0) return;
+    if (n == 1) {
+        a[0] = fp_inv(a[0]);
+        return;
+    }
+
+    auto zmask = [](const Fp& x) { return (uint64_t)0 - (uint64_t)((x.lo | x.hi) == 0); };
+
+    // pre[i] = a[0] * .. * a[i - 1], zeros counted as one
+    std::vector<Fp> pre(n);
+    Fp acc = fp_from_u64(1);
+    for (size_t i = 0; i < n; i++) {
+        pre[i] = acc;
+        Fp x = a[i];
+        x.lo |= zmask(x) & 1;
+        acc = fp_mul(acc, x);
+    }
+
+    Fp inv = fp_inv(acc);
+    for (size_t i = n; i-- > 0; ) {
+        Fp x = a[i];
+        uint64_t z = zmask(x);
+        x.lo |= z & 1;
+
+        Fp r = fp_mul(inv, pre[i]);
+        inv = fp_mul(inv, x);
+        a[i] = Fp{r.lo & ~z, r.hi & ~z};
+    }
+}
+
+inline void fp_batch_inv(std::vector<Fp>& a) {
+    fp_batch_inv(a.data(), a.size());
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#include "cpu.hpp"
+#include "field.hpp"
+
+#if defined(__AVX2__) || (defined(__AVX512F__) && defined(__AVX512IFMA__))
+#include <immintrin.h>
+#endif
+
+namespace pvac {
+
+// batch field ops over Fp arrays (out may alias an input):
+//   fp_mul_n      out[i] = a[i] * b[i]
+//   fp_scale_n    out[i] = a[i] * s
+//   fp_add_n      out[i] = a[i] + b[i]
+//   fp_dot_signed sum of +-a[i] * b[i], minus where ch[i] == SGN_M (1)
+// ifma keeps 8 lanes of 3 x 52 bit limbs; avx2 has no 64 bit multiplier,
+// so it only vectorizes fp_add_n and leaves products (and the FpAcc dot
+// product) to the scalar path
+struct FpBatchOps {
+    void (*mul_n)(Fp*, const Fp*, const Fp*, size_t);
+    void (*scale_n)(Fp*, const Fp*, const Fp&, size_t);
+    void (*add_n)(Fp*, const Fp*, const Fp*, size_t);
+    Fp (*dot_signed)(const Fp*, const Fp*, const uint8_t*, size_t);
+};
+
+inline void fp_mul_n_scalar(Fp* out, const Fp* a, const Fp* b, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = fp_mul(a[i], b[i]);
+}
+
+inline void fp_scale_n_scalar(Fp* out, const Fp* a, const Fp& s, size_t n) {
+    Fp k = s;
+    for (size_t i = 0; i < n; i++) out[i] = fp_mul(a[i], k);
+}
+
+inline void fp_add_n_scalar(Fp* out, const Fp* a, const Fp* b, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = fp_add(a[i], b[i]);
+}
+
+// products folded once and summed unreduced; the sign is a mask select
+// between v and 2p - v rather than a branch
+inline Fp fp_dot_signed_scalar(const Fp* a, const Fp* b, const uint8_t* ch, size_t n) {
+    FpAcc acc;
+    for (size_t i = 0; i < n; i++) {
+        u128 v = FpAcc::mul_fold(a[i], b[i]);
+        v = (v & FpAcc::M127) + (v >> 127);
+        u128 m = (u128)0 - (u128)(ch[i] != 0);
+        acc.add128(v ^ ((v ^ (FpAcc::TWO_P - v)) & m));
+    }
+    return acc.get();
+}
+
+#if defined(__AVX2__)
+
+// 4 lanes of (lo, hi): unpack keeps the lanes in an order of its own,
+// the matching unpack on the way out puts them back
+inline void fp_add_n_avx2(Fp* out, const Fp* a, const Fp* b, size_t n) {
+    const __m256i sign = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+    const __m256i m63 = _mm256_set1_epi64x((long long)MASK63);
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i zero = _mm256_setzero_si256();
+
+    auto ltu = [&](__m256i x, __m256i y) {
+        return _mm256_cmpgt_epi64(_mm256_xor_si256(y, sign), _mm256_xor_si256(x, sign));
+    };
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i*)(a + i + 2));
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(b + i + 2));
+
+        __m256i alo = _mm256_unpacklo_epi64(a0, a1), ahi = _mm256_unpackhi_epi64(a0, a1);
+        __m256i blo = _mm256_unpacklo_epi64(b0, b1), bhi = _mm256_unpackhi_epi64(b0, b1);
+
+        // < 2^128, then fold bit 127 back in (2^127 = 1)
+        __m256i lo = _mm256_add_epi64(alo, blo);
+        __m256i hi = _mm256_sub_epi64(_mm256_add_epi64(ahi, bhi), ltu(lo, alo));
+        __m256i top = _mm256_srli_epi64(hi, 63);
+        hi = _mm256_and_si256(hi, m63);
+        __m256i lo2 = _mm256_add_epi64(lo, top);
+        hi = _mm256_sub_epi64(hi, ltu(lo2, lo));
+        lo = lo2;
+
+        // now <= 2^127, take p off when lo + 1 carries into bit 127
+        __m256i ulo = _mm256_add_epi64(lo, one);
+        __m256i uhi = _mm256_sub_epi64(hi, _mm256_cmpeq_epi64(ulo, zero));
+        __m256i ge = _mm256_cmpgt_epi64(zero, uhi);
+        lo = _mm256_blendv_epi8(lo, ulo, ge);
+        hi = _mm256_blendv_epi8(hi, _mm256_and_si256(uhi, m63), ge);
+
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_unpacklo_epi64(lo, hi));
+        _mm256_storeu_si256((__m256i*)(out + i + 2), _mm256_unpackhi_epi64(lo, hi));
+    }
+    fp_add_n_scalar(out + i, a + i, b + i, n - i);
+}
+
+#endif
+
+#if defined(__AVX512F__) && defined(__AVX512IFMA__)
+
+namespace fp_ifma {
+    // the maskz forms: gcc 12 warns about the undefined passthrough the
+    // plain shift intrinsics carry
+    inline __m512i shl(__m512i x, unsigned k) { return _mm512_maskz_slli_epi64(0xff, x, k); }
+    inline __m512i shr(__m512i x, unsigned k) { return _mm512_maskz_srli_epi64(0xff, x, k); }
+
+    // 8 Fp from memory to 3 x 52 bit limbs (x < 2^127 so x2 < 2^23)
+    inline void load(const Fp* p, __m512i& x0, __m512i& x1, __m512i& x2) {
+        const __m512i ev = _mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14);
+        const __m512i od = _mm512_setr_epi64(1, 3, 5, 7, 9, 11, 13, 15);
+        const __m512i m52 = _mm512_set1_epi64((1ll << 52) - 1);
+
+        __m512i v0 = _mm512_loadu_si512((const void*)p);
+        __m512i v1 = _mm512_loadu_si512((const void*)(p + 4));
+        __m512i lo = _mm512_permutex2var_epi64(v0, ev, v1);
+        __m512i hi = _mm512_permutex2var_epi64(v0, od, v1);
+
+        x0 = _mm512_and_si512(lo, m52);
+        x1 = _mm512_and_si512(_mm512_or_si512(shr(lo, 52), shl(hi, 12)), m52);
+        x2 = shr(hi, 40);
+    }
+
+    inline void store(Fp* p, __m512i x0, __m512i x1, __m512i x2) {
+        const __m512i il0 = _mm512_setr_epi64(0, 8, 1, 9, 2, 10, 3, 11);
+        const __m512i il1 = _mm512_setr_epi64(4, 12, 5, 13, 6, 14, 7, 15);
+
+        __m512i lo = _mm512_or_si512(x0, shl(x1, 52));
+        __m512i hi = _mm512_or_si512(shr(x1, 12), shl(x2, 40));
+        _mm512_storeu_si512((void*)p, _mm512_permutex2var_epi64(lo, il0, hi));
+        _mm512_storeu_si512((void*)(p + 4), _mm512_permutex2var_epi64(lo, il1, hi));
+    }
+
+    // carries up from limb 0, the top limb keeps what is left
+    inline void carry3(__m512i& x0, __m512i& x1, __m512i& x2) {
+        const __m512i m52 = _mm512_set1_epi64((1ll << 52) - 1);
+        x1 = _mm512_add_epi64(x1, shr(x0, 52));
+        x0 = _mm512_and_si512(x0, m52);
+        x2 = _mm512_add_epi64(x2, shr(x1, 52));
+        x1 = _mm512_and_si512(x1, m52);
+    }
+
+    // x < 2^127 + 4 to [0, p): subtract p when x + 1 reaches bit 127
+    inline void canon(__m512i& x0, __m512i& x1, __m512i& x2) {
+        __m512i u0 = _mm512_add_epi64(x0, _mm512_set1_epi64(1));
+        __m512i u1 = x1, u2 = x2;
+        carry3(u0, u1, u2);
+        __mmask8 ge = _mm512_test_epi64_mask(u2, _mm512_set1_epi64(1ll << 23));
+        x0 = _mm512_mask_mov_epi64(x0, ge, u0);
+        x1 = _mm512_mask_mov_epi64(x1, ge, u1);
+        x2 = _mm512_mask_mov_epi64(x2, ge, _mm512_and_si512(u2, _mm512_set1_epi64((1ll << 23) - 1)));
+    }
+
+    // value in limbs of 52 bits, top limb < 2^25: fold bits >= 127 once
+    // more and normalize
+    inline void fold(__m512i& x0, __m512i& x1, __m512i& x2) {
+        carry3(x0, x1, x2);
+        x0 = _mm512_add_epi64(x0, shr(x2, 23));
+        x2 = _mm512_and_si512(x2, _mm512_set1_epi64((1ll << 23) - 1));
+        carry3(x0, x1, x2);
+        canon(x0, x1, x2);
+    }
+
+    // the 254 bit product sits in columns at 2^0, 2^52 .. 2^208; with
+    // 2^127 = 1 the columns from 2^127 up come back in at 2^0
+    inline void mul(__m512i a0, __m512i a1, __m512i a2,
+                    __m512i b0, __m512i b1, __m512i b2,
+                    __m512i& r0, __m512i& r1, __m512i& r2) {
+        const __m512i z = _mm512_setzero_si512();
+        const __m512i m52 = _mm512_set1_epi64((1ll << 52) - 1);
+        const __m512i m23 = _mm512_set1_epi64((1ll << 23) - 1);
+
+        __m512i c0 = _mm512_madd52lo_epu64(z, a0, b0);
+
+        __m512i c1 = _mm512_madd52hi_epu64(z, a0, b0);
+        c1 = _mm512_madd52lo_epu64(c1, a0, b1);
+        c1 = _mm512_madd52lo_epu64(c1, a1, b0);
+
+        __m512i c2 = _mm512_madd52hi_epu64(z, a0, b1);
+        c2 = _mm512_madd52hi_epu64(c2, a1, b0);
+        c2 = _mm512_madd52lo_epu64(c2, a0, b2);
+        c2 = _mm512_madd52lo_epu64(c2, a1, b1);
+        c2 = _mm512_madd52lo_epu64(c2, a2, b0);
+
+        __m512i c3 = _mm512_madd52hi_epu64(z, a0, b2);
+        c3 = _mm512_madd52hi_epu64(c3, a1, b1);
+        c3 = _mm512_madd52hi_epu64(c3, a2, b0);
+        c3 = _mm512_madd52lo_epu64(c3, a1, b2);
+        c3 = _mm512_madd52lo_epu64(c3, a2, b1);
+
+        // a2 * b2 < 2^46, no high half
+        __m512i c4 = _mm512_madd52hi_epu64(z, a1, b2);
+        c4 = _mm512_madd52hi_epu64(c4, a2, b1);
+        c4 = _mm512_madd52lo_epu64(c4, a2, b2);
+
+        c1 = _mm512_add_epi64(c1, shr(c0, 52));
+        c0 = _mm512_and_si512(c0, m52);
+        c2 = _mm512_add_epi64(c2, shr(c1, 52));
+        c1 = _mm512_and_si512(c1, m52);
+        c3 = _mm512_add_epi64(c3, shr(c2, 52));
+        c2 = _mm512_and_si512(c2, m52);
+        c4 = _mm512_add_epi64(c4, shr(c3, 52));
+        c3 = _mm512_and_si512(c3, m52);
+
+        // high part is the product >> 127, in 52 bit limbs
+        __m512i h0 = _mm512_or_si512(shr(c2, 23), _mm512_and_si512(shl(c3, 29), m52));
+        __m512i h1 = _mm512_or_si512(shr(c3, 23), _mm512_and_si512(shl(c4, 29), m52));
+        __m512i h2 = shr(c4, 23);
+
+        r0 = _mm512_add_epi64(c0, h0);
+        r1 = _mm512_add_epi64(c1, h1);
+        r2 = _mm512_add_epi64(_mm512_and_si512(c2, m23), h2);
+        fold(r0, r1, r2);
+    }
+}
+
+inline void fp_mul_n_ifma(Fp* out, const Fp* a, const Fp* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i a0, a1, a2, b0, b1, b2, r0, r1, r2;
+        fp_ifma::load(a + i, a0, a1, a2);
+        fp_ifma::load(b + i, b0, b1, b2);
+        fp_ifma::mul(a0, a1, a2, b0, b1, b2, r0, r1, r2);
+        fp_ifma::store(out + i, r0, r1, r2);
+    }
+    fp_mul_n_scalar(out + i, a + i, b + i, n - i);
+}
+
+inline void fp_scale_n_ifma(Fp* out, const Fp* a, const Fp& s, size_t n) {
+    const uint64_t m52 = (1ull << 52) - 1;
+    __m512i s0 = _mm512_set1_epi64((long long)(s.lo & m52));
+    __m512i s1 = _mm512_set1_epi64((long long)(((s.lo >> 52) | (s.hi << 12)) & m52));
+    __m512i s2 = _mm512_set1_epi64((long long)(s.hi >> 40));
+
+    Fp k = s;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i a0, a1, a2, r0, r1, r2;
+        fp_ifma::load(a + i, a0, a1, a2);
+        fp_ifma::mul(a0, a1, a2, s0, s1, s2, r0, r1, r2);
+        fp_ifma::store(out + i, r0, r1, r2);
+    }
+    fp_scale_n_scalar(out + i, a + i, k, n - i);
+}
+
+inline void fp_add_n_ifma(Fp* out, const Fp* a, const Fp* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i a0, a1, a2, b0, b1, b2;
+        fp_ifma::load(a + i, a0, a1, a2);
+        fp_ifma::load(b + i, b0, b1, b2);
+        a0 = _mm512_add_epi64(a0, b0);
+        a1 = _mm512_add_epi64(a1, b1);
+        a2 = _mm512_add_epi64(a2, b2);
+        fp_ifma::fold(a0, a1, a2);
+        fp_ifma::store(out + i, a0, a1, a2);
+    }
+    fp_add_n_scalar(out + i, a + i, b + i, n - i);
+}
+
+// products are summed limb by limb without carries into a + and a -
+// accumulator, 2^11 of them fit a 64 bit lane before it has to be folded
+inline Fp fp_dot_signed_ifma(const Fp* a, const Fp* b, const uint8_t* ch, size_t n) {
+    const __m512i z = _mm512_setzero_si512();
+    __m512i p0 = z, p1 = z, p2 = z, m0 = z, m1 = z, m2 = z;
+    Fp acc = fp_from_u64(0);
+
+    // lane sums back to one Fp: x0 + x1 * 2^52 + x2 * 2^104
+    auto drain = [&]() {
+        alignas(64) uint64_t t[6][8];
+        _mm512_store_si512((void*)t[0], p0);
+        _mm512_store_si512((void*)t[1], p1);
+        _mm512_store_si512((void*)t[2], p2);
+        _mm512_store_si512((void*)t[3], m0);
+        _mm512_store_si512((void*)t[4], m1);
+        _mm512_store_si512((void*)t[5], m2);
+
+        const Fp s52 = Fp{1ull << 52, 0}, s104 = Fp{0, 1ull << 40};
+        Fp limb[6];
+        for (int k = 0; k < 6; k++) {
+            limb[k] = fp_from_u64(0);
+            for (int l = 0; l < 8; l++) limb[k] = fp_add(limb[k], fp_from_u64(t[k][l]));
+        }
+        Fp P = fp_add(limb[0], fp_add(fp_mul(limb[1], s52), fp_mul(limb[2], s104)));
+        Fp M = fp_add(limb[3], fp_add(fp_mul(limb[4], s52), fp_mul(limb[5], s104)));
+        acc = fp_add(acc, fp_sub(P, M));
+        p0 = p1 = p2 = m0 = m1 = m2 = z;
+    };
+
+    size_t i = 0, blocks = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i a0, a1, a2, b0, b1, b2, r0, r1, r2;
+        fp_ifma::load(a + i, a0, a1, a2);
+        fp_ifma::load(b + i, b0, b1, b2);
+        fp_ifma::mul(a0, a1, a2, b0, b1, b2, r0, r1, r2);
+
+        uint64_t c;
+        std::memcpy(&c, ch + i, 8);
+        __mmask8 neg = _mm512_test_epi64_mask(_mm512_maskz_cvtepu8_epi64(0xff, _mm_cvtsi64_si128((long long)c)),
+                                              _mm512_set1_epi64(0xff));
+        p0 = _mm512_mask_add_epi64(p0, (__mmask8)~neg, p0, r0);
+        p1 = _mm512_mask_add_epi64(p1, (__mmask8)~neg, p1, r1);
+        p2 = _mm512_mask_add_epi64(p2, (__mmask8)~neg, p2, r2);
+        m0 = _mm512_mask_add_epi64(m0, neg, m0, r0);
+        m1 = _mm512_mask_add_epi64(m1, neg, m1, r1);
+        m2 = _mm512_mask_add_epi64(m2, neg, m2, r2);
+
+        if (++blocks == 2048) {
+            drain();
+            blocks = 0;
+        }
+    }
+    drain();
+    return fp_add(acc, fp_dot_signed_scalar(a + i, b + i, ch + i, n - i));
+}
+
+#endif
+
+enum class FpImpl { SCALAR, AVX2, IFMA };
+
+namespace fp_detail {
+    inline const char * const NAMES[3] = {"scalar", "avx2", "ifma"};
+
+    inline void avail(bool ok[3]) {
+        ok[0] = true;
+#if defined(__AVX2__)
+        ok[1] = cpu_features().avx2;
+#else
+        ok[1] = false;
+#endif
+#if defined(__AVX512F__) && defined(__AVX512IFMA__)
+        ok[2] = cpu_features().avx512f && cpu_features().avx512ifma;
+#else
+        ok[2] = false;
+#endif
+    }
+
+    inline FpImpl pick() {
+        bool ok[3];
+        avail(ok);
+        return (FpImpl)impl_pick("fp", NAMES, ok, 3, ok[2] ? 2 : ok[1] ? 1 : 0);
+    }
+}
+
+inline FpBatchOps fp_batch_ops(FpImpl impl) {
+    switch (impl) {
+#if defined(__AVX512F__) && defined(__AVX512IFMA__)
+    case FpImpl::IFMA: return {&fp_mul_n_ifma, &fp_scale_n_ifma, &fp_add_n_ifma, &fp_dot_signed_ifma};
+#endif
+#if defined(__AVX2__)
+    case FpImpl::AVX2: return {&fp_mul_n_scalar, &fp_scale_n_scalar, &fp_add_n_avx2, &fp_dot_signed_scalar};
+#endif
+    default: return {&fp_mul_n_scalar, &fp_scale_n_scalar, &fp_add_n_scalar, &fp_dot_signed_scalar};
+    }
+}
+
+inline FpImpl fp_impl() {
+    static const FpImpl impl = fp_detail::pick();
+    return impl;
+}
+
+inline const char * fp_impl_name() {
+    return fp_detail::NAMES[(int)fp_impl()];
+}
+
+inline std::string fp_impl_avail() {
+    bool ok[3];
+    fp_detail::avail(ok);
+    return impl_avail_list(fp_detail::NAMES, ok, 3);
+}
+
+inline const bool g_fp_impl_reg = impl_register("fp", &fp_impl_name, &fp_impl_avail);
+
+inline const FpBatchOps & fp_ops() {
+    static const FpBatchOps ops = fp_batch_ops(fp_impl());
+    return ops;
+}
+
+inline void fp_mul_n(Fp* out, const Fp* a, const Fp* b, size_t n) {
+    fp_ops().mul_n(out, a, b, n);
+}
+
+inline void fp_scale_n(Fp* out, const Fp* a, const Fp& s, size_t n) {
+    fp_ops().scale_n(out, a, s, n);
+}
+
+inline void fp_add_n(Fp* out, const Fp* a, const Fp* b, size_t n) {
+    fp_ops().add_n(out, a, b, n);
+}
+
+inline Fp fp_dot_signed(const Fp* a, const Fp* b, const uint8_t* ch, size_t n) {
+    return fp_ops().dot_signed(a, b, ch, n);
+}
+
+}
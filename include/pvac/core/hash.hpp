@@ -9,9 +9,99 @@
 #include <iomanip>
 
 #include "random.hpp"
+#include "cpu.hpp"
+
+#if defined(__SHA__) && defined(__SSE4_1__)
+#include <immintrin.h>
+#define PVAC_USE_SHANI 1
+#else
+#define PVAC_USE_SHANI 0
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace pvac {
 
+// sha-256 compression function
+enum class ShaImpl { SCALAR, SHANI };
+
+namespace sha_detail {
+    inline const char * const NAMES[2] = {"scalar", "shani"};
+
+    inline void avail(bool ok[2]) {
+        ok[0] = true;
+        ok[1] = PVAC_USE_SHANI && cpu_features().sha;
+    }
+
+    inline ShaImpl pick() {
+        bool ok[2];
+        avail(ok);
+        return (ShaImpl)impl_pick("sha256", NAMES, ok, 2, ok[1] ? 1 : 0);
+    }
+}
+
+inline ShaImpl sha_impl() {
+    static const ShaImpl impl = sha_detail::pick();
+    return impl;
+}
+
+inline const char * sha_impl_name() {
+    return sha_detail::NAMES[(int)sha_impl()];
+}
+
+inline std::string sha_impl_avail() {
+    bool ok[2];
+    sha_detail::avail(ok);
+    return impl_avail_list(sha_detail::NAMES, ok, 2);
+}
+
+inline const bool g_sha_impl_reg = impl_register("sha256", &sha_impl_name, &sha_impl_avail);
+
+// sha256_many: one message at a time, or 8 messages across avx2 lanes
+enum class ShaManyImpl { LOOP, X8 };
+
+namespace sha_many_detail {
+    inline const char * const NAMES[2] = {"loop", "x8"};
+
+    inline void avail(bool ok[2]) {
+        ok[0] = true;
+#if defined(__AVX2__)
+        ok[1] = cpu_features().avx2;
+#else
+        ok[1] = false;
+#endif
+    }
+
+    inline ShaManyImpl pick() {
+        bool ok[2];
+        avail(ok);
+        return (ShaManyImpl)impl_pick("sha256_many", NAMES, ok, 2, ok[1] ? 1 : 0);
+    }
+}
+
+inline ShaManyImpl sha_many_impl() {
+    static const ShaManyImpl impl = sha_many_detail::pick();
+    return impl;
+}
+
+inline int sha_many_lanes() {
+    return sha_many_impl() == ShaManyImpl::X8 ? 8 : 1;
+}
+
+inline const char * sha_many_impl_name() {
+    return sha_many_detail::NAMES[(int)sha_many_impl()];
+}
+
+inline std::string sha_many_impl_avail() {
+    bool ok[2];
+    sha_many_detail::avail(ok);
+    return impl_avail_list(sha_many_detail::NAMES, ok, 2);
+}
+
+inline const bool g_sha_many_impl_reg = impl_register("sha256_many", &sha_many_impl_name, &sha_many_impl_avail);
+
 inline std::string hex8(const uint8_t* d, size_t n) {
     std::ostringstream os;
     os << std::hex << std::setfill('0');
@@ -87,7 +177,75 @@ struct Sha256 {
         ptr = 0;
     }
 
-    void process(const uint8_t* p) {
+    // nb consecutive 64 byte blocks
+    void process(const uint8_t* p, size_t nb = 1) {
+#if PVAC_USE_SHANI
+        if (sha_impl() == ShaImpl::SHANI) {
+            process_shani(h, p, nb);
+            return;
+        }
+#endif
+        for (size_t i = 0; i < nb; i++) process_scalar(p + 64 * i);
+    }
+
+#if PVAC_USE_SHANI
+    // state is kept as abef / cdgh for sha256rnds2, the schedule rolls
+    // through four message vectors with sha256msg1 / msg2
+    static void process_shani(uint32_t st[8], const uint8_t* p, size_t nb) {
+        // legacy sse encoding below, clear dirty upper state first
+        // (only reachable when the build can emit vex code at all)
+#if defined(__AVX__)
+        _mm256_zeroupper();
+#endif
+        const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bull, 0x0405060700010203ull);
+
+        __m128i t = _mm_loadu_si128((const __m128i*)&st[0]);
+        __m128i s1 = _mm_loadu_si128((const __m128i*)&st[4]);
+        t = _mm_shuffle_epi32(t, 0xB1);
+        s1 = _mm_shuffle_epi32(s1, 0x1B);
+        __m128i s0 = _mm_alignr_epi8(t, s1, 8);
+        s1 = _mm_blend_epi16(s1, t, 0xF0);
+
+        for (size_t b = 0; b < nb; b++, p += 64) {
+            __m128i abef = s0;
+            __m128i cdgh = s1;
+            __m128i m[4];
+
+#pragma GCC unroll 16
+            for (int g = 0; g < 16; g++) {
+                __m128i& w = m[g & 3];
+                if (g < 4) {
+                    w = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p + 16 * g)), bswap);
+                } else {
+                    const __m128i& w1 = m[(g + 1) & 3];
+                    const __m128i& w2 = m[(g + 2) & 3];
+                    const __m128i& w3 = m[(g + 3) & 3];
+                    w = _mm_sha256msg1_epu32(w, w1);
+                    w = _mm_add_epi32(w, _mm_alignr_epi8(w3, w2, 4));
+                    w = _mm_sha256msg2_epu32(w, w3);
+                }
+
+                __m128i x = _mm_add_epi32(w, _mm_loadu_si128((const __m128i*)&K[4 * g]));
+                s1 = _mm_sha256rnds2_epu32(s1, s0, x);
+                x = _mm_shuffle_epi32(x, 0x0E);
+                s0 = _mm_sha256rnds2_epu32(s0, s1, x);
+            }
+
+            s0 = _mm_add_epi32(s0, abef);
+            s1 = _mm_add_epi32(s1, cdgh);
+        }
+
+        t = _mm_shuffle_epi32(s0, 0x1B);
+        s1 = _mm_shuffle_epi32(s1, 0xB1);
+        s0 = _mm_blend_epi16(t, s1, 0xF0);
+        s1 = _mm_alignr_epi8(s1, t, 8);
+
+        _mm_storeu_si128((__m128i*)&st[0], s0);
+        _mm_storeu_si128((__m128i*)&st[4], s1);
+    }
+#endif
+
+    void process_scalar(const uint8_t* p) {
         uint32_t w[64];
 
         for (int i = 0; i < 16; i++) {
@@ -138,6 +296,15 @@ struct Sha256 {
         len += n;
 
         while (n) {
+            // whole blocks straight from the input
+            if (ptr == 0 && n >= 64) {
+                size_t nb = n / 64;
+                process(p, nb);
+                p += 64 * nb;
+                n -= 64 * nb;
+                continue;
+            }
+
             size_t take = std::min((size_t)64 - ptr, n);
             std::memcpy(buf + ptr, p, take);
             ptr += take;
@@ -154,19 +321,19 @@ struct Sha256 {
     void finish(uint8_t out[32]) {
         uint64_t bitlen = len * 8;
 
-        uint8_t b0 = 0x80;
-        update(&b0, 1);
-
-        uint8_t z = 0;
-        while (ptr != 56) {
-            update(&z, 1);
+        buf[ptr++] = 0x80;
+        if (ptr > 56) {
+            std::memset(buf + ptr, 0, 64 - ptr);
+            process(buf);
+            ptr = 0;
         }
+        std::memset(buf + ptr, 0, 56 - ptr);
 
-        uint8_t be[8];
         for (int i = 0; i < 8; i++) {
-            be[7 - i] = (uint8_t)(bitlen >> (i * 8));
+            buf[63 - i] = (uint8_t)(bitlen >> (i * 8));
         }
-        update(be, 8);
+        process(buf);
+        ptr = 0;
 
         for (int i = 0; i < 8; i++) {
             out[4 * i + 0] = (h[i] >> 24) & 0xFF;
@@ -190,13 +357,142 @@ inline void sha256_acc_u64(Sha256& s, uint64_t x) {
     s.update(b, 8);
 }
 
-struct Shake256 {
-    uint64_t st[25];
-    size_t rate;
-    size_t pos;
-    bool squeezing;
+#if defined(__AVX2__)
+
+namespace sha_detail {
+    inline __m256i rotr8(__m256i x, int n) {
+        return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+    }
+
+    inline uint32_t be32(const uint8_t* p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+    }
+}
+
+// one block for each of 8 independent states, lane j of st[i] is word i
+// of message j
+inline void sha256_process_x8(__m256i st[8], const uint8_t* const blk[8]) {
+    using namespace sha_detail;
+
+    __m256i w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = _mm256_set_epi32(
+            (int)be32(blk[7] + 4 * i), (int)be32(blk[6] + 4 * i),
+            (int)be32(blk[5] + 4 * i), (int)be32(blk[4] + 4 * i),
+            (int)be32(blk[3] + 4 * i), (int)be32(blk[2] + 4 * i),
+            (int)be32(blk[1] + 4 * i), (int)be32(blk[0] + 4 * i));
+    }
+
+    __m256i a = st[0], b = st[1], c = st[2], d = st[3];
+    __m256i e = st[4], f = st[5], g = st[6], h = st[7];
+
+    for (int i = 0; i < 64; i++) {
+        __m256i wi;
+        if (i < 16) {
+            wi = w[i];
+        } else {
+            __m256i w15 = w[(i - 15) & 15];
+            __m256i w2 = w[(i - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr8(w15, 7), rotr8(w15, 18)), _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr8(w2, 17), rotr8(w2, 19)), _mm256_srli_epi32(w2, 10));
+            wi = _mm256_add_epi32(_mm256_add_epi32(w[i & 15], s0), _mm256_add_epi32(w[(i - 7) & 15], s1));
+            w[i & 15] = wi;
+        }
+
+        __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(rotr8(e, 6), rotr8(e, 11)), rotr8(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, S1), _mm256_add_epi32(ch, wi));
+        t1 = _mm256_add_epi32(t1, _mm256_set1_epi32((int)Sha256::K[i]));
+
+        __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(rotr8(a, 2), rotr8(a, 13)), rotr8(a, 22));
+        __m256i maj = _mm256_xor_si256(_mm256_and_si256(a, _mm256_xor_si256(b, c)), _mm256_and_si256(b, c));
+        __m256i t2 = _mm256_add_epi32(S0, maj);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    st[0] = _mm256_add_epi32(st[0], a);
+    st[1] = _mm256_add_epi32(st[1], b);
+    st[2] = _mm256_add_epi32(st[2], c);
+    st[3] = _mm256_add_epi32(st[3], d);
+    st[4] = _mm256_add_epi32(st[4], e);
+    st[5] = _mm256_add_epi32(st[5], f);
+    st[6] = _mm256_add_epi32(st[6], g);
+    st[7] = _mm256_add_epi32(st[7], h);
+}
+
+// 8 messages of the same length through the lanes of sha256_process_x8;
+// only lanes < n are written out
+inline void sha256_x8(const uint8_t* const* msg, size_t len, uint8_t (*out)[32], size_t n) {
+    size_t nb = (len + 9 + 63) / 64;
+
+    thread_local std::vector<uint8_t> pad;
+    pad.assign(8 * nb * 64, 0);
+
+    const uint8_t* blk[8];
+    for (size_t j = 0; j < 8; j++) {
+        uint8_t* q = pad.data() + j * nb * 64;
+        const uint8_t* m = msg[j < n ? j : 0];
+        if (len) std::memcpy(q, m, len);
+        q[len] = 0x80;
+        uint64_t bitlen = (uint64_t)len * 8;
+        for (int i = 0; i < 8; i++) q[nb * 64 - 1 - i] = (uint8_t)(bitlen >> (8 * i));
+    }
+
+    static const uint32_t IV[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    __m256i st[8];
+    for (int i = 0; i < 8; i++) st[i] = _mm256_set1_epi32((int)IV[i]);
 
-    static constexpr uint64_t RC[24] = {
+    for (size_t b = 0; b < nb; b++) {
+        for (size_t j = 0; j < 8; j++) blk[j] = pad.data() + (j * nb + b) * 64;
+        sha256_process_x8(st, blk);
+    }
+
+    alignas(32) uint32_t lane[8][8];
+    for (int i = 0; i < 8; i++) _mm256_store_si256((__m256i*)lane[i], st[i]);
+
+    for (size_t j = 0; j < n && j < 8; j++) {
+        for (int i = 0; i < 8; i++) {
+            uint32_t x = lane[i][j];
+            out[j][4 * i + 0] = (uint8_t)(x >> 24);
+            out[j][4 * i + 1] = (uint8_t)(x >> 16);
+            out[j][4 * i + 2] = (uint8_t)(x >> 8);
+            out[j][4 * i + 3] = (uint8_t)x;
+        }
+    }
+}
+
+#endif
+
+// n independent messages of one length, e.g. all ztags of a layer grid;
+// 8 lanes at a time with avx2, a plain loop for what is left
+inline void sha256_many(const uint8_t* const* msg, size_t len, uint8_t (*out)[32], size_t n) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    if (sha_many_lanes() == 8) {
+        for (; i + 8 <= n; i += 8) sha256_x8(msg + i, len, out + i, 8);
+        if (n - i > 2) {
+            sha256_x8(msg + i, len, out + i, n - i);
+            i = n;
+        }
+    }
+#endif
+    for (; i < n; i++) sha256_bytes(msg[i], len, out[i]);
+}
+
+namespace keccak_detail {
+    inline constexpr uint64_t RC[24] = {
         0x0000000000000001ULL, 0x0000000000008082ULL,
         0x800000000000808aULL, 0x8000000080008000ULL,
         0x000000000000808bULL, 0x0000000080000001ULL,
@@ -211,53 +507,180 @@ struct Shake256 {
         0x0000000080000001ULL, 0x8000000080008008ULL
     };
 
-    static constexpr int ROT[5][5] = {
-        {  0, 36,  3, 41, 18 },
-        {  1, 44, 10, 45,  2 },
-        { 62,  6, 43, 15, 61 },
-        { 28, 55, 25, 21, 56 },
-        { 27, 20, 39,  8, 14 }
-    };
-
-    static uint64_t rotl(uint64_t x, int r) {
+    inline uint64_t rotl64(uint64_t x, int r) {
         return (x << r) | (x >> (64 - r));
     }
+}
 
-    void keccakf() {
-        for (int round = 0; round < 24; ++round) {
-            uint64_t C[5];
-            for (int x = 0; x < 5; x++) {
-                C[x] = st[x] ^ st[x + 5] ^ st[x + 10] ^ st[x + 15] ^ st[x + 20];
-            }
+// keccak-f[1600], one round body written out (theta, rho + pi into b,
+// chi back into a, iota); lane (x, y) is a[x + 5 y]
+inline void keccakf1600(uint64_t a[25]) {
+    using namespace keccak_detail;
+
+    for (int round = 0; round < 24; ++round) {
+        uint64_t c0 = a[0] ^ a[5] ^ a[10] ^ a[15] ^ a[20];
+        uint64_t c1 = a[1] ^ a[6] ^ a[11] ^ a[16] ^ a[21];
+        uint64_t c2 = a[2] ^ a[7] ^ a[12] ^ a[17] ^ a[22];
+        uint64_t c3 = a[3] ^ a[8] ^ a[13] ^ a[18] ^ a[23];
+        uint64_t c4 = a[4] ^ a[9] ^ a[14] ^ a[19] ^ a[24];
+        uint64_t d0 = c4 ^ rotl64(c1, 1);
+        uint64_t d1 = c0 ^ rotl64(c2, 1);
+        uint64_t d2 = c1 ^ rotl64(c3, 1);
+        uint64_t d3 = c2 ^ rotl64(c4, 1);
+        uint64_t d4 = c3 ^ rotl64(c0, 1);
+        uint64_t b0 = a[0] ^ d0;
+        uint64_t b16 = rotl64(a[5] ^ d0, 36);
+        uint64_t b7 = rotl64(a[10] ^ d0, 3);
+        uint64_t b23 = rotl64(a[15] ^ d0, 41);
+        uint64_t b14 = rotl64(a[20] ^ d0, 18);
+        uint64_t b10 = rotl64(a[1] ^ d1, 1);
+        uint64_t b1 = rotl64(a[6] ^ d1, 44);
+        uint64_t b17 = rotl64(a[11] ^ d1, 10);
+        uint64_t b8 = rotl64(a[16] ^ d1, 45);
+        uint64_t b24 = rotl64(a[21] ^ d1, 2);
+        uint64_t b20 = rotl64(a[2] ^ d2, 62);
+        uint64_t b11 = rotl64(a[7] ^ d2, 6);
+        uint64_t b2 = rotl64(a[12] ^ d2, 43);
+        uint64_t b18 = rotl64(a[17] ^ d2, 15);
+        uint64_t b9 = rotl64(a[22] ^ d2, 61);
+        uint64_t b5 = rotl64(a[3] ^ d3, 28);
+        uint64_t b21 = rotl64(a[8] ^ d3, 55);
+        uint64_t b12 = rotl64(a[13] ^ d3, 25);
+        uint64_t b3 = rotl64(a[18] ^ d3, 21);
+        uint64_t b19 = rotl64(a[23] ^ d3, 56);
+        uint64_t b15 = rotl64(a[4] ^ d4, 27);
+        uint64_t b6 = rotl64(a[9] ^ d4, 20);
+        uint64_t b22 = rotl64(a[14] ^ d4, 39);
+        uint64_t b13 = rotl64(a[19] ^ d4, 8);
+        uint64_t b4 = rotl64(a[24] ^ d4, 14);
+        a[0] = b0 ^ (~b1 & b2);
+        a[1] = b1 ^ (~b2 & b3);
+        a[2] = b2 ^ (~b3 & b4);
+        a[3] = b3 ^ (~b4 & b0);
+        a[4] = b4 ^ (~b0 & b1);
+        a[5] = b5 ^ (~b6 & b7);
+        a[6] = b6 ^ (~b7 & b8);
+        a[7] = b7 ^ (~b8 & b9);
+        a[8] = b8 ^ (~b9 & b5);
+        a[9] = b9 ^ (~b5 & b6);
+        a[10] = b10 ^ (~b11 & b12);
+        a[11] = b11 ^ (~b12 & b13);
+        a[12] = b12 ^ (~b13 & b14);
+        a[13] = b13 ^ (~b14 & b10);
+        a[14] = b14 ^ (~b10 & b11);
+        a[15] = b15 ^ (~b16 & b17);
+        a[16] = b16 ^ (~b17 & b18);
+        a[17] = b17 ^ (~b18 & b19);
+        a[18] = b18 ^ (~b19 & b15);
+        a[19] = b19 ^ (~b15 & b16);
+        a[20] = b20 ^ (~b21 & b22);
+        a[21] = b21 ^ (~b22 & b23);
+        a[22] = b22 ^ (~b23 & b24);
+        a[23] = b23 ^ (~b24 & b20);
+        a[24] = b24 ^ (~b20 & b21);
+        a[0] ^= RC[round];
+    }
+}
 
-            uint64_t D[5];
-            for (int x = 0; x < 5; x++) {
-                D[x] = C[(x + 4) % 5] ^ rotl(C[(x + 1) % 5], 1);
-            }
+#if defined(__AVX2__)
+
+namespace keccak_detail {
+    inline __m256i rol4(__m256i x, int r) {
+#if defined(__AVX512VL__)
+        switch (r) {
+#define PVAC_ROL4(n) case n: return _mm256_rol_epi64(x, n);
+        PVAC_ROL4(1) PVAC_ROL4(2) PVAC_ROL4(3) PVAC_ROL4(6) PVAC_ROL4(8)
+        PVAC_ROL4(10) PVAC_ROL4(14) PVAC_ROL4(15) PVAC_ROL4(18) PVAC_ROL4(20)
+        PVAC_ROL4(21) PVAC_ROL4(25) PVAC_ROL4(27) PVAC_ROL4(28) PVAC_ROL4(36)
+        PVAC_ROL4(39) PVAC_ROL4(41) PVAC_ROL4(43) PVAC_ROL4(44) PVAC_ROL4(45)
+        PVAC_ROL4(55) PVAC_ROL4(56) PVAC_ROL4(61) PVAC_ROL4(62)
+#undef PVAC_ROL4
+        default: break;
+        }
+#endif
+        return _mm256_or_si256(_mm256_slli_epi64(x, r), _mm256_srli_epi64(x, 64 - r));
+    }
+}
 
-            for (int x = 0; x < 5; x++) {
-                for (int y = 0; y < 5; y++) {
-                    st[x + 5 * y] ^= D[x];
-                }
-            }
+// four independent states in lockstep, lane j of a[i] is word i of state j
+inline void keccakf1600_x4(__m256i a[25]) {
+    using namespace keccak_detail;
+
+    for (int round = 0; round < 24; ++round) {
+        __m256i c0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(a[0], a[5]), a[10]), a[15]), a[20]);
+        __m256i c1 = _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(a[1], a[6]), a[11]), a[16]), a[21]);
+        __m256i c2 = _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(a[2], a[7]), a[12]), a[17]), a[22]);
+        __m256i c3 = _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(a[3], a[8]), a[13]), a[18]), a[23]);
+        __m256i c4 = _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(a[4], a[9]), a[14]), a[19]), a[24]);
+        __m256i d0 = _mm256_xor_si256(c4, rol4(c1, 1));
+        __m256i d1 = _mm256_xor_si256(c0, rol4(c2, 1));
+        __m256i d2 = _mm256_xor_si256(c1, rol4(c3, 1));
+        __m256i d3 = _mm256_xor_si256(c2, rol4(c4, 1));
+        __m256i d4 = _mm256_xor_si256(c3, rol4(c0, 1));
+        __m256i b0 = _mm256_xor_si256(a[0], d0);
+        __m256i b16 = rol4(_mm256_xor_si256(a[5], d0), 36);
+        __m256i b7 = rol4(_mm256_xor_si256(a[10], d0), 3);
+        __m256i b23 = rol4(_mm256_xor_si256(a[15], d0), 41);
+        __m256i b14 = rol4(_mm256_xor_si256(a[20], d0), 18);
+        __m256i b10 = rol4(_mm256_xor_si256(a[1], d1), 1);
+        __m256i b1 = rol4(_mm256_xor_si256(a[6], d1), 44);
+        __m256i b17 = rol4(_mm256_xor_si256(a[11], d1), 10);
+        __m256i b8 = rol4(_mm256_xor_si256(a[16], d1), 45);
+        __m256i b24 = rol4(_mm256_xor_si256(a[21], d1), 2);
+        __m256i b20 = rol4(_mm256_xor_si256(a[2], d2), 62);
+        __m256i b11 = rol4(_mm256_xor_si256(a[7], d2), 6);
+        __m256i b2 = rol4(_mm256_xor_si256(a[12], d2), 43);
+        __m256i b18 = rol4(_mm256_xor_si256(a[17], d2), 15);
+        __m256i b9 = rol4(_mm256_xor_si256(a[22], d2), 61);
+        __m256i b5 = rol4(_mm256_xor_si256(a[3], d3), 28);
+        __m256i b21 = rol4(_mm256_xor_si256(a[8], d3), 55);
+        __m256i b12 = rol4(_mm256_xor_si256(a[13], d3), 25);
+        __m256i b3 = rol4(_mm256_xor_si256(a[18], d3), 21);
+        __m256i b19 = rol4(_mm256_xor_si256(a[23], d3), 56);
+        __m256i b15 = rol4(_mm256_xor_si256(a[4], d4), 27);
+        __m256i b6 = rol4(_mm256_xor_si256(a[9], d4), 20);
+        __m256i b22 = rol4(_mm256_xor_si256(a[14], d4), 39);
+        __m256i b13 = rol4(_mm256_xor_si256(a[19], d4), 8);
+        __m256i b4 = rol4(_mm256_xor_si256(a[24], d4), 14);
+        a[0] = _mm256_xor_si256(b0, _mm256_andnot_si256(b1, b2));
+        a[1] = _mm256_xor_si256(b1, _mm256_andnot_si256(b2, b3));
+        a[2] = _mm256_xor_si256(b2, _mm256_andnot_si256(b3, b4));
+        a[3] = _mm256_xor_si256(b3, _mm256_andnot_si256(b4, b0));
+        a[4] = _mm256_xor_si256(b4, _mm256_andnot_si256(b0, b1));
+        a[5] = _mm256_xor_si256(b5, _mm256_andnot_si256(b6, b7));
+        a[6] = _mm256_xor_si256(b6, _mm256_andnot_si256(b7, b8));
+        a[7] = _mm256_xor_si256(b7, _mm256_andnot_si256(b8, b9));
+        a[8] = _mm256_xor_si256(b8, _mm256_andnot_si256(b9, b5));
+        a[9] = _mm256_xor_si256(b9, _mm256_andnot_si256(b5, b6));
+        a[10] = _mm256_xor_si256(b10, _mm256_andnot_si256(b11, b12));
+        a[11] = _mm256_xor_si256(b11, _mm256_andnot_si256(b12, b13));
+        a[12] = _mm256_xor_si256(b12, _mm256_andnot_si256(b13, b14));
+        a[13] = _mm256_xor_si256(b13, _mm256_andnot_si256(b14, b10));
+        a[14] = _mm256_xor_si256(b14, _mm256_andnot_si256(b10, b11));
+        a[15] = _mm256_xor_si256(b15, _mm256_andnot_si256(b16, b17));
+        a[16] = _mm256_xor_si256(b16, _mm256_andnot_si256(b17, b18));
+        a[17] = _mm256_xor_si256(b17, _mm256_andnot_si256(b18, b19));
+        a[18] = _mm256_xor_si256(b18, _mm256_andnot_si256(b19, b15));
+        a[19] = _mm256_xor_si256(b19, _mm256_andnot_si256(b15, b16));
+        a[20] = _mm256_xor_si256(b20, _mm256_andnot_si256(b21, b22));
+        a[21] = _mm256_xor_si256(b21, _mm256_andnot_si256(b22, b23));
+        a[22] = _mm256_xor_si256(b22, _mm256_andnot_si256(b23, b24));
+        a[23] = _mm256_xor_si256(b23, _mm256_andnot_si256(b24, b20));
+        a[24] = _mm256_xor_si256(b24, _mm256_andnot_si256(b20, b21));
+        a[0] = _mm256_xor_si256(a[0], _mm256_set1_epi64x((long long)RC[round]));
+    }
+}
 
-            uint64_t B[25];
-            for (int x = 0; x < 5; x++) {
-                for (int y = 0; y < 5; y++) {
-                    int X = y;
-                    int Y = (2 * x + 3 * y) % 5;
-                    B[X + 5 * Y] = rotl(st[x + 5 * y], ROT[x][y]);
-                }
-            }
+#endif
 
-            for (int x = 0; x < 5; x++) {
-                for (int y = 0; y < 5; y++) {
-                    st[x + 5 * y] = B[x + 5 * y] ^ ((~B[(x + 1) % 5 + 5 * y]) & B[(x + 2) % 5 + 5 * y]);
-                }
-            }
+struct Shake256 {
+    uint64_t st[25];
+    size_t rate;
+    size_t pos;
+    bool squeezing;
 
-            st[0] ^= RC[round];
-        }
+    void keccakf() {
+        keccakf1600(st);
     }
 
     void init() {
@@ -281,12 +704,18 @@ struct Shake256 {
             }
 
             size_t take = std::min(rate - pos, len - i);
+            size_t j = 0;
+
+            // whole lanes once pos is on a word boundary
+            if ((pos & 7) == 0) {
+                for (; j + 8 <= take; j += 8) {
+                    st[(pos + j) >> 3] ^= load_le64(data + i + j);
+                }
+            }
 
-            for (size_t j = 0; j < take; j++) {
+            for (; j < take; j++) {
                 size_t idx = pos + j;
-                size_t w = idx / 8;
-                size_t sh = (idx % 8) * 8;
-                st[w] ^= (uint64_t)data[i + j] << sh;
+                st[idx >> 3] ^= (uint64_t)data[i + j] << ((idx & 7) * 8);
             }
 
             pos += take;
@@ -295,6 +724,12 @@ struct Shake256 {
     }
 
     void pad() {
+        // a message that filled the block exactly pads into a fresh one
+        if (pos == rate) {
+            keccakf();
+            pos = 0;
+        }
+
         size_t idx = pos;
         size_t w = idx / 8;
         size_t sh = (idx % 8) * 8;
@@ -327,12 +762,17 @@ struct Shake256 {
             }
 
             size_t take = std::min(rate - pos, len - i);
+            size_t j = 0;
+
+            if ((pos & 7) == 0) {
+                for (; j + 8 <= take; j += 8) {
+                    store_le64(out + i + j, st[(pos + j) >> 3]);
+                }
+            }
 
-            for (size_t j = 0; j < take; j++) {
+            for (; j < take; j++) {
                 size_t idx = pos + j;
-                size_t w = idx / 8;
-                size_t sh = (idx % 8) * 8;
-                out[i + j] = (uint8_t)((st[w] >> sh) & 0xFF);
+                out[i + j] = (uint8_t)(st[idx >> 3] >> ((idx & 7) * 8));
             }
 
             pos += take;
@@ -341,6 +781,15 @@ struct Shake256 {
     }
 
     uint64_t next_u64() {
+        if (squeezing && (pos & 7) == 0) {
+            if (pos == rate) {
+                keccakf();
+                pos = 0;
+            }
+            uint64_t x = st[pos >> 3];
+            pos += 8;
+            return x;
+        }
         uint8_t b[8];
         squeeze(b, 8);
         return load_le64(b);
@@ -383,4 +832,129 @@ struct XofShake {
     }
 };
 
-}
\ No newline at end of file
+// keccak-f x4 backend for XofShake4: four scalar states or one avx2 state
+enum class Keccak4Impl { SCALAR, AVX2 };
+
+namespace keccak4_detail {
+    inline const char * const NAMES[2] = {"scalar", "avx2"};
+
+    inline void avail(bool ok[2]) {
+        ok[0] = true;
+#if defined(__AVX2__)
+        ok[1] = cpu_features().avx2;
+#else
+        ok[1] = false;
+#endif
+    }
+
+    inline Keccak4Impl pick() {
+        bool ok[2];
+        avail(ok);
+        return (Keccak4Impl)impl_pick("keccak4", NAMES, ok, 2, ok[1] ? 1 : 0);
+    }
+}
+
+inline Keccak4Impl keccak4_impl() {
+    static const Keccak4Impl impl = keccak4_detail::pick();
+    return impl;
+}
+
+inline const char * keccak4_impl_name() {
+    return keccak4_detail::NAMES[(int)keccak4_impl()];
+}
+
+inline std::string keccak4_impl_avail() {
+    bool ok[2];
+    keccak4_detail::avail(ok);
+    return impl_avail_list(keccak4_detail::NAMES, ok, 2);
+}
+
+inline const bool g_keccak4_impl_reg = impl_register("keccak4", &keccak4_impl_name, &keccak4_impl_avail);
+
+// four XofShake streams in lockstep, for bulk derivations that need many
+// independent streams; lane j gives exactly what XofShake::init(label,
+// seeds[j]) gives. all four seeds have to be the same length
+struct XofShake4 {
+    static constexpr size_t RATE = 136;
+
+#if defined(__AVX2__)
+    __m256i st[25];
+#endif
+    Shake256 sc[4];
+    size_t pos = 0;
+    bool wide = false;
+
+    void init(const std::string& label, const std::vector<uint64_t> seeds[4]) {
+        for (int j = 1; j < 4; j++) {
+            if (seeds[j].size() != seeds[0].size()) std::abort();
+        }
+
+        wide = keccak4_impl() == Keccak4Impl::AVX2;
+
+        if (!wide) {
+            for (int j = 0; j < 4; j++) {
+                sc[j].init();
+                sc[j].absorb((const uint8_t*)label.data(), label.size());
+                for (uint64_t w : seeds[j]) {
+                    uint8_t b[8];
+                    store_le64(b, w);
+                    sc[j].absorb(b, 8);
+                }
+                sc[j].pad();
+            }
+            return;
+        }
+
+#if defined(__AVX2__)
+        // whole padded message per lane, then rate sized blocks
+        size_t len = label.size() + 8 * seeds[0].size();
+        size_t nb = len / RATE + 1;
+
+        thread_local std::vector<uint8_t> msg;
+        msg.assign(4 * nb * RATE, 0);
+
+        for (int j = 0; j < 4; j++) {
+            uint8_t* q = msg.data() + (size_t)j * nb * RATE;
+            std::memcpy(q, label.data(), label.size());
+            for (size_t i = 0; i < seeds[j].size(); i++) store_le64(q + label.size() + 8 * i, seeds[j][i]);
+            q[len] ^= 0x1F;
+            q[nb * RATE - 1] ^= 0x80;
+        }
+
+        for (auto& x : st) x = _mm256_setzero_si256();
+
+        for (size_t b = 0; b < nb; b++) {
+            const uint8_t* q0 = msg.data() + (0 * nb + b) * RATE;
+            const uint8_t* q1 = msg.data() + (1 * nb + b) * RATE;
+            const uint8_t* q2 = msg.data() + (2 * nb + b) * RATE;
+            const uint8_t* q3 = msg.data() + (3 * nb + b) * RATE;
+            for (size_t w = 0; w < RATE / 8; w++) {
+                __m256i v = _mm256_set_epi64x(
+                    (long long)load_le64(q3 + 8 * w), (long long)load_le64(q2 + 8 * w),
+                    (long long)load_le64(q1 + 8 * w), (long long)load_le64(q0 + 8 * w));
+                st[w] = _mm256_xor_si256(st[w], v);
+            }
+            keccakf1600_x4(st);
+        }
+        pos = 0;
+#endif
+    }
+
+    void take_u64(uint64_t out[4]) {
+        if (!wide) {
+            for (int j = 0; j < 4; j++) out[j] = sc[j].next_u64();
+            return;
+        }
+
+#if defined(__AVX2__)
+        if (pos == RATE) {
+            keccakf1600_x4(st);
+            pos = 0;
+        }
+        _mm256_storeu_si256((__m256i*)out, st[pos >> 3]);
+        pos += 8;
+#endif
+    }
+};
+
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <algorithm>
+
+#include "config.hpp"
+#include "random.hpp"
+
+namespace pvac {
+
+// fixed set of workers, the calling thread joins in on every job;
+// nested parallel_for calls (from inside a job) run inline. the workers
+// do not exist in a child after fork(), so there every job runs inline
+// and the pool's locks are never touched again
+struct ThreadPool {
+    explicit ThreadPool(int nthreads) : fork_gen(g_fork_gen.load(std::memory_order_relaxed)) {
+        int nw = std::max(0, nthreads - 1);
+        workers.reserve((size_t)nw);
+        for (int i = 0; i < nw; i++) {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        // the threads behind these handles died with the fork, and both
+        // join and detach fail on them; leak the handles and the locks
+        if (forked()) {
+            new std::vector<std::thread>(std::move(workers));
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lk(sy->mu);
+            stop = true;
+        }
+        sy->cv_job.notify_all();
+        for (auto & t : workers) t.join();
+        delete sy;
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool & operator=(const ThreadPool &) = delete;
+
+    int size() const {
+        return (int)workers.size() + 1;
+    }
+
+    // fn(begin, end) over [0, n) in chunks of `grain`
+    void parallel_for_chunks(size_t n, size_t grain, const std::function<void(size_t, size_t)> & fn) {
+        if (n == 0) return;
+        grain = std::max<size_t>(1, grain);
+
+        if (workers.empty() || in_job() || n <= grain || forked()) {
+            fn(0, n);
+            return;
+        }
+
+        // one job at a time; a caller that finds the pool busy does its
+        // own work inline rather than queueing behind the running job
+        std::unique_lock<std::mutex> run(sy->run_mu, std::try_to_lock);
+        if (!run.owns_lock()) {
+            fn(0, n);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(sy->mu);
+            body = &fn;
+            total = n;
+            step = grain;
+            next.store(0, std::memory_order_relaxed);
+            active = (int)workers.size();
+            gen++;
+        }
+        sy->cv_job.notify_all();
+
+        in_job() = true;
+        run_chunks(fn, n, grain);
+        in_job() = false;
+
+        std::unique_lock<std::mutex> lk(sy->mu);
+        sy->cv_done.wait(lk, [this] { return active == 0; });
+        body = nullptr;
+    }
+
+    // fn(i) for every i in [0, n)
+    template <class F>
+    void parallel_for(size_t n, F && fn, size_t grain = 1) {
+        parallel_for_chunks(n, grain, [&fn](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) fn(i);
+        });
+    }
+
+private:
+    std::vector<std::thread> workers;
+
+    // on the heap so a forked child can walk away from them: the dead
+    // workers may still count as waiters, and destroying cv_job would
+    // wait on them forever
+    struct Sync {
+        std::mutex run_mu;
+        std::mutex mu;
+        std::condition_variable cv_job;
+        std::condition_variable cv_done;
+    };
+    Sync * sy = new Sync;
+
+    const std::function<void(size_t, size_t)> * body = nullptr;
+    size_t total = 0;
+    size_t step = 1;
+    std::atomic<size_t> next{0};
+    int active = 0;
+    uint64_t gen = 0;
+    bool stop = false;
+    uint64_t fork_gen;
+
+    bool forked() const {
+        return fork_gen != g_fork_gen.load(std::memory_order_relaxed);
+    }
+
+    static bool & in_job() {
+        thread_local bool f = false;
+        return f;
+    }
+
+    void run_chunks(const std::function<void(size_t, size_t)> & fn, size_t n, size_t grain) {
+        for (;;) {
+            size_t b = next.fetch_add(grain, std::memory_order_relaxed);
+            if (b >= n) break;
+            fn(b, std::min(n, b + grain));
+        }
+    }
+
+    void worker_loop() {
+        in_job() = true;
+        uint64_t seen = 0;
+
+        for (;;) {
+            const std::function<void(size_t, size_t)> * fn;
+            size_t n, grain;
+
+            {
+                std::unique_lock<std::mutex> lk(sy->mu);
+                sy->cv_job.wait(lk, [&] { return stop || gen != seen; });
+                if (stop) return;
+                seen = gen;
+                fn = body;
+                n = total;
+                grain = step;
+            }
+
+            run_chunks(*fn, n, grain);
+
+            {
+                std::lock_guard<std::mutex> lk(sy->mu);
+                if (--active == 0) sy->cv_done.notify_one();
+            }
+        }
+    }
+};
+
+// process wide pool sized by PVAC_THREADS (see config.hpp)
+inline ThreadPool & default_pool() {
+    static ThreadPool pool(g_threads);
+    return pool;
+}
+
+template <class F>
+inline void parallel_for(size_t n, F && fn, size_t grain = 1) {
+    default_pool().parallel_for(n, std::forward<F>(fn), grain);
+}
+
+}
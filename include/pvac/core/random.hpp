@@ -4,10 +4,15 @@
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <atomic>
+
+#include "aes_ctr.hpp"
 
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
     #include <stdlib.h>
+    #include <pthread.h>
 #elif defined(__linux__)
+    #include <pthread.h>
     #include <unistd.h>
     #include <sys/random.h>
     #include <fcntl.h>
@@ -37,7 +42,12 @@ inline void store_le64(uint8_t * p, uint64_t x) {
     }
 }
 
-inline void csprng_bytes(uint8_t * out, size_t n) {
+inline std::atomic<uint64_t> g_os_entropy_calls{0};
+
+// raw os entropy, only used to key the drbg below
+inline void os_entropy_bytes(uint8_t * out, size_t n) {
+    g_os_entropy_calls.fetch_add(1, std::memory_order_relaxed);
+
 #if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
     arc4random_buf(out, n);
 
@@ -103,10 +113,150 @@ inline void csprng_bytes(uint8_t * out, size_t n) {
 #endif
 }
 
+// bumped in the child after fork(), every thread drbg rekeys on mismatch
+inline std::atomic<uint64_t> g_fork_gen{0};
+
+#if defined(__unix__) || defined(__APPLE__)
+inline const bool g_fork_hook = []() {
+    pthread_atfork(nullptr, nullptr, []() {
+        g_fork_gen.fetch_add(1, std::memory_order_relaxed);
+    });
+    return true;
+}();
+#endif
+
+struct CsprngStats {
+    uint64_t u64_draws = 0;
+    uint64_t byte_draws = 0;
+    uint64_t refills = 0;
+    uint64_t reseeds = 0;
+};
+
+// thread local aes-256-ctr drbg keyed from the os, with fast key erasure:
+// the first 32 bytes of every refill become the next key, served words
+// are wiped from the buffer, and a fresh os key is mixed in every
+// RESEED_BYTES of output or after fork
+struct Drbg {
+    static constexpr size_t BUF_WORDS = 512;
+    static constexpr size_t KEY_WORDS = 4;
+    static constexpr uint64_t RESEED_BYTES = 1ull << 20;
+
+    AesCtr256 aes;
+    alignas(64) uint64_t buf[BUF_WORDS];
+    size_t pos = BUF_WORDS;
+    uint64_t since_reseed = 0;
+    uint64_t fork_gen = 0;
+    bool seeded = false;
+    CsprngStats st;
+
+    ~Drbg() {
+        wipe();
+    }
+
+    void wipe() {
+        volatile uint64_t * p = buf;
+        for (size_t i = 0; i < BUF_WORDS; i++) p[i] = 0;
+        pos = BUF_WORDS;
+    }
+
+    void rekey(const uint64_t k[KEY_WORDS]) {
+        uint8_t key[32];
+        for (size_t i = 0; i < KEY_WORDS; i++) store_le64(key + 8 * i, k[i]);
+        aes.init(key, 0);
+
+        volatile uint8_t * kp = key;
+        for (size_t i = 0; i < 32; i++) kp[i] = 0;
+    }
+
+    void reseed() {
+        uint64_t k[KEY_WORDS];
+        os_entropy_bytes((uint8_t *)k, sizeof(k));
+
+        // keep the old state in the mix so a weak os read can't rewind us
+        if (seeded) {
+            uint64_t prev[KEY_WORDS];
+            aes.fill_u64(prev, KEY_WORDS);
+            for (size_t i = 0; i < KEY_WORDS; i++) k[i] ^= prev[i];
+        }
+
+        rekey(k);
+        since_reseed = 0;
+        fork_gen = g_fork_gen.load(std::memory_order_relaxed);
+        seeded = true;
+        st.reseeds++;
+    }
+
+    void refill() {
+        if (!seeded || since_reseed >= RESEED_BYTES) {
+            reseed();
+        }
+
+        aes.fill_u64(buf, BUF_WORDS);
+        rekey(buf);
+        std::memset(buf, 0, KEY_WORDS * 8);
+
+        pos = KEY_WORDS;
+        since_reseed += sizeof(buf);
+        st.refills++;
+    }
+
+    inline void check_fork() {
+        if (fork_gen != g_fork_gen.load(std::memory_order_relaxed)) {
+            wipe();
+            seeded = false;
+        }
+    }
+
+    inline uint64_t next_u64() {
+        check_fork();
+        if (pos == BUF_WORDS) refill();
+
+        uint64_t x = buf[pos];
+        buf[pos++] = 0;
+        st.u64_draws++;
+        return x;
+    }
+
+    void bytes(uint8_t * out, size_t n) {
+        check_fork();
+        st.byte_draws++;
+
+        while (n) {
+            if (pos == BUF_WORDS) refill();
+
+            size_t take = std::min(n, (BUF_WORDS - pos) * 8);
+            std::memcpy(out, buf + pos, take);
+
+            size_t used = (take + 7) / 8;
+            std::memset(buf + pos, 0, used * 8);
+            pos += used;
+
+            out += take;
+            n -= take;
+        }
+    }
+};
+
+inline Drbg & thread_drbg() {
+    thread_local Drbg d;
+    return d;
+}
+
+inline void csprng_bytes(uint8_t * out, size_t n) {
+    thread_drbg().bytes(out, n);
+}
+
 inline uint64_t csprng_u64() {
-    uint8_t b[8];
-    csprng_bytes(b, 8);
-    return load_le64(b);
+    return thread_drbg().next_u64();
+}
+
+// counters of the calling thread's drbg, os calls are process wide
+inline CsprngStats csprng_stats() {
+    return thread_drbg().st;
+}
+
+inline void csprng_stats_reset() {
+    thread_drbg().st = CsprngStats{};
 }
 
 }
\ No newline at end of file
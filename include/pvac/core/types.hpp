@@ -15,12 +15,16 @@ namespace Dom {
     inline constexpr const char* H_GEN = "pvac.dom.h_gen";
     inline constexpr const char* X_SEED = "pvac.dom.x_seed";
     inline constexpr const char* NOISE = "pvac.dom.noise";
+    inline constexpr const char* CHOOSE_K2 = "pvac.dom.choose_k.v2";
     
     inline constexpr const char* PRF_LPN = "pvac.dom.prf_lpn";
+    inline constexpr const char* LPN_V2 = "pvac.dom.lpn.v2";
     inline constexpr const char* TOEP = "pvac.dom.toeplitz";
 
     inline constexpr const char* ZTAG = "pvac.dom.ztag";
     inline constexpr const char* COMMIT = "pvac.dom.commit";
+    inline constexpr const char* RCACHE = "pvac.dom.rcache";
+    inline constexpr const char* STREAM_MAC = "pvac.dom.stream_mac";
 
     inline constexpr const char* PRF_R1 = "pvac.prf.r.1";
     inline constexpr const char* PRF_R2 = "pvac.prf.r.2";
@@ -45,6 +49,10 @@ struct Params {
     int x_col_wt = 128;
     int err_wt = 128;
 
+    // index sampler behind gen_H / sigma_from_H:
+    // 1 = sha256 counter stream, 2 = aes-ctr stream with bitmap dedup
+    int sampler_ver = 2;
+
     double noise_entropy_bits = 120.0;
     double tuple2_fraction = 0.55;
     double depth_slope_bits = 16.0;
@@ -60,6 +68,11 @@ struct Params {
     int lpn_tau_num = 1;
     int lpn_tau_den = 8;
 
+    // lpn sample stream behind prf_R:
+    // 1 = rejection sampled error word per row (existing keys and data),
+    // 2 = errors bitsliced from bulk keystream, needs a power of two den
+    int lpn_ver = 1;
+
     // didn't bother with hypothetical approaches and went 
     // with the absolute maximum in the settings and left it that way, 
     // which is good for security/speed, etc
@@ -98,6 +111,11 @@ struct Layer {
     RSeed seed;
     uint32_t pa;
     uint32_t pb;
+
+    // pending factor on every edge weight of this layer, an edge stands
+    // for w * k. ct_scale only touches k; ct_normalize folds it into the
+    // weights (do that before writing raw weights out)
+    Fp k{1, 0};
 };
 
 enum EdgeSign : uint8_t {
@@ -122,10 +140,15 @@ struct PubKey {
     Params prm;
     uint64_t canon_tag;
     std::vector<BitVec> H;
+
+    // csr copy of H, rows of column c are H_rows[H_colptr[c] .. H_colptr[c + 1])
+    std::vector<uint32_t> H_colptr;
+    std::vector<uint16_t> H_rows;
     Ubk ubk;
     std::array<uint8_t, 32> H_digest;
     Fp omega_B;
     std::vector<Fp> powg_B;
+    std::vector<Fp> powg_B_inv;
 };
 
 struct SecKey {
@@ -93,6 +93,7 @@ inline void keygen(const Params & prm, PubKey & pk, SecKey & sk) {
     for (int i = 1; i < pk.prm.B; i++) {
         pk.powg_B[i] = fp_mul(pk.powg_B[i - 1], g);
     }
+    pk_build_powg_inv(pk);
 
     auto primes = factor_small(pk.prm.B);
 
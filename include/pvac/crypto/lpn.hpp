@@ -4,19 +4,19 @@
 #include <cstring>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
 
 #include "../core/types.hpp"
 #include "../core/hash.hpp"
 #include "toeplitz.hpp"
 #include "../core/ct_safe.hpp"
-
-#if defined(__AES__) && defined(__SSE2__)
-#include <wmmintrin.h>
-#include <emmintrin.h>
-#define PVAC_USE_AESNI 1
-#else
-#define PVAC_USE_AESNI 0
-#endif
+#include "../core/aes_ctr.hpp"
+#include "../core/parallel.hpp"
 
 namespace pvac {
 
@@ -36,123 +36,6 @@ inline Fp hash_to_fp_nonzero(uint64_t lo, uint64_t hi) {
     return out;
 }
 
-#if PVAC_USE_AESNI
-
-struct AesCtr256 {
-    __m128i rk[15];
-    __m128i ctr;
-    alignas(16) uint64_t buf[2] = {0, 0};
-    bool has_buf = false;
-
-    static inline __m128i key_expand(__m128i k, __m128i t) {
-        t = _mm_shuffle_epi32(t, 0xFF);
-        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
-        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
-        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
-        return _mm_xor_si128(k, t);
-    }
-
-    static inline __m128i key_expand2(__m128i k1, __m128i k2) {
-        __m128i t = _mm_aeskeygenassist_si128(k2, 0);
-        t = _mm_shuffle_epi32(t, 0xAA);
-        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
-        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
-        k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
-        return _mm_xor_si128(k1, t);
-    }
-
-    void init(const uint8_t key[32], uint64_t nonce) {
-        __m128i k0 = _mm_loadu_si128((const __m128i*)key);
-        __m128i k1 = _mm_loadu_si128((const __m128i*)(key + 16));
-
-        rk[0] = k0;
-        rk[1] = k1;
-        rk[2] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x01)); k0 = rk[2];
-        rk[3] = key_expand2(k1, k0); k1 = rk[3];
-        rk[4] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x02)); k0 = rk[4];
-        rk[5] = key_expand2(k1, k0); k1 = rk[5];
-        rk[6] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x04)); k0 = rk[6];
-        rk[7] = key_expand2(k1, k0); k1 = rk[7];
-        rk[8] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x08)); k0 = rk[8];
-        rk[9] = key_expand2(k1, k0); k1 = rk[9];
-        rk[10] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x10)); k0 = rk[10];
-        rk[11] = key_expand2(k1, k0); k1 = rk[11];
-        rk[12] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x20)); k0 = rk[12];
-        rk[13] = key_expand2(k1, k0); k1 = rk[13];
-        rk[14] = key_expand(k0, _mm_aeskeygenassist_si128(k1, 0x40));
-
-        ctr = _mm_set_epi64x(0, (long long)nonce);
-        has_buf = false;
-    }
-
-    inline __m128i encrypt_ctr() {
-        __m128i t = _mm_xor_si128(ctr, rk[0]);
-        t = _mm_aesenc_si128(t, rk[1]);
-        t = _mm_aesenc_si128(t, rk[2]);
-        t = _mm_aesenc_si128(t, rk[3]);
-        t = _mm_aesenc_si128(t, rk[4]);
-        t = _mm_aesenc_si128(t, rk[5]);
-        t = _mm_aesenc_si128(t, rk[6]);
-        t = _mm_aesenc_si128(t, rk[7]);
-        t = _mm_aesenc_si128(t, rk[8]);
-        t = _mm_aesenc_si128(t, rk[9]);
-        t = _mm_aesenc_si128(t, rk[10]);
-        t = _mm_aesenc_si128(t, rk[11]);
-        t = _mm_aesenc_si128(t, rk[12]);
-        t = _mm_aesenc_si128(t, rk[13]);
-        t = _mm_aesenclast_si128(t, rk[14]);
-        ctr = _mm_add_epi64(ctr, _mm_set_epi64x(0, 1));
-        return t;
-    }
-
-    inline uint64_t next_u64() {
-        if (has_buf) {
-            has_buf = false;
-            return buf[1];
-        }
-        __m128i ct = encrypt_ctr();
-        _mm_store_si128((__m128i*)buf, ct);
-        has_buf = true;
-        return buf[0];
-    }
-
-    inline void fill_u64(uint64_t* out, size_t n) {
-        size_t i = 0;
-        if (has_buf && n > 0) {
-            out[0] = buf[1];
-            has_buf = false;
-            i = 1;
-        }
-        alignas(16) uint64_t tmp[2];
-        for (; i + 1 < n; i += 2) {
-            __m128i ct = encrypt_ctr();
-            _mm_store_si128((__m128i*)tmp, ct);
-            out[i] = tmp[0];
-            out[i + 1] = tmp[1];
-        }
-        if (i < n) {
-            __m128i ct = encrypt_ctr();
-            _mm_store_si128((__m128i*)buf, ct);
-            out[i] = buf[0];
-            has_buf = true;
-        }
-    }
-
-    inline uint64_t bounded(uint64_t M) {
-        if (M <= 1) return 0;
-        uint64_t lim = UINT64_MAX - (UINT64_MAX % M);
-        for (;;) {
-            uint64_t x = next_u64();
-            if (x < lim) return x % M;
-        }
-    }
-};
-
-#else
-
-#error "hfhe requires aes-ni support (compile with -march=native or -maes on x86_64)"
-
-#endif
 
 inline uint64_t fnv1a_domain(const char* dom) {
     uint64_t h = 0xcbf29ce484222325ull;
@@ -163,15 +46,14 @@ inline uint64_t fnv1a_domain(const char* dom) {
     return h;
 }
 
-inline void derive_aes_key(
+// secret, key and seed part of every prf key derivation; the domains of
+// one seed only differ in what gets absorbed after this
+inline void prf_seed_state(
     const PubKey& pk,
     const SecKey& sk,
     const RSeed& seed,
-    const char* dom,
-    uint8_t out_key[32],
-    uint64_t& out_nonce
+    Sha256& h
 ) {
-    Sha256 h;
     h.init();
 
     for (auto x : sk.prf_k) sha256_acc_u64(h, x);
@@ -183,15 +65,223 @@ inline void derive_aes_key(
     sha256_acc_u64(h, seed.ztag);
     sha256_acc_u64(h, seed.nonce.lo);
     sha256_acc_u64(h, seed.nonce.hi);
+}
+
+inline void derive_aes_key_from(
+    const Sha256& pre,
+    const RSeed& seed,
+    const char* dom,
+    uint8_t out_key[32],
+    uint64_t& out_nonce,
+    uint64_t tweak = 0
+) {
+    Sha256 h = pre;
 
     uint64_t dom_hash = fnv1a_domain(dom);
     sha256_acc_u64(h, dom_hash);
 
+    // versioned streams get their own keys
+    if (tweak) sha256_acc_u64(h, tweak);
+
     h.finish(out_key);
     out_nonce = dom_hash ^ seed.nonce.lo;
 }
 
-inline void lpn_make_ybits(
+inline void derive_aes_key(
+    const PubKey& pk,
+    const SecKey& sk,
+    const RSeed& seed,
+    const char* dom,
+    uint8_t out_key[32],
+    uint64_t& out_nonce,
+    uint64_t tweak = 0
+) {
+    Sha256 h;
+    prf_seed_state(pk, sk, seed, h);
+    derive_aes_key_from(h, seed, dom, out_key, out_nonce, tweak);
+}
+
+// zeroes sk-derived scratch the compiler may not drop
+inline void lpn_wipe(void* p, size_t n) {
+    volatile uint8_t* q = (volatile uint8_t*)p;
+    for (size_t i = 0; i < n; i++) q[i] = 0;
+}
+
+// keystream words served from a bulk buffer, in the same order as
+// calling fill_u64 / next_u64 on the generator row by row. the buffer is
+// kept per thread for its capacity, wipe() clears the round keys and the
+// keystream once a call is done with them
+struct LpnStream {
+    AesCtr256 prg;
+    std::vector<uint64_t> buf;
+    size_t pos = 0;
+    size_t len = 0;
+
+    void init(const uint8_t key[32], uint64_t nonce, size_t cap) {
+        prg.init(key, nonce);
+        buf.resize(cap);
+        pos = len = 0;
+    }
+
+    // at least k (<= cap) words readable from the returned pointer
+    inline const uint64_t* need(size_t k) {
+        if (len - pos < k) {
+            size_t rem = len - pos;
+            std::memmove(buf.data(), buf.data() + pos, rem * sizeof(uint64_t));
+            prg.fill_u64(buf.data() + rem, buf.size() - rem);
+            pos = 0;
+            len = buf.size();
+        }
+        return buf.data() + pos;
+    }
+
+    inline void skip(size_t k) {
+        pos += k;
+    }
+
+    inline uint64_t next() {
+        need(1);
+        return buf[pos++];
+    }
+
+    void wipe() {
+        lpn_wipe(&prg, sizeof(prg));
+        lpn_wipe(buf.data(), buf.size() * sizeof(uint64_t));
+        pos = len = 0;
+    }
+};
+
+// parities of <s, row_j> for nr <= 8 rows, bit j of the result
+inline uint64_t lpn_dot_rows_scalar(const uint64_t* const* rows, int nr, const uint64_t* s, size_t words) {
+    uint64_t out = 0;
+    for (int j = 0; j < nr; j++) {
+        const uint64_t* p = rows[j];
+        uint64_t a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+        size_t i = 0;
+        for (; i + 4 <= words; i += 4) {
+            a0 ^= p[i] & s[i];
+            a1 ^= p[i + 1] & s[i + 1];
+            a2 ^= p[i + 2] & s[i + 2];
+            a3 ^= p[i + 3] & s[i + 3];
+        }
+        for (; i < words; i++) a0 ^= p[i] & s[i];
+        out |= (uint64_t)parity64(a0 ^ a1 ^ a2 ^ a3) << j;
+    }
+    return out;
+}
+
+#if defined(__AVX2__)
+
+inline int parity256(__m256i v) {
+    __m128i x = _mm_xor_si128(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return parity64((uint64_t)_mm_cvtsi128_si64(x) ^ (uint64_t)_mm_extract_epi64(x, 1));
+}
+
+// 4 rows per pass against one load of s
+inline uint64_t lpn_dot_rows_avx2(const uint64_t* const* rows, int nr, const uint64_t* s, size_t words) {
+    uint64_t out = 0;
+    int j = 0;
+    size_t wv = words & ~(size_t)3;
+
+    for (; j + 4 <= nr; j += 4) {
+        const uint64_t* p0 = rows[j];
+        const uint64_t* p1 = rows[j + 1];
+        const uint64_t* p2 = rows[j + 2];
+        const uint64_t* p3 = rows[j + 3];
+        __m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0;
+
+        for (size_t i = 0; i < wv; i += 4) {
+            __m256i sv = _mm256_loadu_si256((const __m256i*)(s + i));
+            a0 = _mm256_xor_si256(a0, _mm256_and_si256(sv, _mm256_loadu_si256((const __m256i*)(p0 + i))));
+            a1 = _mm256_xor_si256(a1, _mm256_and_si256(sv, _mm256_loadu_si256((const __m256i*)(p1 + i))));
+            a2 = _mm256_xor_si256(a2, _mm256_and_si256(sv, _mm256_loadu_si256((const __m256i*)(p2 + i))));
+            a3 = _mm256_xor_si256(a3, _mm256_and_si256(sv, _mm256_loadu_si256((const __m256i*)(p3 + i))));
+        }
+
+        uint64_t t0 = 0, t1 = 0, t2 = 0, t3 = 0;
+        for (size_t i = wv; i < words; i++) {
+            t0 ^= p0[i] & s[i];
+            t1 ^= p1[i] & s[i];
+            t2 ^= p2[i] & s[i];
+            t3 ^= p3[i] & s[i];
+        }
+
+        out |= (uint64_t)(parity256(a0) ^ parity64(t0)) << j;
+        out |= (uint64_t)(parity256(a1) ^ parity64(t1)) << (j + 1);
+        out |= (uint64_t)(parity256(a2) ^ parity64(t2)) << (j + 2);
+        out |= (uint64_t)(parity256(a3) ^ parity64(t3)) << (j + 3);
+    }
+
+    if (j < nr) out |= lpn_dot_rows_scalar(rows + j, nr - j, s, words) << j;
+    return out;
+}
+
+#endif
+
+#if defined(__AVX512F__)
+
+// once per row, a fold through memory is as cheap as any shuffle tree
+inline int parity512(__m512i v) {
+    alignas(64) uint64_t t[8];
+    _mm512_store_si512((void*)t, v);
+    return parity64(t[0] ^ t[1] ^ t[2] ^ t[3] ^ t[4] ^ t[5] ^ t[6] ^ t[7]);
+}
+
+// all 8 rows per pass, acc ^= row & s as one ternlog (0x78)
+inline uint64_t lpn_dot_rows_avx512(const uint64_t* const* rows, int nr, const uint64_t* s, size_t words) {
+    if (nr < 8) return lpn_dot_rows_scalar(rows, nr, s, words);
+
+    const uint64_t* p0 = rows[0];
+    const uint64_t* p1 = rows[1];
+    const uint64_t* p2 = rows[2];
+    const uint64_t* p3 = rows[3];
+    const uint64_t* p4 = rows[4];
+    const uint64_t* p5 = rows[5];
+    const uint64_t* p6 = rows[6];
+    const uint64_t* p7 = rows[7];
+
+    __m512i a0 = _mm512_setzero_si512(), a1 = a0, a2 = a0, a3 = a0;
+    __m512i a4 = a0, a5 = a0, a6 = a0, a7 = a0;
+
+    for (size_t i = 0; i < words; i += 8) {
+        __mmask8 m = words - i >= 8 ? (__mmask8)0xFF : (__mmask8)((1u << (words - i)) - 1);
+        __m512i sv = _mm512_maskz_loadu_epi64(m, s + i);
+        a0 = _mm512_ternarylogic_epi64(a0, _mm512_maskz_loadu_epi64(m, p0 + i), sv, 0x78);
+        a1 = _mm512_ternarylogic_epi64(a1, _mm512_maskz_loadu_epi64(m, p1 + i), sv, 0x78);
+        a2 = _mm512_ternarylogic_epi64(a2, _mm512_maskz_loadu_epi64(m, p2 + i), sv, 0x78);
+        a3 = _mm512_ternarylogic_epi64(a3, _mm512_maskz_loadu_epi64(m, p3 + i), sv, 0x78);
+        a4 = _mm512_ternarylogic_epi64(a4, _mm512_maskz_loadu_epi64(m, p4 + i), sv, 0x78);
+        a5 = _mm512_ternarylogic_epi64(a5, _mm512_maskz_loadu_epi64(m, p5 + i), sv, 0x78);
+        a6 = _mm512_ternarylogic_epi64(a6, _mm512_maskz_loadu_epi64(m, p6 + i), sv, 0x78);
+        a7 = _mm512_ternarylogic_epi64(a7, _mm512_maskz_loadu_epi64(m, p7 + i), sv, 0x78);
+    }
+
+    return (uint64_t)parity512(a0)
+         | (uint64_t)parity512(a1) << 1
+         | (uint64_t)parity512(a2) << 2
+         | (uint64_t)parity512(a3) << 3
+         | (uint64_t)parity512(a4) << 4
+         | (uint64_t)parity512(a5) << 5
+         | (uint64_t)parity512(a6) << 6
+         | (uint64_t)parity512(a7) << 7;
+}
+
+#endif
+
+inline uint64_t lpn_dot_rows(const uint64_t* const* rows, int nr, const uint64_t* s, size_t words) {
+    switch (bv_impl()) {
+#if defined(__AVX512F__)
+    case BvImpl::AVX512: return lpn_dot_rows_avx512(rows, nr, s, words);
+#endif
+#if defined(__AVX2__)
+    case BvImpl::AVX2: return lpn_dot_rows_avx2(rows, nr, s, words);
+#endif
+    default: return lpn_dot_rows_scalar(rows, nr, s, words);
+    }
+}
+
+// row at a time over the raw generator, kept as the reference for v1
+inline void lpn_make_ybits_ref(
     const PubKey& pk,
     const SecKey& sk,
     const RSeed& seed,
@@ -232,46 +322,465 @@ inline void lpn_make_ybits(
     }
 }
 
-inline Fp prf_R_core(
+namespace lpn_detail {
+    constexpr int TILE = 8;
+    constexpr size_t SLACK = 16;
+    constexpr size_t MIN_BUF = 8192;
+}
+
+// v1 stream: per row s_words of a, then one rejection sampled error word
+// (none at all when den <= 1). rows are located a tile at a time inside the
+// bulk buffer and dotted together; a tile that runs out of slack on
+// rejections drops back to the row at a time walk
+inline void lpn_ybits_v1(
+    const PubKey& pk,
+    const SecKey& sk,
+    const uint8_t aes_key[32],
+    uint64_t nonce,
+    std::vector<uint64_t>& ybits
+) {
+    using namespace lpn_detail;
+
+    int t = pk.prm.lpn_t;
+    size_t s_words = ((size_t)pk.prm.lpn_n + 63) / 64;
+    const uint64_t* s = sk.lpn_s_bits.data();
+
+    uint64_t num = (uint64_t)pk.prm.lpn_tau_num;
+    uint64_t den = (uint64_t)pk.prm.lpn_tau_den;
+    bool draw = den > 1;
+    uint64_t lim = draw ? UINT64_MAX - (UINT64_MAX % den) : 0;
+    uint64_t e_const = (!draw && num > 0) ? 1 : 0;
+
+    size_t stride = s_words + (draw ? 1 : 0);
+    size_t tile_words = (size_t)TILE * stride + SLACK;
+
+    thread_local LpnStream ks;
+    ks.init(aes_key, nonce, std::max(MIN_BUF, 4 * tile_words));
+
+    ybits.assign(((size_t)t + 63) / 64, 0ull);
+
+    for (int r0 = 0; r0 < t; r0 += TILE) {
+        int nr = std::min(TILE, t - r0);
+        size_t avail = (size_t)nr * stride + SLACK;
+        const uint64_t* base = ks.need(avail);
+
+        const uint64_t* rows[TILE];
+        uint64_t ebits = 0;
+        size_t off = 0;
+        bool fast = true;
+
+        for (int j = 0; j < nr && fast; j++) {
+            if (off + s_words > avail) { fast = false; break; }
+            rows[j] = base + off;
+            off += s_words;
+
+            uint64_t e = e_const;
+            if (draw) {
+                for (;;) {
+                    if (off >= avail) { fast = false; break; }
+                    uint64_t x = base[off++];
+                    if (x < lim) { e = (x % den) < num; break; }
+                }
+            }
+            ebits |= e << j;
+        }
+
+        uint64_t y;
+        if (fast) {
+            y = lpn_dot_rows(rows, nr, s, s_words) ^ ebits;
+            ks.skip(off);
+        } else {
+            y = 0;
+            for (int j = 0; j < nr; j++) {
+                const uint64_t* p = ks.need(s_words);
+                uint64_t bit = lpn_dot_rows_scalar(&p, 1, s, s_words);
+                ks.skip(s_words);
+
+                uint64_t e = e_const;
+                if (draw) {
+                    for (;;) {
+                        uint64_t x = ks.next();
+                        if (x < lim) { e = (x % den) < num; break; }
+                    }
+                }
+                y |= (bit ^ e) << j;
+            }
+        }
+
+        ybits[(size_t)r0 >> 6] ^= y << (r0 & 63);
+    }
+
+    ks.wipe();
+}
+
+// v2 stream, den = 2^k: per 64 row block the row words back to back, then
+// k words whose bit j slices give the k bit sample for row j; e_j is the
+// bitsliced test sample_j < num. 3 keystream bits per sample at tau = 1/8
+inline void lpn_ybits_v2(
     const PubKey& pk,
     const SecKey& sk,
+    const uint8_t aes_key[32],
+    uint64_t nonce,
+    std::vector<uint64_t>& ybits
+) {
+    using namespace lpn_detail;
+
+    int t = pk.prm.lpn_t;
+    size_t s_words = ((size_t)pk.prm.lpn_n + 63) / 64;
+    const uint64_t* s = sk.lpn_s_bits.data();
+
+    uint64_t num = (uint64_t)pk.prm.lpn_tau_num;
+    uint64_t den = (uint64_t)pk.prm.lpn_tau_den;
+
+    if (den == 0 || (den & (den - 1)) != 0) {
+        std::cerr << "[lpn] lpn_ver 2 needs a power of two tau denominator\n";
+        std::abort();
+    }
+
+    int k = 0;
+    while ((1ull << k) < den) k++;
+
+    size_t block_words = 64 * s_words + (size_t)k;
+
+    thread_local LpnStream ks;
+    ks.init(aes_key, nonce, std::max(MIN_BUF, 2 * block_words));
+
+    ybits.assign(((size_t)t + 63) / 64, 0ull);
+
+    for (int r0 = 0; r0 < t; r0 += 64) {
+        int nr = std::min(64, t - r0);
+        size_t used = (size_t)nr * s_words;
+        const uint64_t* base = ks.need(used + (size_t)k);
+
+        uint64_t dots = 0;
+        const uint64_t* rows[TILE];
+        for (int j0 = 0; j0 < nr; j0 += TILE) {
+            int m = std::min(TILE, nr - j0);
+            for (int j = 0; j < m; j++) rows[j] = base + (size_t)(j0 + j) * s_words;
+            dots |= lpn_dot_rows(rows, m, s, s_words) << j0;
+        }
+
+        const uint64_t* x = base + used;
+        uint64_t lt = 0;
+        if (num >= den) {
+            lt = ~0ull;
+        } else {
+            uint64_t eq = ~0ull;
+            for (int b = k - 1; b >= 0; b--) {
+                if ((num >> b) & 1) {
+                    lt |= eq & ~x[b];
+                    eq &= x[b];
+                } else {
+                    eq &= ~x[b];
+                }
+            }
+        }
+        ks.skip(used + (size_t)k);
+
+        uint64_t mask = nr == 64 ? ~0ull : ((1ull << nr) - 1);
+        ybits[(size_t)r0 >> 6] = (dots ^ lt) & mask;
+    }
+
+    ks.wipe();
+}
+
+inline void lpn_derive_key(
+    const PubKey& pk,
+    const Sha256& pre,
     const RSeed& seed,
-    const char* dom
+    const char* dom,
+    uint8_t aes_key[32],
+    uint64_t& nonce
 ) {
-    std::vector<uint64_t> ybits;
-    lpn_make_ybits(pk, sk, seed, dom, ybits);
+    uint64_t tweak = pk.prm.lpn_ver == 2 ? fnv1a_domain(Dom::LPN_V2) : 0;
+    derive_aes_key_from(pre, seed, dom, aes_key, nonce, tweak);
+}
+
+inline void lpn_ybits_keyed(
+    const PubKey& pk,
+    const SecKey& sk,
+    const uint8_t aes_key[32],
+    uint64_t nonce,
+    std::vector<uint64_t>& ybits
+) {
+    if (pk.prm.lpn_ver == 2) lpn_ybits_v2(pk, sk, aes_key, nonce, ybits);
+    else lpn_ybits_v1(pk, sk, aes_key, nonce, ybits);
+}
+
+inline void lpn_make_ybits_v1(
+    const PubKey& pk,
+    const SecKey& sk,
+    const RSeed& seed,
+    const char* dom,
+    std::vector<uint64_t>& ybits
+) {
+    uint8_t aes_key[32];
+    uint64_t nonce;
+    derive_aes_key(pk, sk, seed, dom, aes_key, nonce);
+    lpn_ybits_v1(pk, sk, aes_key, nonce, ybits);
+}
+
+inline void lpn_make_ybits_v2(
+    const PubKey& pk,
+    const SecKey& sk,
+    const RSeed& seed,
+    const char* dom,
+    std::vector<uint64_t>& ybits
+) {
+    uint8_t aes_key[32];
+    uint64_t nonce;
+    derive_aes_key(pk, sk, seed, dom, aes_key, nonce, fnv1a_domain(Dom::LPN_V2));
+    lpn_ybits_v2(pk, sk, aes_key, nonce, ybits);
+}
+
+inline void lpn_make_ybits(
+    const PubKey& pk,
+    const SecKey& sk,
+    const RSeed& seed,
+    const char* dom,
+    std::vector<uint64_t>& ybits
+) {
+    Sha256 pre;
+    prf_seed_state(pk, sk, seed, pre);
+
+    uint8_t aes_key[32];
+    uint64_t nonce;
+    lpn_derive_key(pk, pre, seed, dom, aes_key, nonce);
+    lpn_ybits_keyed(pk, sk, aes_key, nonce, ybits);
+}
+
+// R_dom for several domains of one seed in one go: the sha state up to the
+// seed is built once, the toeplitz key (shared by all domains, only the
+// nonce differs) is derived once, and with a pool the domains run on
+// separate workers
+inline void prf_R_multi(
+    const PubKey& pk,
+    const SecKey& sk,
+    const RSeed& seed,
+    const char* const* doms,
+    size_t nd,
+    Fp* out,
+    ThreadPool* pool = nullptr
+) {
+    Sha256 pre;
+    prf_seed_state(pk, sk, seed, pre);
 
     uint8_t toep_key[32];
     uint64_t toep_nonce;
-    derive_aes_key(pk, sk, seed, Dom::TOEP, toep_key, toep_nonce);
-    toep_nonce ^= fnv1a_domain(dom);
-
-    AesCtr256 prg;
-    prg.init(toep_key, toep_nonce);
+    derive_aes_key_from(pre, seed, Dom::TOEP, toep_key, toep_nonce);
 
     size_t top_words = ((size_t)pk.prm.lpn_t + 127u + 63u) / 64u;
-    std::vector<uint64_t> top(top_words);
-    prg.fill_u64(top.data(), top_words);
 
-    uint64_t lo = 0;
-    uint64_t hi = 0;
-    toep_127(top, ybits, lo, hi);
+    auto one = [&](size_t i) {
+        thread_local std::vector<uint64_t> ybits;
+        thread_local std::vector<uint64_t> top;
+
+        uint8_t aes_key[32];
+        uint64_t nonce;
+        lpn_derive_key(pk, pre, seed, doms[i], aes_key, nonce);
+        lpn_ybits_keyed(pk, sk, aes_key, nonce, ybits);
+
+        AesCtr256 prg;
+        prg.init(toep_key, toep_nonce ^ fnv1a_domain(doms[i]));
+
+        top.resize(top_words);
+        prg.fill_u64(top.data(), top_words);
+
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+        toep_127(top, ybits, lo, hi);
+
+        out[i] = hash_to_fp_nonzero(lo, hi);
+
+        lpn_wipe(ybits.data(), ybits.size() * sizeof(uint64_t));
+        lpn_wipe(top.data(), top.size() * sizeof(uint64_t));
+        lpn_wipe(aes_key, sizeof(aes_key));
+    };
+
+    if (pool && pool->size() > 1 && nd > 1) {
+        pool->parallel_for(nd, one);
+    } else {
+        for (size_t i = 0; i < nd; i++) one(i);
+    }
+}
+
+inline Fp prf_R_core(
+    const PubKey& pk,
+    const SecKey& sk,
+    const RSeed& seed,
+    const char* dom
+) {
+    Fp r;
+    prf_R_multi(pk, sk, seed, &dom, 1, &r);
+    return r;
+}
+
+// serial unless given a pool: a single prf_R is too small to be worth
+// sharing the process pool with other callers, the batch entry points
+// (layers_R, enc_values) hand theirs down
+inline Fp prf_R(const PubKey& pk, const SecKey& sk, const RSeed& seed, ThreadPool* pool = nullptr) {
+    static const char* const doms[3] = {Dom::PRF_R1, Dom::PRF_R2, Dom::PRF_R3};
+    Fp r[3];
+    prf_R_multi(pk, sk, seed, doms, 3, r, pool);
+    return fp_mul(fp_mul(r[0], r[1]), r[2]);
+}
 
-    return hash_to_fp_nonzero(lo, hi);
+inline Fp prf_R_noise(const PubKey& pk, const SecKey& sk, const RSeed& seed, ThreadPool* pool = nullptr) {
+    static const char* const doms[3] = {Dom::PRF_NOISE1, Dom::PRF_NOISE2, Dom::PRF_NOISE3};
+    Fp r[3];
+    prf_R_multi(pk, sk, seed, doms, 3, r, pool);
+    return fp_mul(fp_mul(r[0], r[1]), r[2]);
 }
 
-inline Fp prf_R(const PubKey& pk, const SecKey& sk, const RSeed& seed) {
-    Fp r1 = prf_R_core(pk, sk, seed, Dom::PRF_R1);
-    Fp r2 = prf_R_core(pk, sk, seed, Dom::PRF_R2);
-    Fp r3 = prf_R_core(pk, sk, seed, Dom::PRF_R3);
-    return fp_mul(fp_mul(r1, r2), r3);
+// R values by layer seed, shared across ciphertexts: recrypt zero pool
+// layers, ct_add / ct_mul parents and re-decrypted ciphers keep handing
+// dec_value the same seeds. bounded, CLOCK eviction, safe to share
+// between threads. R depends on the key pair, so entries are keyed by
+// seed and by rcache_key_id(pk, sk) as well (the library passes it
+// everywhere; kid = 0 is for callers that handle one key pair
+// themselves). clear() wipes the stored values
+struct RCache {
+    explicit RCache(size_t capacity = 4096) : cap(std::max<size_t>(1, capacity)) {
+        slots.resize(cap);
+        index.reserve(cap);
+    }
+
+    RCache(const RCache &) = delete;
+    RCache & operator=(const RCache &) = delete;
+
+    bool get(const RSeed & s, Fp & out, uint64_t kid = 0) {
+        std::lock_guard<std::mutex> lk(mu);
+        auto it = index.find(Key{s, kid});
+        if (it == index.end()) {
+            n_miss++;
+            return false;
+        }
+        Slot & e = slots[it->second];
+        e.ref = true;
+        out = e.R;
+        n_hit++;
+        return true;
+    }
+
+    void put(const RSeed & s, const Fp & R, uint64_t kid = 0) {
+        std::lock_guard<std::mutex> lk(mu);
+        Key k{s, kid};
+        auto it = index.find(k);
+        if (it != index.end()) {
+            slots[it->second].R = R;
+            slots[it->second].ref = true;
+            return;
+        }
+
+        // sweep from the hand, clearing reference bits, to the first
+        // slot that is free or was not touched since the last pass
+        for (;;) {
+            Slot & e = slots[hand];
+            if (!e.used || !e.ref) break;
+            e.ref = false;
+            hand = (hand + 1) % cap;
+        }
+
+        Slot & e = slots[hand];
+        if (e.used) {
+            index.erase(e.key);
+            n_evict++;
+        }
+        e = Slot{k, R, true, true};
+        index.emplace(k, hand);
+        hand = (hand + 1) % cap;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lk(mu);
+        for (auto & e : slots) e = Slot{};
+        index.clear();
+        hand = 0;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lk(mu);
+        return index.size();
+    }
+
+    size_t capacity() const { return cap; }
+    uint64_t hits() const { return n_hit.load(); }
+    uint64_t misses() const { return n_miss.load(); }
+    uint64_t evictions() const { return n_evict.load(); }
+
+private:
+    struct Key {
+        uint64_t ztag = 0, lo = 0, hi = 0, kid = 0;
+
+        Key() = default;
+        Key(const RSeed & s, uint64_t kid) : ztag(s.ztag), lo(s.nonce.lo), hi(s.nonce.hi), kid(kid) {}
+
+        bool operator==(const Key & o) const {
+            return ztag == o.ztag && lo == o.lo && hi == o.hi && kid == o.kid;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key & k) const {
+            uint64_t h = k.ztag ^ (k.lo * 0x9e3779b97f4a7c15ull) ^ (k.hi * 0xc2b2ae3d27d4eb4full) ^ k.kid;
+            return (size_t)(h ^ (h >> 29));
+        }
+    };
+
+    struct Slot {
+        Key key;
+        Fp R{0, 0};
+        bool used = false;
+        bool ref = false;
+    };
+
+    size_t cap;
+    std::vector<Slot> slots;
+    std::unordered_map<Key, size_t, KeyHash> index;
+    size_t hand = 0;
+    mutable std::mutex mu;
+    std::atomic<uint64_t> n_hit{0}, n_miss{0}, n_evict{0};
+};
+
+// which key pair an RCache entry belongs to: everything prf_R reads
+// besides the seed, hashed
+inline uint64_t rcache_key_id(const PubKey& pk, const SecKey& sk) {
+    Sha256 s;
+    s.init();
+    s.update(Dom::RCACHE, std::strlen(Dom::RCACHE));
+
+    uint8_t b[8];
+    for (uint64_t k : sk.prf_k) {
+        store_le64(b, k);
+        s.update(b, 8);
+    }
+    store_le64(b, pk.canon_tag);
+    s.update(b, 8);
+    s.update(pk.H_digest.data(), pk.H_digest.size());
+
+    // the lpn stream: a params edit that keeps the keys changes R too
+    const int lpn[5] = {pk.prm.lpn_ver, pk.prm.lpn_t, pk.prm.lpn_n, pk.prm.lpn_tau_num, pk.prm.lpn_tau_den};
+    for (int v : lpn) {
+        store_le64(b, (uint64_t)(int64_t)v);
+        s.update(b, 8);
+    }
+
+    uint8_t d[32];
+    s.finish(d);
+    return load_le64(d);
 }
 
-inline Fp prf_R_noise(const PubKey& pk, const SecKey& sk, const RSeed& seed) {
-    Fp r1 = prf_R_core(pk, sk, seed, Dom::PRF_NOISE1);
-    Fp r2 = prf_R_core(pk, sk, seed, Dom::PRF_NOISE2);
-    Fp r3 = prf_R_core(pk, sk, seed, Dom::PRF_NOISE3);
-    return fp_mul(fp_mul(r1, r2), r3);
+// prf_R through a cache when one is given; misses are evaluated outside
+// the lock, so two threads may both compute a new seed once
+inline Fp prf_R_cached(const PubKey& pk, const SecKey& sk, const RSeed& seed, RCache* rc) {
+    if (!rc) return prf_R(pk, sk, seed);
+
+    uint64_t kid = rcache_key_id(pk, sk);
+    Fp R;
+    if (rc->get(seed, R, kid)) return R;
+    R = prf_R(pk, sk, seed);
+    rc->put(seed, R, kid);
+    return R;
 }
 
 }
\ No newline at end of file
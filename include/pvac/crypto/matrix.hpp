@@ -5,14 +5,21 @@
 #include <vector>
 #include <unordered_set>
 #include <numeric>
+#include <algorithm>
+#include <iostream>
+
+#include <unistd.h>
 
 #include "../core/types.hpp"
+#include "../core/cipher_soa.hpp"
 #include "../core/hash.hpp"
+#include "../core/aes_ctr.hpp"
+#include "../core/parallel.hpp"
 
 namespace pvac {
 
-// select k unique indices from [0, N)
-inline std::vector<int> prg_choose_k(
+// select k unique indices from [0, N), v1 (sha256 per 4 words)
+inline std::vector<int> prg_choose_k_sha(
     int k,
     int N,
     const char * label,
@@ -91,6 +98,86 @@ inline std::vector<int> prg_choose_k(
     return out;
 }
 
+// select k unique indices from [0, N), v2: one sha256 to key aes-ctr,
+// rejection sampling on 2^ceil(log2 N) and a bitmap for dedup
+inline std::vector<int> prg_choose_k_aes(
+    int k,
+    int N,
+    const char * label,
+    const std::vector<uint64_t> & words
+) {
+    std::vector<int> out;
+    if (k <= 0 || N <= 0) return out;
+    if (k > N) std::abort();
+
+    uint8_t key[32];
+    Sha256 s;
+    s.init();
+    s.update(Dom::CHOOSE_K2, std::strlen(Dom::CHOOSE_K2));
+    s.update(label, std::strlen(label));
+    sha256_acc_u64(s, (uint64_t)k);
+    sha256_acc_u64(s, (uint64_t)N);
+    for (uint64_t x : words) sha256_acc_u64(s, x);
+    s.finish(key);
+
+    AesCtr256 prg;
+    prg.init(key, 0);
+
+    int bits = 1;
+    while (bits < 63 && ((uint64_t)1 << bits) < (uint64_t)N) bits++;
+
+    int lane = bits <= 16 ? 16 : (bits <= 32 ? 32 : 64);
+    int per_word = 64 / lane;
+    uint64_t mask = (bits == 64) ? ~0ull : (((uint64_t)1 << bits) - 1);
+
+    thread_local std::vector<uint64_t> seen;
+    size_t seen_words = ((size_t)N + 63) / 64;
+    if (seen.size() < seen_words) seen.assign(seen_words, 0);
+
+    out.reserve(k);
+
+    constexpr size_t BLK = 16;
+    uint64_t rnd[BLK];
+
+    while ((int)out.size() < k) {
+        prg.fill_u64(rnd, BLK);
+
+        for (size_t i = 0; i < BLK && (int)out.size() < k; i++) {
+            uint64_t x = rnd[i];
+
+            for (int l = 0; l < per_word && (int)out.size() < k; l++) {
+                uint64_t v = x & mask;
+                x = (lane == 64) ? 0 : (x >> lane);
+
+                if (v >= (uint64_t)N) continue;
+
+                uint64_t bit = 1ull << (v & 63);
+                uint64_t & w = seen[v >> 6];
+                if (w & bit) continue;
+
+                w |= bit;
+                out.push_back((int)v);
+            }
+        }
+    }
+
+    // only touch the words we dirtied
+    for (int v : out) seen[(size_t)v >> 6] = 0;
+
+    return out;
+}
+
+inline std::vector<int> prg_choose_k(
+    int k,
+    int N,
+    const char * label,
+    const std::vector<uint64_t> & words,
+    int ver = 1
+) {
+    if (ver >= 2) return prg_choose_k_aes(k, N, label, words);
+    return prg_choose_k_sha(k, N, label, words);
+}
+
 // public permutation from canon_tag
 inline Ubk gen_ubk_public(uint64_t canon_tag, int m_bits) {
     std::vector<int> perm(m_bits);
@@ -163,61 +250,38 @@ inline Ubk gen_ubk_public(uint64_t canon_tag, int m_bits) {
     return u;
 }
 
-// apply inverse permutation to bitvec
-inline BitVec apply_perm_sigma(const BitVec & v, const std::vector<int> & inv) {
-    BitVec o = BitVec::make(v.nbits);
-
-    for (size_t wi = 0; wi < v.w.size(); ++wi) {
-        uint64_t x = v.w[wi];
+// apply inverse permutation to the bits of `in`, out must start zeroed
+inline void apply_perm_words(const uint64_t * in, size_t words, size_t nbits,
+                             const std::vector<int> & inv, uint64_t * out) {
+    for (size_t wi = 0; wi < words; ++wi) {
+        uint64_t x = in[wi];
 
         while (x) {
             uint64_t b = x & -x;
             unsigned bit = __builtin_ctzll(x);
             size_t src = (wi << 6) + bit;
 
-            if (src < v.nbits) {
+            if (src < nbits) {
                 int j = inv[src];
-                o.w[(size_t)j >> 6] |= (1ull << (j & 63));
+                out[(size_t)j >> 6] |= (1ull << (j & 63));
             }
 
             x ^= b;
         }
     }
+}
 
+// apply inverse permutation to bitvec
+inline BitVec apply_perm_sigma(const BitVec & v, const std::vector<int> & inv) {
+    BitVec o = BitVec::make(v.nbits);
+    apply_perm_words(v.w.data(), v.w.size(), v.nbits, inv, o.w.data());
     return o;
 }
 
-// sparse parity check
-inline void gen_H(PubKey & pk) {
-    int m = pk.prm.m_bits;
-    int n = pk.prm.n_bits;
-    int wt = pk.prm.h_col_wt;
-
-    pk.H.resize(n, BitVec::make(m));
-
-    for (int c = 0; c < n; c++) {
-        BitVec col = BitVec::make(m);
-
-        std::vector<uint64_t> words {
-            (uint64_t)m,
-            (uint64_t)n,
-            (uint64_t)wt,
-            (uint64_t)c,
-            pk.canon_tag
-        };
-
-        auto rows = prg_choose_k(wt, m, Dom::H_GEN, words);
-
-        for (int r : rows) {
-            col.w[(size_t)r >> 6] |= (1ull << (r & 63));
-        }
-
-        pk.H[c] = std::move(col);
-    }
-
-    // digest for verif
+// digest of the dense H for verif
+inline void h_digest(const PubKey & pk, uint8_t out[32]) {
     Sha256 s;
-    
+
     s.init();
     s.update("H|v2", 4);
     sha256_acc_u64(s, pk.prm.m_bits);
@@ -247,7 +311,92 @@ inline void gen_H(PubKey & pk) {
         }
     }
 
-    s.finish(pk.H_digest.data());
+    s.finish(out);
+}
+
+// sparse parity check, column c only depends on (m, n, wt, c, canon_tag)
+// so columns are derived on the thread pool
+inline void gen_H(PubKey & pk) {
+    int m = pk.prm.m_bits;
+    int n = pk.prm.n_bits;
+    int wt = pk.prm.h_col_wt;
+
+    if (m > 65536) {
+        std::cerr << "[gen_H] m_bits > 65536 not supported by csr rows\n";
+        std::abort();
+    }
+
+    pk.H.assign(n, BitVec());
+    pk.H_colptr.assign((size_t)n + 1, 0);
+    pk.H_rows.assign((size_t)n * (size_t)wt, 0);
+
+    parallel_for((size_t)n, [&](size_t c) {
+        BitVec col = BitVec::make(m);
+
+        std::vector<uint64_t> words {
+            (uint64_t)m,
+            (uint64_t)n,
+            (uint64_t)wt,
+            (uint64_t)c,
+            pk.canon_tag
+        };
+
+        auto rows = prg_choose_k(wt, m, Dom::H_GEN, words, pk.prm.sampler_ver);
+        std::sort(rows.begin(), rows.end());
+
+        size_t base = c * (size_t)wt;
+        for (int t = 0; t < wt; t++) {
+            int r = rows[t];
+            col.w[(size_t)r >> 6] |= (1ull << (r & 63));
+            pk.H_rows[base + t] = (uint16_t)r;
+        }
+
+        pk.H_colptr[c + 1] = (uint32_t)(base + wt);
+        pk.H[c] = std::move(col);
+    }, 64);
+
+    h_digest(pk, pk.H_digest.data());
+}
+
+// csr rows from a dense H, for keys that were loaded without them
+inline void pk_build_sparse_H(PubKey & pk) {
+    size_t n = pk.H.size();
+
+    pk.H_colptr.assign(n + 1, 0);
+    pk.H_rows.clear();
+
+    for (size_t c = 0; c < n; c++) {
+        const BitVec & col = pk.H[c];
+
+        for (size_t wi = 0; wi < col.w.size(); ++wi) {
+            uint64_t x = col.w[wi];
+
+            while (x) {
+                size_t r = (wi << 6) + (size_t)__builtin_ctzll(x);
+                if (r < col.nbits) pk.H_rows.push_back((uint16_t)r);
+                x &= x - 1;
+            }
+        }
+
+        pk.H_colptr[c + 1] = (uint32_t)pk.H_rows.size();
+    }
+}
+
+// g^-i next to g^i, so encryption never inverts a generator power.
+// derived, not stored: keygen and snapshot loading both rebuild it
+inline void pk_build_powg_inv(PubKey & pk) {
+    pk.powg_B_inv = pk.powg_B;
+    fp_batch_inv(pk.powg_B_inv);
+}
+
+// (+/-) g^-idx, the inverse of the signed generator power
+inline Fp powg_inv(const PubKey & pk, int idx, bool neg = false) {
+    Fp r = idx < (int)pk.powg_B_inv.size() ? pk.powg_B_inv[idx] : fp_inv(pk.powg_B[idx]);
+    return neg ? fp_neg(r) : r;
+}
+
+inline bool pk_has_sparse_H(const PubKey & pk) {
+    return !pk.H.empty() && pk.H_colptr.size() == pk.H.size() + 1;
 }
 
 // canon_tag + nonce
@@ -263,20 +412,146 @@ inline uint64_t prg_layer_ztag(uint64_t canon_tag, Nonce128 n) {
     return load_le64(out);
 }
 
-// xor of x_col_wt columns from H + err_wt noise bits (will check next)
-inline BitVec sigma_from_H(
+// prg_layer_ztag for a whole batch of nonces through sha256_many
+inline void prg_layer_ztags(uint64_t canon_tag, const Nonce128 * n, uint64_t * out, size_t count) {
+    size_t dl = std::strlen(Dom::ZTAG);
+    size_t len = dl + 24;
+
+    thread_local std::vector<uint8_t> msg;
+    thread_local std::vector<const uint8_t *> ptr;
+    thread_local std::vector<uint8_t> dig;
+    msg.resize(count * len);
+    ptr.resize(count);
+    dig.resize(count * 32);
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t * q = msg.data() + i * len;
+        std::memcpy(q, Dom::ZTAG, dl);
+        store_le64(q + dl, canon_tag);
+        store_le64(q + dl + 8, n[i].lo);
+        store_le64(q + dl + 16, n[i].hi);
+        ptr[i] = q;
+    }
+
+    sha256_many(ptr.data(), len, (uint8_t (*)[32])dig.data(), count);
+
+    for (size_t i = 0; i < count; i++) out[i] = load_le64(dig.data() + i * 32);
+}
+
+enum class SigmaKernel : uint8_t {
+    AUTO = 0,
+    XOR = 1,
+    SCATTER = 2
+};
+
+// bit flips from the csr rows, 4 columns interleaved so neighbouring
+// flips land on different words instead of chaining through one;
+// reads k * h_col_wt row ids (about 48 KiB) instead of k full columns
+inline void sigma_scatter_cols(const PubKey & pk, const std::vector<int> & cols, uint64_t * out) {
+    const uint32_t * ptr = pk.H_colptr.data();
+    const uint16_t * rows = pk.H_rows.data();
+
+    auto flip = [out](uint32_t r) {
+        out[r >> 6] ^= 1ull << (r & 63);
+    };
+
+    size_t k = cols.size();
+    size_t j = 0;
+
+    for (; j + 4 <= k; j += 4) {
+        uint32_t b[4], e[4];
+        for (int q = 0; q < 4; q++) {
+            b[q] = ptr[cols[j + q]];
+            e[q] = ptr[cols[j + q] + 1];
+        }
+
+        uint32_t len = std::min(std::min(e[0] - b[0], e[1] - b[1]),
+                                std::min(e[2] - b[2], e[3] - b[3]));
+
+        for (uint32_t t = 0; t < len; t++) {
+            uint32_t r0 = rows[b[0] + t];
+            uint32_t r1 = rows[b[1] + t];
+            uint32_t r2 = rows[b[2] + t];
+            uint32_t r3 = rows[b[3] + t];
+            flip(r0);
+            flip(r1);
+            flip(r2);
+            flip(r3);
+        }
+
+        for (int q = 0; q < 4; q++) {
+            for (uint32_t t = b[q] + len; t < e[q]; t++) flip(rows[t]);
+        }
+    }
+
+    for (; j < k; j++) {
+        for (uint32_t t = ptr[cols[j]], e = ptr[cols[j] + 1]; t < e; t++) flip(rows[t]);
+    }
+}
+
+inline void sigma_xor_cols(const PubKey & pk, const std::vector<int> & cols, uint64_t * out) {
+    thread_local std::vector<const uint64_t *> src;
+    src.resize(cols.size());
+
+    for (size_t j = 0; j < cols.size(); j++) {
+        src[j] = pk.H[cols[j]].w.data();
+    }
+
+    size_t words = ((size_t)pk.prm.m_bits + 63) / 64;
+    bv_xor_many(out, src.data(), src.size(), words);
+}
+
+inline size_t llc_bytes() {
+    static const size_t v = []() -> size_t {
+        long x = -1;
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+        x = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (x <= 0) x = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+        return x > 0 ? (size_t)x : ((size_t)8 << 20);
+    }();
+    return v;
+}
+
+// the dense xor streams whole columns and is the faster kernel while
+// H sits in the last level cache, once H has to come from dram the
+// csr scatter (6 MiB of row ids at default params) is cheaper
+inline SigmaKernel sigma_kernel_for(const PubKey & pk) {
+    if (!pk_has_sparse_H(pk)) return SigmaKernel::XOR;
+
+    size_t dense = pk.H.size() * pk.H[0].w.size() * sizeof(uint64_t);
+    return dense <= llc_bytes() / 2 ? SigmaKernel::XOR : SigmaKernel::SCATTER;
+}
+
+inline void sigma_accumulate_cols(
+    const PubKey & pk,
+    const std::vector<int> & cols,
+    uint64_t * out,
+    SigmaKernel kern = SigmaKernel::AUTO
+) {
+    if (kern == SigmaKernel::AUTO) kern = sigma_kernel_for(pk);
+
+    if (kern == SigmaKernel::SCATTER && pk_has_sparse_H(pk)) {
+        sigma_scatter_cols(pk, cols, out);
+    } else {
+        sigma_xor_cols(pk, cols, out);
+    }
+}
+
+// xor of x_col_wt columns from H + err_wt noise bits (will check next),
+// written into a zeroed m_bits wide `out`
+inline void sigma_from_H_into(
     const PubKey & pk,
     uint64_t ztag,
     Nonce128 nonce,
     uint16_t idx,
     uint8_t ch,
-    uint64_t salt // (?)
+    uint64_t salt,
+    uint64_t * out
 ) {
     int m = pk.prm.m_bits;
     int n = pk.prm.n_bits;
 
-    BitVec s = BitVec::make(m);
-
     std::vector<uint64_t> words {
         pk.canon_tag,
         ztag,
@@ -287,18 +562,27 @@ inline BitVec sigma_from_H(
         salt //same?
     };
 
-    auto cols = prg_choose_k(pk.prm.x_col_wt, n, Dom::X_SEED, words);
+    auto cols = prg_choose_k(pk.prm.x_col_wt, n, Dom::X_SEED, words, pk.prm.sampler_ver);
 
-    for (int c : cols) {
-        s.xor_with(pk.H[c]);
-    }
+    sigma_accumulate_cols(pk, cols, out);
 
-    auto noise = prg_choose_k(pk.prm.err_wt, m, Dom::NOISE, words);
+    auto noise = prg_choose_k(pk.prm.err_wt, m, Dom::NOISE, words, pk.prm.sampler_ver);
 
     for (int r : noise) {
-        s.w[(size_t)r >> 6] ^= (1ull << (r & 63));
+        out[(size_t)r >> 6] ^= (1ull << (r & 63));
     }
+}
 
+inline BitVec sigma_from_H(
+    const PubKey & pk,
+    uint64_t ztag,
+    Nonce128 nonce,
+    uint16_t idx,
+    uint8_t ch,
+    uint64_t salt // (?)
+) {
+    BitVec s = BitVec::make(pk.prm.m_bits);
+    sigma_from_H_into(pk, ztag, nonce, idx, ch, salt, s.w.data());
     return s;
 }
 
@@ -309,4 +593,13 @@ inline void ubk_apply(const PubKey & pk, Cipher & C) {
     }
 }
 
+inline void ubk_apply(const PubKey & pk, CipherSoA & C) {
+    std::vector<uint64_t> tmp(C.words());
+    for (size_t i = 0; i < C.size(); i++) {
+        std::fill(tmp.begin(), tmp.end(), 0);
+        apply_perm_words(C.sigma(i), C.words(), C.nbits, pk.ubk.inv, tmp.data());
+        std::memcpy(C.sigma(i), tmp.data(), tmp.size() * sizeof(uint64_t));
+    }
+}
+
 }
\ No newline at end of file
@@ -2,11 +2,11 @@
 
 #include <cstdint>
 #include <vector>
-#include <chrono>
-#include <iostream>
+#include <string>
 
 #include "../core/config.hpp"
-#include "../core/random.hpp"
+#include "../core/cpu.hpp"
+#include "../core/field.hpp"
 
 #if defined(__PCLMUL__)
 #include <wmmintrin.h>
@@ -189,81 +189,171 @@ inline void toep_127_pmull(
 
 #endif
 
-using toep_fn = void (*)(
-    const std::vector<uint64_t>&,
-    const std::vector<uint64_t>&,
-    uint64_t&,
-    uint64_t&
-);
+// bits 0..126 of ybits * top only ever see ybits[0..1] and top[0..1]:
+//   R0 = lo(y0 t0)
+//   R1 = hi(y0 t0) ^ lo(y0 t1) ^ lo(y1 t0)
+// so the truncated kernels below do 3 carryless products instead of the
+// full (Wa + Wb) word convolution, with bit-identical output
 
-inline toep_fn g_toep = nullptr;
-inline int g_toep_id = 0;
+inline void toep_words(
+    const std::vector<uint64_t>& top,
+    const std::vector<uint64_t>& ybits,
+    uint64_t& y0, uint64_t& y1,
+    uint64_t& t0, uint64_t& t1
+) {
+    y0 = ybits.size() > 0 ? ybits[0] : 0;
+    y1 = ybits.size() > 1 ? ybits[1] : 0;
+    t0 = top.size() > 0 ? top[0] : 0;
+    t1 = top.size() > 1 ? top[1] : 0;
+}
 
-inline void select_toeplitz() {
-    std::vector<toep_fn> cands;
-    std::vector<int> ids;
+inline void clmul64_scalar(uint64_t a, uint64_t b, uint64_t& lo, uint64_t& hi) {
+    lo = 0;
+    hi = 0;
+    while (a) {
+        int k = __builtin_ctzll(a);
+        lo ^= b << k;
+        if (k) hi ^= b >> (64 - k);
+        a &= a - 1;
+    }
+}
+
+inline void toep_127_trunc_scalar(
+    const std::vector<uint64_t>& top,
+    const std::vector<uint64_t>& ybits,
+    uint64_t& out_lo,
+    uint64_t& out_hi
+) {
+    uint64_t y0, y1, t0, t1;
+    toep_words(top, ybits, y0, y1, t0, t1);
+
+    uint64_t l00, h00, l01, h01, l10, h10;
+    clmul64_scalar(y0, t0, l00, h00);
+    clmul64_scalar(y0, t1, l01, h01);
+    clmul64_scalar(y1, t0, l10, h10);
+
+    out_lo = l00;
+    out_hi = (h00 ^ l01 ^ l10) & MASK63;
+}
 
 #if defined(__PCLMUL__)
-    cands.push_back(&toep_127_clmul);
-    ids.push_back(1);
+
+inline void toep_127_trunc_clmul(
+    const std::vector<uint64_t>& top,
+    const std::vector<uint64_t>& ybits,
+    uint64_t& out_lo,
+    uint64_t& out_hi
+) {
+    uint64_t y0, y1, t0, t1;
+    toep_words(top, ybits, y0, y1, t0, t1);
+
+    __m128i y = _mm_set_epi64x((long long)y1, (long long)y0);
+    __m128i t = _mm_set_epi64x((long long)t1, (long long)t0);
+
+    __m128i p00 = _mm_clmulepi64_si128(y, t, 0x00);
+    __m128i p01 = _mm_clmulepi64_si128(y, t, 0x10);
+    __m128i p10 = _mm_clmulepi64_si128(y, t, 0x01);
+
+    // lo(p01) ^ lo(p10) lands in the high half of p00
+    __m128i r = _mm_xor_si128(p00, _mm_slli_si128(_mm_xor_si128(p01, p10), 8));
+
+    out_lo = (uint64_t)_mm_cvtsi128_si64(r);
+    out_hi = (uint64_t)_mm_cvtsi128_si64(_mm_srli_si128(r, 8)) & MASK63;
+}
+
 #endif
 
 #if defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
-    cands.push_back(&toep_127_pmull);
-    ids.push_back(2);
-#endif
 
-    cands.push_back(&toep_127_scalar);
-    ids.push_back(3);
+inline void toep_127_trunc_pmull(
+    const std::vector<uint64_t>& top,
+    const std::vector<uint64_t>& ybits,
+    uint64_t& out_lo,
+    uint64_t& out_hi
+) {
+    uint64_t y0, y1, t0, t1;
+    toep_words(top, ybits, y0, y1, t0, t1);
 
-    auto bench = [&](toep_fn fn) -> double {
-        using namespace std::chrono;
+    uint64x2_t p00 = vreinterpretq_u64_p128(vmull_p64((poly64_t)y0, (poly64_t)t0));
+    uint64x2_t p01 = vreinterpretq_u64_p128(vmull_p64((poly64_t)y0, (poly64_t)t1));
+    uint64x2_t p10 = vreinterpretq_u64_p128(vmull_p64((poly64_t)y1, (poly64_t)t0));
 
-        std::vector<uint64_t> top(4096 / 64 + 4);
-        std::vector<uint64_t> y(4096 / 64 + 1);
+    out_lo = vgetq_lane_u64(p00, 0);
+    out_hi = (vgetq_lane_u64(p00, 1) ^ vgetq_lane_u64(p01, 0) ^ vgetq_lane_u64(p10, 0)) & MASK63;
+}
 
-        for (auto& q : top) q = csprng_u64();
-        for (auto& q : y) q = csprng_u64();
+#endif
 
-        uint64_t lo = 0, hi = 0;
-        auto t0 = high_resolution_clock::now();
-        for (int r = 0; r < 64; r++) fn(top, y, lo, hi);
-        auto t1 = high_resolution_clock::now();
+using toep_fn = void (*)(
+    const std::vector<uint64_t>&,
+    const std::vector<uint64_t>&,
+    uint64_t&,
+    uint64_t&
+);
 
-        return duration<double, std::micro>(t1 - t0).count();
-    };
+enum class ToepImpl { SCALAR, PCLMUL, PMULL };
 
-    double best = 1e300;
-    toep_fn bestfn = nullptr;
-    int bestid = 0;
+namespace toep_detail {
+    inline const char * const NAMES[3] = {"scalar", "pclmul", "pmull"};
 
-    for (size_t i = 0; i < cands.size(); ++i) {
-        double t = bench(cands[i]);
-        if (t < best) {
-            best = t;
-            bestfn = cands[i];
-            bestid = ids[i];
-        }
+    inline void avail(bool ok[3]) {
+        ok[0] = true;
+#if defined(__PCLMUL__)
+        ok[1] = cpu_features().pclmul;
+#else
+        ok[1] = false;
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+        ok[2] = true;
+#else
+        ok[2] = false;
+#endif
     }
 
-    g_toep = bestfn;
-    g_toep_id = bestid;
+    inline ToepImpl pick() {
+        bool ok[3];
+        avail(ok);
+        return (ToepImpl)impl_pick("toeplitz", NAMES, ok, 3, ok[1] ? 1 : ok[2] ? 2 : 0);
+    }
 
-    if (g_dbg) {
-        if (g_toep_id == 1) std::cout << "impl = pclmul t_us = " << best << "\n";
-        else if (g_toep_id == 2) std::cout << "impl = pmull t_us = " << best << "\n";
-        else std::cout << "impl = scalar t_us = " << best << "\n";
+    inline toep_fn fn_for(ToepImpl impl) {
+        switch (impl) {
+#if defined(__PCLMUL__)
+        case ToepImpl::PCLMUL: return &toep_127_trunc_clmul;
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+        case ToepImpl::PMULL: return &toep_127_trunc_pmull;
+#endif
+        default: return &toep_127_trunc_scalar;
+        }
     }
 }
 
+inline ToepImpl toep_impl() {
+    static const ToepImpl impl = toep_detail::pick();
+    return impl;
+}
+
+inline const char * toep_impl_name() {
+    return toep_detail::NAMES[(int)toep_impl()];
+}
+
+inline std::string toep_impl_avail() {
+    bool ok[3];
+    toep_detail::avail(ok);
+    return impl_avail_list(toep_detail::NAMES, ok, 3);
+}
+
+inline const bool g_toep_impl_reg = impl_register("toeplitz", &toep_impl_name, &toep_impl_avail);
+
 inline void toep_127(
     const std::vector<uint64_t>& top,
     const std::vector<uint64_t>& ybits,
     uint64_t& out_lo,
     uint64_t& out_hi
 ) {
-    if (!g_toep) select_toeplitz();
-    g_toep(top, ybits, out_lo, out_hi);
+    static const toep_fn fn = toep_detail::fn_for(toep_impl());
+    fn(top, ybits, out_lo, out_hi);
 }
 
 }
\ No newline at end of file
@@ -2,102 +2,559 @@
 
 #include <cstdint>
 #include <vector>
-#include <unordered_map>
+#include <algorithm>
 
 #include "../core/types.hpp"
+#include "../core/cipher_soa.hpp"
+#include "../core/parallel.hpp"
+#include "../core/fp_batch.hpp"
 #include "encrypt.hpp"
 
 namespace pvac {
 
-inline Cipher ct_add(const PubKey& pk, const Cipher& A, const Cipher& B) {
-    Cipher C;
-    C.L.reserve(A.L.size() + B.L.size());
-    C.E.reserve(A.E.size() + B.E.size());
-    
-    for (const auto& L : A.L) C.L.push_back(L);
-    uint32_t off = (uint32_t)A.L.size();
-    
-    for (auto L : B.L) {
+// B's layers go after A's, its PROD parents shifted along
+inline uint32_t ct_append_layers(std::vector<Layer>& C, const std::vector<Layer>& B) {
+    uint32_t off = (uint32_t)C.size();
+    for (auto L : B) {
         if (L.rule == RRule::PROD) { L.pa += off; L.pb += off; }
-        C.L.push_back(L);
+        C.push_back(L);
     }
-    
-    for (const auto& e : A.E) C.E.push_back(e);
-    for (auto e : B.E) { e.layer_id += off; C.E.push_back(std::move(e)); }
-    
-    guard_budget(pk, C, "add");
-    compact_layers(C);
+    return off;
+}
+
+// copy of A with room for `more` further layers and edges
+inline Cipher ct_clone(const Cipher& A, const Cipher& more) {
+    Cipher C;
+    C.L.reserve(A.L.size() + more.L.size());
+    C.E.reserve(A.E.size() + more.E.size());
+    C.L.insert(C.L.end(), A.L.begin(), A.L.end());
+    C.E.insert(C.E.end(), A.E.begin(), A.E.end());
+    return C;
+}
+
+inline CipherSoA ct_clone(const CipherSoA& A, const CipherSoA& more) {
+    CipherSoA C = CipherSoA::make(A.nbits);
+    C.L.reserve(A.L.size() + more.L.size());
+    C.L.insert(C.L.end(), A.L.begin(), A.L.end());
+    C.reserve(A.size() + more.size());
+    C.layer_id.insert(C.layer_id.end(), A.layer_id.begin(), A.layer_id.end());
+    C.idx.insert(C.idx.end(), A.idx.begin(), A.idx.end());
+    C.ch.insert(C.ch.end(), A.ch.begin(), A.ch.end());
+    C.w.insert(C.w.end(), A.w.begin(), A.w.end());
+    C.sig.insert(C.sig.end(), A.sig.begin(), A.sig.end());
     return C;
 }
 
-inline Cipher ct_scale(const PubKey&, const Cipher& A, const Fp& s) {
+// scaling is lazy: it multiplies the per layer factor Layer::k, so it
+// costs O(layers) whatever the edge count, and weights stay raw until
+// something needs them (dec_value, commit_ct fold k in on the fly)
+inline void ct_scale_layers(std::vector<Layer>& Ls, size_t from, const Fp& s) {
+    for (size_t i = from; i < Ls.size(); i++) Ls[i].k = fp_mul(Ls[i].k, s);
+}
+
+inline bool layer_k_is_one(const Layer& L) {
+    return L.k.lo == 1 && L.k.hi == 0;
+}
+
+// folds every pending factor into the edge weights, k = 1 afterwards
+inline void ct_normalize(Cipher& C) {
+    bool any = false;
+    for (const auto& L : C.L) any |= !layer_k_is_one(L);
+    if (!any) return;
+
+    for (auto& e : C.E) {
+        const Layer& L = C.L[e.layer_id];
+        if (!layer_k_is_one(L)) e.w = fp_mul(e.w, L.k);
+    }
+    for (auto& L : C.L) L.k = fp_from_u64(1);
+}
+
+inline void ct_normalize(CipherSoA& C) {
+    bool any = false;
+    for (const auto& L : C.L) any |= !layer_k_is_one(L);
+    if (!any) return;
+
+    // weights are contiguous here, so gather the factors and batch them
+    constexpr size_t BLK = 256;
+    Fp k[BLK];
+    for (size_t b = 0; b < C.size(); b += BLK) {
+        size_t m = std::min(BLK, C.size() - b);
+        for (size_t j = 0; j < m; j++) k[j] = C.L[C.layer_id[b + j]].k;
+        fp_mul_n(C.w.data() + b, C.w.data() + b, k, m);
+    }
+    for (auto& L : C.L) L.k = fp_from_u64(1);
+}
+
+// in place forms: A grows by B's layers and edges (B's layers scaled by s
+// when one is given), nothing of A is copied. the && forms steal B's
+// edges, sigmas and all, instead of copying them
+inline void ct_append(const PubKey& pk, Cipher& A, const Cipher& B, const Fp* s, const char* where) {
+    uint32_t off = ct_append_layers(A.L, B.L);
+    if (s) ct_scale_layers(A.L, off, *s);
+
+    A.E.reserve(A.E.size() + B.E.size());
+    for (const auto& e : B.E) {
+        A.E.push_back(e);
+        A.E.back().layer_id += off;
+    }
+
+    guard_budget(pk, A, where);
+    compact_layers(A);
+}
+
+inline void ct_append(const PubKey& pk, Cipher& A, Cipher&& B, const Fp* s, const char* where) {
+    uint32_t off = ct_append_layers(A.L, B.L);
+    if (s) ct_scale_layers(A.L, off, *s);
+
+    if (A.E.empty()) {
+        A.E = std::move(B.E);
+        for (auto& e : A.E) e.layer_id += off;
+    } else {
+        A.E.reserve(A.E.size() + B.E.size());
+        for (auto& e : B.E) {
+            e.layer_id += off;
+            A.E.push_back(std::move(e));
+        }
+    }
+    B.E.clear();
+    B.L.clear();
+
+    guard_budget(pk, A, where);
+    compact_layers(A);
+}
+
+inline void ct_add_inplace(const PubKey& pk, Cipher& A, const Cipher& B) {
+    ct_append(pk, A, B, nullptr, "add");
+}
+
+inline void ct_add_inplace(const PubKey& pk, Cipher& A, Cipher&& B) {
+    ct_append(pk, A, std::move(B), nullptr, "add");
+}
+
+inline void ct_scale_inplace(const PubKey&, Cipher& A, const Fp& s) {
+    ct_scale_layers(A.L, 0, s);
+}
+
+inline void ct_neg_inplace(const PubKey& pk, Cipher& A) {
+    ct_scale_inplace(pk, A, fp_neg(fp_from_u64(1)));
+}
+
+// B is negated on the way in, one copy of it instead of two
+inline void ct_sub_inplace(const PubKey& pk, Cipher& A, const Cipher& B) {
+    const Fp m1 = fp_neg(fp_from_u64(1));
+    ct_append(pk, A, B, &m1, "add");
+}
+
+inline void ct_sub_inplace(const PubKey& pk, Cipher& A, Cipher&& B) {
+    const Fp m1 = fp_neg(fp_from_u64(1));
+    ct_append(pk, A, std::move(B), &m1, "add");
+}
+
+inline Cipher ct_add(const PubKey& pk, const Cipher& A, const Cipher& B) {
+    Cipher C = ct_clone(A, B);
+    ct_add_inplace(pk, C, B);
+    return C;
+}
+
+inline Cipher ct_add(const PubKey& pk, Cipher&& A, const Cipher& B) {
+    ct_add_inplace(pk, A, B);
+    return std::move(A);
+}
+
+inline Cipher ct_add(const PubKey& pk, Cipher&& A, Cipher&& B) {
+    ct_add_inplace(pk, A, std::move(B));
+    return std::move(A);
+}
+
+inline Cipher ct_scale(const PubKey& pk, const Cipher& A, const Fp& s) {
     Cipher C = A;
-    for (auto& e : C.E) e.w = fp_mul(e.w, s);
+    ct_scale_inplace(pk, C, s);
     return C;
 }
 
+inline Cipher ct_scale(const PubKey& pk, Cipher&& A, const Fp& s) {
+    ct_scale_inplace(pk, A, s);
+    return std::move(A);
+}
+
 inline Cipher ct_neg(const PubKey& pk, const Cipher& A) {
     return ct_scale(pk, A, fp_neg(fp_from_u64(1)));
 }
 
+inline Cipher ct_neg(const PubKey& pk, Cipher&& A) {
+    return ct_scale(pk, std::move(A), fp_neg(fp_from_u64(1)));
+}
+
 inline Cipher ct_sub(const PubKey& pk, const Cipher& A, const Cipher& B) {
-    return ct_add(pk, A, ct_neg(pk, B));
+    Cipher C = ct_clone(A, B);
+    ct_sub_inplace(pk, C, B);
+    return C;
+}
+
+inline Cipher ct_sub(const PubKey& pk, Cipher&& A, const Cipher& B) {
+    ct_sub_inplace(pk, A, B);
+    return std::move(A);
+}
+
+inline Cipher ct_sub(const PubKey& pk, Cipher&& A, Cipher&& B) {
+    ct_sub_inplace(pk, A, std::move(B));
+    return std::move(A);
 }
 
-inline Cipher ct_mul(const PubKey& pk, const Cipher& A, const Cipher& B) {
+// sum of n ciphers, sized once and appended in order; the budget guard
+// and layer compaction run once at the end instead of after every add
+inline Cipher ct_accumulate(const PubKey& pk, const Cipher* cs, size_t n) {
     Cipher C;
-    
-    for (const auto& L : A.L) C.L.push_back(L);
-    uint32_t off = (uint32_t)C.L.size();
-    uint32_t LA = (uint32_t)A.L.size(), LB = (uint32_t)B.L.size();
-    
-    for (auto L : B.L) {
-        if (L.rule == RRule::PROD) { L.pa += off; L.pb += off; }
-        C.L.push_back(L);
+    size_t nl = 0, ne = 0;
+    for (size_t i = 0; i < n; i++) {
+        nl += cs[i].L.size();
+        ne += cs[i].E.size();
     }
-    
-    uint32_t base = (uint32_t)C.L.size();
+    C.L.reserve(nl);
+    C.E.reserve(ne);
+
+    for (size_t i = 0; i < n; i++) {
+        uint32_t off = ct_append_layers(C.L, cs[i].L);
+        for (const auto& e : cs[i].E) {
+            C.E.push_back(e);
+            C.E.back().layer_id += off;
+        }
+    }
+
+    guard_budget(pk, C, "accumulate");
+    compact_layers(C);
+    return C;
+}
+
+inline Cipher ct_accumulate(const PubKey& pk, const std::vector<Cipher>& cs) {
+    return ct_accumulate(pk, cs.data(), cs.size());
+}
+
+inline void ct_append(const PubKey& pk, CipherSoA& A, const CipherSoA& B, const Fp* s, const char* where) {
+    uint32_t off = ct_append_layers(A.L, B.L);
+    if (s) ct_scale_layers(A.L, off, *s);
+
+    A.reserve(A.size() + B.size());
+    for (uint32_t id : B.layer_id) A.layer_id.push_back(id + off);
+    A.idx.insert(A.idx.end(), B.idx.begin(), B.idx.end());
+    A.ch.insert(A.ch.end(), B.ch.begin(), B.ch.end());
+    A.w.insert(A.w.end(), B.w.begin(), B.w.end());
+    A.sig.insert(A.sig.end(), B.sig.begin(), B.sig.end());
+
+    guard_budget(pk, A, where);
+    compact_layers(A);
+}
+
+inline void ct_add_inplace(const PubKey& pk, CipherSoA& A, const CipherSoA& B) {
+    ct_append(pk, A, B, nullptr, "add");
+}
+
+inline void ct_scale_inplace(const PubKey&, CipherSoA& A, const Fp& s) {
+    ct_scale_layers(A.L, 0, s);
+}
+
+inline void ct_neg_inplace(const PubKey& pk, CipherSoA& A) {
+    ct_scale_inplace(pk, A, fp_neg(fp_from_u64(1)));
+}
+
+inline void ct_sub_inplace(const PubKey& pk, CipherSoA& A, const CipherSoA& B) {
+    const Fp m1 = fp_neg(fp_from_u64(1));
+    ct_append(pk, A, B, &m1, "add");
+}
+
+inline CipherSoA ct_add(const PubKey& pk, const CipherSoA& A, const CipherSoA& B) {
+    CipherSoA C = ct_clone(A, B);
+    ct_add_inplace(pk, C, B);
+    return C;
+}
+
+inline CipherSoA ct_add(const PubKey& pk, CipherSoA&& A, const CipherSoA& B) {
+    ct_add_inplace(pk, A, B);
+    return std::move(A);
+}
+
+inline CipherSoA ct_scale(const PubKey& pk, const CipherSoA& A, const Fp& s) {
+    CipherSoA C = A;
+    ct_scale_inplace(pk, C, s);
+    return C;
+}
+
+inline CipherSoA ct_scale(const PubKey& pk, CipherSoA&& A, const Fp& s) {
+    ct_scale_inplace(pk, A, s);
+    return std::move(A);
+}
+
+inline CipherSoA ct_neg(const PubKey& pk, const CipherSoA& A) {
+    return ct_scale(pk, A, fp_neg(fp_from_u64(1)));
+}
+
+inline CipherSoA ct_neg(const PubKey& pk, CipherSoA&& A) {
+    return ct_scale(pk, std::move(A), fp_neg(fp_from_u64(1)));
+}
+
+inline CipherSoA ct_sub(const PubKey& pk, const CipherSoA& A, const CipherSoA& B) {
+    CipherSoA C = ct_clone(A, B);
+    ct_sub_inplace(pk, C, B);
+    return C;
+}
+
+inline CipherSoA ct_sub(const PubKey& pk, CipherSoA&& A, const CipherSoA& B) {
+    ct_sub_inplace(pk, A, B);
+    return std::move(A);
+}
+
+// A's layers, then B's shifted past them, then one PROD layer per
+// (la, lb) pair; returns the id of the first product layer
+inline uint32_t ct_mul_layers(const PubKey& pk, const std::vector<Layer>& A,
+                              const std::vector<Layer>& B, std::vector<Layer>& C) {
+    for (const auto& L : A) C.push_back(L);
+    uint32_t off = ct_append_layers(C, B);
+    uint32_t LA = (uint32_t)A.size(), LB = (uint32_t)B.size();
+
+    uint32_t base = (uint32_t)C.size();
+    std::vector<Nonce128> nonces((size_t)LA * LB);
+    for (auto& n : nonces) n = make_nonce128();
+
+    std::vector<uint64_t> ztags(nonces.size());
+    prg_layer_ztags(pk.canon_tag, nonces.data(), ztags.data(), nonces.size());
+
     for (uint32_t la = 0; la < LA; ++la) {
         for (uint32_t lb = 0; lb < LB; ++lb) {
+            size_t k = (size_t)la * LB + lb;
             Layer L;
             L.rule = RRule::PROD;
             L.pa = la;
             L.pb = off + lb;
-            L.seed.nonce = make_nonce128();
-            L.seed.ztag = prg_layer_ztag(pk.canon_tag, L.seed.nonce);
-            C.L.push_back(L);
+            L.seed.nonce = nonces[k];
+            L.seed.ztag = ztags[k];
+            L.k = fp_mul(A[la].k, B[lb].k);
+            C.push_back(L);
         }
     }
-    
-    struct Agg { Fp wp{}, wm{}; bool ip = false, im = false; };
-    struct H { size_t operator()(uint64_t x) const noexcept { return x * 0x9E3779B97F4A7C15ull; } };
-    
-    std::unordered_map<uint64_t, Agg, H> acc;
-    acc.reserve(A.E.size() * B.E.size());
-    int Bmod = pk.prm.B;
-    
-    for (const auto& ea : A.E) {
-        for (const auto& eb : B.E) {
-            uint64_t k = ((uint64_t)(ea.layer_id * LB + eb.layer_id) << 32) | ((ea.idx + eb.idx) % Bmod);
-            Agg& a = acc[k];
-            Fp ww = fp_mul(ea.w, eb.w);
-            (ea.ch == eb.ch)
-                ? (a.ip || (a.wp = fp_from_u64(0), a.ip = true), a.wp = fp_add(a.wp, ww))
-                : (a.im || (a.wm = fp_from_u64(0), a.im = true), a.wm = fp_add(a.wm, ww));
+    return base;
+}
+
+// one operand of ct_mul bucketed per layer: w[(lid * B + idx) * 2 + ch]
+// sums every edge landing there, slots[start[lid] .. start[lid + 1]) are
+// the nonzero ones
+struct MulBuckets {
+    std::vector<Fp> w;
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> start;
+};
+
+inline MulBuckets mul_buckets(int B, size_t layers, const std::vector<EdgeMeta>& E) {
+    MulBuckets m;
+    m.w.assign(layers * B * 2, fp_from_u64(0));
+    for (const auto& e : E) {
+        Fp& x = m.w[((size_t)e.layer_id * B + e.idx) * 2 + e.ch];
+        x = fp_add(x, e.w);
+    }
+
+    m.start.reserve(layers + 1);
+    for (size_t l = 0; l < layers; l++) {
+        m.start.push_back((uint32_t)m.slots.size());
+        const Fp* w = m.w.data() + l * B * 2;
+        for (uint32_t t = 0; t < (uint32_t)B * 2; t++) {
+            if (ct::fp_is_nonzero(w[t])) m.slots.push_back(t);
         }
     }
-    
-    auto emit = [&](uint32_t lid, uint16_t idx, uint8_t ch, const Fp& w) {
-        const Layer& Lp = C.L[lid];
-        C.E.push_back(Edge{lid, idx, ch, w,
-            sigma_from_H(pk, Lp.seed.ztag, Lp.seed.nonce, idx, ch, csprng_u64())});
+    m.start.push_back((uint32_t)m.slots.size());
+    return m;
+}
+
+// r[0 .. 2n - 1) = a * b as polynomials, schoolbook below 32 terms with
+// one unreduced accumulator per output term
+inline void fp_poly_mul(const Fp* a, const Fp* b, size_t n, Fp* r) {
+    if (n <= 32) {
+        for (size_t k = 0; k + 1 < 2 * n; k++) {
+            FpAcc acc;
+            size_t i0 = k < n ? 0 : k - n + 1, i1 = std::min(k, n - 1);
+            for (size_t i = i0; i <= i1; i++) acc.mul_add(a[i], b[k - i]);
+            r[k] = acc.get();
+        }
+        return;
+    }
+
+    for (size_t i = 0; i + 1 < 2 * n; i++) r[i] = fp_from_u64(0);
+
+    // karatsuba on a = a0 + x^h a1 with a0 h terms, a1 n - h >= h terms
+    size_t h = n / 2, g = n - h;
+    std::vector<Fp> sa(g), sb(g), z0(2 * h - 1), z1(2 * g - 1), z2(2 * g - 1);
+
+    for (size_t i = 0; i < g; i++) {
+        sa[i] = i < h ? fp_add(a[i], a[h + i]) : a[h + i];
+        sb[i] = i < h ? fp_add(b[i], b[h + i]) : b[h + i];
+    }
+
+    fp_poly_mul(a, b, h, z0.data());
+    fp_poly_mul(a + h, b + h, g, z2.data());
+    fp_poly_mul(sa.data(), sb.data(), g, z1.data());
+
+    for (size_t i = 0; i < z1.size(); i++) {
+        z1[i] = fp_sub(z1[i], z2[i]);
+        if (i < z0.size()) z1[i] = fp_sub(z1[i], z0[i]);
+    }
+
+    for (size_t i = 0; i < z0.size(); i++) r[i] = z0[i];
+    for (size_t i = 0; i < z1.size(); i++) r[h + i] = fp_add(r[h + i], z1[i]);
+    for (size_t i = 0; i < z2.size(); i++) r[2 * h + i] = fp_add(r[2 * h + i], z2[i]);
+}
+
+// c = a * b mod (x^B - 1)
+inline void fp_cyclic_conv(const Fp* a, const Fp* b, size_t B, Fp* c) {
+    thread_local std::vector<Fp> r;
+    r.resize(2 * B - 1);
+    fp_poly_mul(a, b, B, r.data());
+    for (size_t k = 0; k < B; k++) c[k] = k + B < r.size() ? fp_add(r[k], r[k + B]) : r[k];
+}
+
+// fp_mul count of fp_poly_mul, for picking the dense path
+inline size_t fp_poly_mul_cost(size_t n) {
+    return n <= 32 ? n * n : 2 * fp_poly_mul_cost(n - n / 2) + fp_poly_mul_cost(n / 2);
+}
+
+// per thread buffers for one layer pair of ct_mul_terms
+struct MulScratch {
+    std::vector<Fp> acc, sa, da, sb, db, S, D;
+    std::vector<FpAcc> lazy;
+
+    void init(int B) {
+        acc.resize((size_t)B * 2);
+        lazy.resize((size_t)B * 2);
+        for (auto* v : {&sa, &da, &sb, &db, &S, &D}) v->resize(B);
+    }
+};
+
+// layer pair (la, lb) of two bucketed operands, as a length B cyclic
+// convolution of their [B][2] slots: sparse pairs multiply the nonzero
+// slots straight into a dense accumulator, dense ones do two karatsuba
+// convolutions, (Pa + Ma)(Pb + Mb) = P + M and (Pa - Ma)(Pb - Mb) = P - M.
+// nonzero sums are appended to out ordered by (idx, sign)
+inline void ct_mul_pair(int Bm, const MulBuckets& ba, uint32_t la, const MulBuckets& bb, uint32_t lb,
+                        uint32_t lid, size_t dense_at, MulScratch& t, std::vector<EdgeMeta>& out) {
+    const size_t W = (size_t)Bm * 2;
+    size_t na = ba.start[la + 1] - ba.start[la];
+    size_t nb = bb.start[lb + 1] - bb.start[lb];
+    if (!na || !nb) return;
+
+    const Fp* wa = ba.w.data() + (size_t)la * W;
+    const Fp* wb = bb.w.data() + (size_t)lb * W;
+    const uint32_t* ta = ba.slots.data() + ba.start[la];
+    const uint32_t* tb = bb.slots.data() + bb.start[lb];
+    Fp* acc = t.acc.data();
+
+    if (na * nb <= dense_at) {
+        std::fill(t.lazy.begin(), t.lazy.end(), FpAcc{});
+        for (size_t i = 0; i < na; i++) {
+            uint32_t ia = ta[i] >> 1, ca = ta[i] & 1;
+            const Fp& x = wa[ta[i]];
+            for (size_t j = 0; j < nb; j++) {
+                uint32_t k = ia + (tb[j] >> 1);
+                if (k >= (uint32_t)Bm) k -= Bm;
+                t.lazy[(size_t)k * 2 + (ca ^ (tb[j] & 1))].mul_add(x, wb[tb[j]]);
+            }
+        }
+        for (size_t k = 0; k < W; k++) acc[k] = t.lazy[k].get();
+    } else {
+        const Fp half{0, 1ull << 62}; // 2^126 = (p + 1) / 2
+        for (int k = 0; k < Bm; k++) {
+            t.sa[k] = fp_add(wa[2 * k], wa[2 * k + 1]);
+            t.da[k] = fp_sub(wa[2 * k], wa[2 * k + 1]);
+            t.sb[k] = fp_add(wb[2 * k], wb[2 * k + 1]);
+            t.db[k] = fp_sub(wb[2 * k], wb[2 * k + 1]);
+        }
+        fp_cyclic_conv(t.sa.data(), t.sb.data(), Bm, t.S.data());
+        fp_cyclic_conv(t.da.data(), t.db.data(), Bm, t.D.data());
+        for (int k = 0; k < Bm; k++) {
+            acc[2 * k] = fp_mul(fp_add(t.S[k], t.D[k]), half);
+            acc[2 * k + 1] = fp_mul(fp_sub(t.S[k], t.D[k]), half);
+        }
+    }
+
+    for (int k = 0; k < Bm; k++) {
+        if (ct::fp_is_nonzero(acc[2 * k])) out.push_back(EdgeMeta{lid, (uint16_t)k, SGN_P, acc[2 * k]});
+        if (ct::fp_is_nonzero(acc[2 * k + 1])) out.push_back(EdgeMeta{lid, (uint16_t)k, SGN_M, acc[2 * k + 1]});
+    }
+}
+
+// every (ea, eb) product summed per (layer pair, idx, sign) and returned
+// as product edges, still without sigmas. the sums are the same field
+// elements the pairwise loop gives; edges come out ordered by
+// (layer, idx, sign). with a pool the layer pair grid is cut into
+// contiguous chunks whose results are joined in chunk order, so the
+// output doesn't depend on the thread count
+inline std::vector<EdgeMeta> ct_mul_terms(const PubKey& pk,
+                                          const std::vector<EdgeMeta>& A, uint32_t LA,
+                                          const std::vector<EdgeMeta>& B, uint32_t LB,
+                                          uint32_t base, ThreadPool* pool = nullptr) {
+    const int Bm = pk.prm.B;
+
+    MulBuckets ba = mul_buckets(Bm, LA, A);
+    MulBuckets bb = mul_buckets(Bm, LB, B);
+
+    const size_t dense_at = 2 * fp_poly_mul_cost((size_t)Bm);
+    const size_t pairs = (size_t)LA * LB;
+
+    size_t nchunks = 1;
+    if (pool && pool->size() > 1) nchunks = std::min(pairs, (size_t)pool->size() * 8);
+    nchunks = std::max<size_t>(1, nchunks);
+
+    std::vector<std::vector<EdgeMeta>> part(nchunks);
+
+    auto run = [&](size_t c) {
+        thread_local MulScratch t;
+        t.init(Bm);
+        size_t p0 = pairs * c / nchunks, p1 = pairs * (c + 1) / nchunks;
+        for (size_t p = p0; p < p1; p++) {
+            uint32_t la = (uint32_t)(p / LB), lb = (uint32_t)(p % LB);
+            ct_mul_pair(Bm, ba, la, bb, lb, base + (uint32_t)p, dense_at, t, part[c]);
+        }
     };
+
+    if (nchunks > 1) {
+        pool->parallel_for(nchunks, run);
+    } else {
+        run(0);
+    }
+
+    if (nchunks == 1) return std::move(part[0]);
+
+    size_t total = 0;
+    for (const auto& v : part) total += v.size();
+    std::vector<EdgeMeta> out;
+    out.reserve(total);
+    for (const auto& v : part) out.insert(out.end(), v.begin(), v.end());
+    return out;
+}
+
+// salts are drawn on the calling thread in edge order (the drbg is per
+// thread), then the sigmas are built in parallel into their own slots
+inline std::vector<uint64_t> ct_mul_salts(size_t n) {
+    std::vector<uint64_t> salt(n);
+    for (auto& x : salt) x = csprng_u64();
+    return salt;
+}
+
+inline Cipher ct_mul(const PubKey& pk, const Cipher& A, const Cipher& B, ThreadPool* pool = &default_pool()) {
+    Cipher C;
+    uint32_t base = ct_mul_layers(pk, A.L, B.L, C.L);
+    auto terms = ct_mul_terms(pk, ct_edge_meta(A), (uint32_t)A.L.size(),
+                              ct_edge_meta(B), (uint32_t)B.L.size(), base, pool);
+    auto salt = ct_mul_salts(terms.size());
     
-    for (const auto& [k, a] : acc) {
-        uint32_t lid = base + (uint32_t)(k >> 32);
-        uint16_t idx = (uint16_t)(k & 0xFFFF);
-        if (a.ip && ct::fp_is_nonzero(a.wp)) emit(lid, idx, SGN_P, a.wp);
-        if (a.im && ct::fp_is_nonzero(a.wm)) emit(lid, idx, SGN_M, a.wm);
+    C.E.resize(terms.size());
+    auto one = [&](size_t i) {
+        const EdgeMeta& t = terms[i];
+        const Layer& Lp = C.L[t.layer_id];
+        C.E[i] = Edge{t.layer_id, t.idx, t.ch, t.w,
+            sigma_from_H(pk, Lp.seed.ztag, Lp.seed.nonce, t.idx, t.ch, salt[i])};
+    };
+
+    if (pool && pool->size() > 1) {
+        pool->parallel_for(terms.size(), one, 4);
+    } else {
+        for (size_t i = 0; i < terms.size(); i++) one(i);
     }
     
     guard_budget(pk, C, "mul");
@@ -105,8 +562,39 @@ inline Cipher ct_mul(const PubKey& pk, const Cipher& A, const Cipher& B) {
     return C;
 }
 
+inline CipherSoA ct_mul(const PubKey& pk, const CipherSoA& A, const CipherSoA& B, ThreadPool* pool = &default_pool()) {
+    CipherSoA C = CipherSoA::make((size_t)pk.prm.m_bits);
+    uint32_t base = ct_mul_layers(pk, A.L, B.L, C.L);
+    auto terms = ct_mul_terms(pk, ct_edge_meta(A), (uint32_t)A.L.size(),
+                              ct_edge_meta(B), (uint32_t)B.L.size(), base, pool);
+    auto salt = ct_mul_salts(terms.size());
+
+    C.reserve(terms.size());
+    for (const auto& t : terms) C.push(t.layer_id, t.idx, t.ch, t.w);
+
+    auto one = [&](size_t i) {
+        const EdgeMeta& t = terms[i];
+        const Layer& Lp = C.L[t.layer_id];
+        sigma_from_H_into(pk, Lp.seed.ztag, Lp.seed.nonce, t.idx, t.ch, salt[i], C.sigma(i));
+    };
+
+    if (pool && pool->size() > 1) {
+        pool->parallel_for(terms.size(), one, 4);
+    } else {
+        for (size_t i = 0; i < terms.size(); i++) one(i);
+    }
+
+    guard_budget(pk, C, "mul");
+    compact_layers(C);
+    return C;
+}
+
 inline Cipher ct_div_const(const PubKey& pk, const Cipher& A, const Fp& k) {
     return ct_scale(pk, A, fp_inv(k));
 }
 
+inline CipherSoA ct_div_const(const PubKey& pk, const CipherSoA& A, const Fp& k) {
+    return ct_scale(pk, A, fp_inv(k));
+}
+
 }
\ No newline at end of file
@@ -3,15 +3,16 @@
 #include <cstdint>
 #include <cstring>
 #include <array>
+#include <vector>
 
 #include "../core/types.hpp"
+#include "../core/cipher_soa.hpp"
 #include "../core/hash.hpp"
 
 namespace pvac {
 
-inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const Cipher & C) 
+inline void commit_begin(Sha256 & s, const PubKey & pk, const std::vector<Layer> & Ls) 
 {
-    Sha256 s;
     s.init();
     s.update(Dom::COMMIT, std::strlen(Dom::COMMIT));
 
@@ -21,7 +22,7 @@ inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const Cipher & C)
 
     sha256_acc_u64(s, pk.canon_tag);
 
-    for (const auto & L : C.L) {
+    for (const auto & L : Ls) {
         uint8_t r[1] = { (uint8_t)L.rule };
 
         s.update(r, 1);
@@ -36,48 +37,84 @@ inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const Cipher & C)
             sha256_acc_u64(s, L.pb);
         }
     }
+}
 
-    for (const auto & e : C.E) {
-        sha256_acc_u64(s, e.layer_id);
-        sha256_acc_u64(s, e.idx);
+inline void commit_edge(Sha256 & s, const EdgeMeta & e, const uint64_t * sw, size_t nbits) {
+    sha256_acc_u64(s, e.layer_id);
+    sha256_acc_u64(s, e.idx);
 
-        uint8_t ch[1] = { e.ch };
-        s.update(ch, 1);
+    uint8_t ch[1] = { e.ch };
+    s.update(ch, 1);
 
-        uint8_t w16[16];
+    uint8_t w16[16];
 
-        for (int i = 0; i < 8; i++) 
-        {
-            w16[i] = (uint8_t)((e.w.lo >> (8 * i)) & 0xFF);
-        }
+    for (int i = 0; i < 8; i++) 
+    {
+        w16[i] = (uint8_t)((e.w.lo >> (8 * i)) & 0xFF);
+    }
 
-        for (int i = 0; i < 8; i++) {
-            w16[8 + i] = (uint8_t)(((e.w.hi & MASK63) >> (8 * i)) & 0xFF);
-        }
+    for (int i = 0; i < 8; i++) {
+        w16[8 + i] = (uint8_t)(((e.w.hi & MASK63) >> (8 * i)) & 0xFF);
+    }
 
-        s.update(w16, 16);
+    s.update(w16, 16);
 
-        size_t bytes = (e.s.nbits + 7) / 8;
-        size_t full  = bytes / 8;
-        size_t rem   = bytes % 8;
+    size_t bytes = (nbits + 7) / 8;
+    size_t full  = bytes / 8;
+    size_t rem   = bytes % 8;
 
-        for (size_t i = 0; i < full; i++) {
-            uint8_t b[8];
-            store_le64(b, e.s.w[i]);
-            s.update(b, 8);
+    for (size_t i = 0; i < full; i++) {
+        uint8_t b[8];
+        store_le64(b, sw[i]);
+        s.update(b, 8);
+    }
+
+    if (rem) {
+        uint8_t b[8];
+
+        uint64_t x = sw[full];
+
+        for (size_t j = 0; j < rem; j++) {
+            b[j] = (uint8_t)((x >> (8 * j)) & 0xFF);
         }
 
-        if (rem) {
-            uint8_t b[8];
+        s.update(b, rem);
+    }
+}
 
-            uint64_t x = e.s.w[full];
+// the weight an edge stands for, so a pending layer factor hashes the
+// same as a normalized cipher (k itself is not hashed)
+inline Fp commit_weight(const std::vector<Layer> & Ls, uint32_t lid, const Fp & w) {
+    const Fp & k = Ls[lid].k;
+    return (k.lo == 1 && k.hi == 0) ? w : fp_mul(w, k);
+}
 
-            for (size_t j = 0; j < rem; j++) {
-                b[j] = (uint8_t)((x >> (8 * j)) & 0xFF);
-            }
+inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const Cipher & C) 
+{
+    Sha256 s;
+    commit_begin(s, pk, C.L);
 
-            s.update(b, rem);
-        }
+    for (const auto & e : C.E) {
+        commit_edge(s, EdgeMeta{e.layer_id, e.idx, e.ch, commit_weight(C.L, e.layer_id, e.w)},
+                    e.s.w.data(), e.s.nbits);
+    }
+
+    std::array<uint8_t, 32> out {};
+    s.finish(out.data());
+
+    return out;
+}
+
+// same bytes as the Cipher form, so a commitment doesn't depend on layout
+inline std::array<uint8_t, 32> commit_ct(const PubKey & pk, const CipherSoA & C) 
+{
+    Sha256 s;
+    commit_begin(s, pk, C.L);
+
+    for (size_t i = 0; i < C.size(); i++) {
+        EdgeMeta e = C.meta(i);
+        e.w = commit_weight(C.L, e.layer_id, e.w);
+        commit_edge(s, e, C.sigma(i), C.nbits);
     }
 
     std::array<uint8_t, 32> out {};
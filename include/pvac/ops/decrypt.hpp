@@ -2,91 +2,286 @@
 
 #include <cstdint>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 
 #include "../core/types.hpp"
+#include "../core/fp_batch.hpp"
+#include "../core/cipher_soa.hpp"
+#include "../core/parallel.hpp"
 #include "../crypto/lpn.hpp"
 
 namespace pvac {
 
+// R of one layer; cache[x] != 0 means layer x is done, vis marks the
+// layers waiting on a parent (a parent found waiting is a cycle). walks
+// an explicit stack, so PROD chains of any depth are fine
 inline Fp layer_R_cached(
     const PubKey & pk,
     const SecKey & sk,
-    const Cipher & C,
+    const std::vector<Layer> & Ls,
     uint32_t lid,
     std::vector<int> & vis,
-    std::vector<Fp> & cache
+    std::vector<Fp> & cache,
+    RCache * rc = nullptr
+) {
+    auto done = [&](uint32_t x) { return (cache[x].lo | cache[x].hi) != 0; };
+
+    if ((size_t)lid >= Ls.size()) std::abort();
+
+    std::vector<uint32_t> st{lid};
+    while (!st.empty()) {
+        uint32_t x = st.back();
+        if (done(x)) {
+            st.pop_back();
+            continue;
+        }
+
+        const Layer & L = Ls[x];
+        if (L.rule == RRule::BASE) {
+            cache[x] = prf_R_cached(pk, sk, L.seed, rc);
+            st.pop_back();
+            continue;
+        }
 
+        if ((size_t)L.pa >= Ls.size() || (size_t)L.pb >= Ls.size()) std::abort();
+
+        bool ready = true;
+        for (uint32_t p : {L.pa, L.pb}) {
+            if (done(p)) continue;
+            if (vis[p] || p == x) {
+                std::cerr << "[R] cycle\n";
+                std::abort();
+            }
+            ready = false;
+            st.push_back(p);
+        }
+
+        if (ready) {
+            cache[x] = fp_mul(cache[L.pa], cache[L.pb]);
+            vis[x] = 0;
+            st.pop_back();
+        } else {
+            vis[x] = 1;
+        }
+    }
+
+    return cache[lid];
+}
+
+inline Fp layer_R_cached(
+    const PubKey & pk,
+    const SecKey & sk,
+    const Cipher & C,
+    uint32_t lid,
+    std::vector<int> & vis,
+    std::vector<Fp> & cache,
+    RCache * rc = nullptr
 ) {
-    if ((size_t)lid >= C.L.size()) {
+    return layer_R_cached(pk, sk, C.L, lid, vis, cache, rc);
+}
+
+// R of every layer, without recursion: BASE layers first, one prf_R per
+// distinct seed (looked up in rc when given, the misses spread over
+// pool), then every PROD layer in a single sweep over a topological
+// order of the parent graph. pool = nullptr keeps it all on the caller
+inline std::vector<Fp> layers_R(const PubKey & pk, const SecKey & sk, const std::vector<Layer> & Ls,
+                                RCache * rc = nullptr, ThreadPool * pool = &default_pool()) {
+    const size_t L = Ls.size();
+    std::vector<Fp> R(L, fp_from_u64(0));
+
+    auto seed_less = [&](uint32_t x, uint32_t y) {
+        const RSeed & a = Ls[x].seed, & b = Ls[y].seed;
+        if (a.ztag != b.ztag) return a.ztag < b.ztag;
+        if (a.nonce.lo != b.nonce.lo) return a.nonce.lo < b.nonce.lo;
+        return a.nonce.hi < b.nonce.hi;
+    };
 
-        std::abort();
+    std::vector<uint32_t> base;
+    for (uint32_t x = 0; x < (uint32_t)L; x++) {
+        if (Ls[x].rule == RRule::BASE) base.push_back(x);
     }
+    std::sort(base.begin(), base.end(), seed_less);
 
-    if (cache[lid].lo | cache[lid].hi) 
-    
-    {
-        return cache[lid];
+    // group starts of equal seeds, and which groups still need a prf_R
+    const uint64_t kid = rc ? rcache_key_id(pk, sk) : 0;
+    std::vector<size_t> grp, todo;
+    for (size_t i = 0; i < base.size(); i++) {
+        if (i && !seed_less(base[i - 1], base[i])) continue;
+        grp.push_back(i);
+        if (!rc || !rc->get(Ls[base[i]].seed, R[base[i]], kid)) todo.push_back(grp.size() - 1);
     }
+    grp.push_back(base.size());
 
-    if (vis[lid]) 
-    {
-       
-        std::cerr << "[R] cycle\n";
-        std::abort();
+    auto eval = [&](size_t t) {
+        uint32_t x = base[grp[todo[t]]];
+        R[x] = prf_R(pk, sk, Ls[x].seed, pool);
+    };
+    if (pool) {
+        pool->parallel_for(todo.size(), eval);
+    } else {
+        for (size_t t = 0; t < todo.size(); t++) eval(t);
     }
 
-    vis[lid] = 1;
+    for (size_t t : todo) {
+        if (rc) rc->put(Ls[base[grp[t]]].seed, R[base[grp[t]]], kid);
+    }
+    for (size_t g = 0; g + 1 < grp.size(); g++) {
+        for (size_t i = grp[g] + 1; i < grp[g + 1]; i++) R[base[i]] = R[base[grp[g]]];
+    }
 
-    const Layer & L = C.L[lid];
-    Fp R {};
+    // post order of the PROD layers: 0 new, 1 on the stack, 2 done
+    std::vector<uint8_t> state(L, 0);
+    for (uint32_t x : base) state[x] = 2;
 
-    if (L.rule == RRule::BASE) {
-        R = prf_R(pk, sk, L.seed);
-    } else {
+    std::vector<uint32_t> order, st;
+    order.reserve(L - base.size());
+    for (uint32_t r = 0; r < (uint32_t)L; r++) {
+        if (state[r]) continue;
+        st.push_back(r);
+        while (!st.empty()) {
+            uint32_t x = st.back();
+            if (state[x] == 2) {
+                st.pop_back();
+                continue;
+            }
 
-        Fp Ra = layer_R_cached(pk, sk, C, L.pa, vis, cache);
+            const Layer & Lx = Ls[x];
+            if ((size_t)Lx.pa >= L || (size_t)Lx.pb >= L) std::abort();
 
+            bool ready = true;
+            for (uint32_t p : {Lx.pa, Lx.pb}) {
+                if (state[p] == 2) continue;
+                if (state[p] == 1 || p == x) {
+                    std::cerr << "[R] cycle\n";
+                    std::abort();
+                }
+                ready = false;
+                st.push_back(p);
+            }
 
-        // test here later ( rb)
-        Fp Rb = layer_R_cached(pk, sk, C, L.pb, vis, cache);
-        R = fp_mul(Ra, Rb);
+            if (ready) {
+                state[x] = 2;
+                order.push_back(x);
+                st.pop_back();
+            } else {
+                state[x] = 1;
+            }
+        }
     }
 
-    vis[lid] = 0;
-    cache[lid] = R;
-
+    for (uint32_t x : order) R[x] = fp_mul(R[Ls[x].pa], R[Ls[x].pb]);
     return R;
 }
 
-inline Fp dec_value(const PubKey & pk, const SecKey & sk, const Cipher & C) {
-    size_t L = C.L.size();
-
-    std::vector<Fp> cache(L, fp_from_u64(0));
-    std::vector<int> vis(L, 0);
+// rc, when given, is consulted (and filled) for BASE layers
+inline std::vector<Fp> layers_R_inv(const PubKey & pk, const SecKey & sk, const std::vector<Layer> & Ls,
+                                    RCache * rc = nullptr, ThreadPool * pool = &default_pool()) {
+    std::vector<Fp> Rinv = layers_R(pk, sk, Ls, rc, pool);
+    fp_batch_inv(Rinv);
+    return Rinv;
+}
 
-    std::vector<Fp> Rinv(L, fp_from_u64(0));
+// sum of +-w * g^idx * Rinv[lid] in blocks: gather, one fp_mul_n for the
+// per edge factors, one fp_dot_signed against the weights.
+// edge(i, w, idx, lid, ch) reads edge i
+template <class EdgeAt>
+inline Fp dec_sum(const PubKey & pk, const std::vector<Fp> & Rinv, size_t n, EdgeAt && edge) {
+    constexpr size_t BLK = 256;
+    Fp w[BLK], g[BLK], r[BLK];
+    uint8_t ch[BLK];
 
-    for (size_t lid = 0; lid < L; lid++) {
-         Fp R  = layer_R_cached(pk, sk, C, (uint32_t)lid, vis, cache);
-        Rinv[lid] = fp_inv(R);
+    Fp acc = fp_from_u64(0);
+    for (size_t b = 0; b < n; b += BLK) {
+        size_t m = std::min(BLK, n - b);
+        for (size_t j = 0; j < m; j++) {
+            uint16_t idx;
+            uint32_t lid;
+            edge(b + j, w[j], idx, lid, ch[j]);
+            g[j] = pk.powg_B[idx];
+            r[j] = Rinv[lid];
+        }
+        fp_mul_n(g, g, r, m);
+        acc = fp_add(acc, fp_dot_signed(w, g, ch, m));
     }
+    return acc;
+}
 
-    Fp acc = fp_from_u64(0);
+inline Fp dec_value(const PubKey & pk, const SecKey & sk, const Cipher & C, RCache * rc = nullptr,
+                    ThreadPool * pool = &default_pool()) {
+    std::vector<Fp> Rinv = layers_R_inv(pk, sk, C.L, rc, pool);
+    for (size_t lid = 0; lid < C.L.size(); lid++) Rinv[lid] = fp_mul(Rinv[lid], C.L[lid].k);
 
-    for (const auto & e : C.E) {
-        Fp term = fp_mul(e.w, pk.powg_B[e.idx]);
-        term = fp_mul(term, Rinv[e.layer_id]);
+    return dec_sum(pk, Rinv, C.E.size(), [&](size_t i, Fp & w, uint16_t & idx, uint32_t & lid, uint8_t & ch) {
+        const Edge & e = C.E[i];
+        w = e.w;
+        idx = e.idx;
+        lid = e.layer_id;
+        ch = e.ch;
+    });
+}
 
-        if (e.ch == SGN_P) {
-            acc = fp_add(acc, term);
-        } else {
-            acc = fp_sub(acc, term);
+// only the weight arrays are read, the sigma slab is never touched
+inline Fp dec_value(const PubKey & pk, const SecKey & sk, const CipherSoA & C, RCache * rc = nullptr,
+                    ThreadPool * pool = &default_pool()) {
+    std::vector<Fp> Rinv = layers_R_inv(pk, sk, C.L, rc, pool);
+    for (size_t lid = 0; lid < C.L.size(); lid++) Rinv[lid] = fp_mul(Rinv[lid], C.L[lid].k);
+
+    return dec_sum(pk, Rinv, C.size(), [&](size_t i, Fp & w, uint16_t & idx, uint32_t & lid, uint8_t & ch) {
+        w = C.w[i];
+        idx = C.idx[i];
+        lid = C.layer_id[i];
+        ch = C.ch[i];
+    });
+}
+
+// many ciphertexts at once: all layers go through one layers_R (seeds
+// shared between ciphers are evaluated once) and one batch inversion,
+// then the edge sums run over pool, one cipher per job
+inline std::vector<Fp> dec_values(const PubKey & pk, const SecKey & sk, const Cipher * cs, size_t n,
+                                  RCache * rc = nullptr, ThreadPool * pool = &default_pool()) {
+    std::vector<size_t> off(n + 1, 0);
+    for (size_t c = 0; c < n; c++) off[c + 1] = off[c] + cs[c].L.size();
+
+    std::vector<Layer> Ls;
+    Ls.reserve(off[n]);
+    for (size_t c = 0; c < n; c++) {
+        for (Layer L : cs[c].L) {
+            if (L.rule == RRule::PROD) {
+                L.pa += (uint32_t)off[c];
+                L.pb += (uint32_t)off[c];
+            }
+            Ls.push_back(L);
         }
     }
 
-    return acc;
+    std::vector<Fp> Rinv = layers_R(pk, sk, Ls, rc, pool);
+    fp_batch_inv(Rinv);
+    for (size_t x = 0; x < Ls.size(); x++) Rinv[x] = fp_mul(Rinv[x], Ls[x].k);
+
+    std::vector<Fp> out(n);
+    auto one = [&](size_t c) {
+        const Cipher & C = cs[c];
+        const uint32_t base = (uint32_t)off[c];
+        out[c] = dec_sum(pk, Rinv, C.E.size(), [&](size_t i, Fp & w, uint16_t & idx, uint32_t & lid, uint8_t & ch) {
+            const Edge & e = C.E[i];
+            w = e.w;
+            idx = e.idx;
+            lid = base + e.layer_id;
+            ch = e.ch;
+        });
+    };
+    if (pool) {
+        pool->parallel_for(n, one);
+    } else {
+        for (size_t c = 0; c < n; c++) one(c);
+    }
+    return out;
 }
 
+inline std::vector<Fp> dec_values(const PubKey & pk, const SecKey & sk, const std::vector<Cipher> & cs,
+                                  RCache * rc = nullptr, ThreadPool * pool = &default_pool()) {
+    return dec_values(pk, sk, cs.data(), cs.size(), rc, pool);
+}
 
 }
\ No newline at end of file
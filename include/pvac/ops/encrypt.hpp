@@ -1,12 +1,18 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <cmath>
+#include <algorithm>
 #include <vector>
 #include <unordered_set>
 #include <utility>
+#include <atomic>
+#include <chrono>
 
 #include "../core/types.hpp"
+#include "../core/cipher_soa.hpp"
+#include "../core/parallel.hpp"
 #include "../crypto/lpn.hpp"
 #include "../crypto/matrix.hpp"
 #include "../core/ct_safe.hpp"
@@ -36,54 +42,159 @@ inline double sigma_density(const PubKey& pk, const Cipher& C) {
     return (double)(ones / total);
 }
 
+// padding words are zero, so the whole slab is one popcount pass
+inline double sigma_density(const PubKey& pk, const CipherSoA& C) {
+    if (C.empty()) return 0.0;
+    uint64_t ones = 0;
+    for (uint64_t x : C.sig) ones += (uint64_t)__builtin_popcountll(x);
+    return (double)ones / ((double)C.size() * pk.prm.m_bits);
+}
+
+// stable lsd radix sort, 11 bits a pass and only as many passes as the
+// largest key needs; sorts key in place and returns where each entry came
+// from. O(n) extra memory whatever the key range
+inline std::vector<uint32_t> radix_sort_keys(std::vector<uint64_t>& key) {
+    constexpr int D = 11;
+    constexpr uint64_t R = 1ull << D;
+
+    size_t n = key.size();
+    std::vector<uint32_t> ord(n), ord2(n);
+    std::vector<uint64_t> key2(n);
+    for (size_t i = 0; i < n; i++) ord[i] = (uint32_t)i;
+
+    uint64_t top = 0;
+    for (uint64_t k : key) top |= k;
+
+    std::vector<size_t> cnt(R + 1);
+    for (int sh = 0; sh < 64 && (top >> sh) != 0; sh += D) {
+        std::fill(cnt.begin(), cnt.end(), 0);
+        for (uint64_t k : key) cnt[((k >> sh) & (R - 1)) + 1]++;
+        if (cnt[((key[0] >> sh) & (R - 1)) + 1] == n) continue;
+        for (uint64_t d = 0; d < R; d++) cnt[d + 1] += cnt[d];
+
+        for (size_t i = 0; i < n; i++) {
+            size_t j = cnt[(key[i] >> sh) & (R - 1)]++;
+            key2[j] = key[i];
+            ord2[j] = ord[i];
+        }
+        key.swap(key2);
+        ord.swap(ord2);
+    }
+    return ord;
+}
+
+// (layer, idx, +/-) as one sortable key, also the output order
+inline uint64_t edge_key(int B, uint32_t lid, uint16_t idx, uint8_t ch) {
+    return ((uint64_t)lid * (uint64_t)B + idx) * 2 + ch;
+}
+
+// sorts the edges by key, folds each run into its first edge (weights
+// added, sigmas xored) and keeps the heads that did not cancel, in key
+// order. memory is O(edges), nothing is sized by layers * B
 inline void compact_edges(const PubKey& pk, Cipher& C) {
     int B = pk.prm.B;
-    size_t L = C.L.size();
+    size_t n = C.E.size();
+    if (n == 0) return;
 
-    struct Agg { bool have_p = false, have_m = false; Fp wp, wm; BitVec sp, sm; };
-    std::vector<Agg> acc(L * B);
+    std::vector<uint64_t> key(n);
+    for (size_t i = 0; i < n; i++) key[i] = edge_key(B, C.E[i].layer_id, C.E[i].idx, C.E[i].ch);
+    std::vector<uint32_t> ord = radix_sort_keys(key);
 
-    for (const auto& e : C.E) {
-        Agg& a = acc[(size_t)e.layer_id * B + e.idx];
-        if (e.ch == SGN_P) {
-            if (!a.have_p) { a.wp = fp_from_u64(0); a.sp = BitVec::make(pk.prm.m_bits); a.have_p = true; }
-            a.wp = fp_add(a.wp, e.w);
-            a.sp.xor_with(e.s);
+    std::vector<Edge> out;
+    out.reserve(n);
+    for (size_t a = 0, b; a < n; a = b) {
+        Edge& h = C.E[ord[a]];
+        if (a + 1 < n && key[a + 1] == key[a]) {
+            FpAcc w;
+            w.add(h.w);
+            for (b = a + 1; b < n && key[b] == key[a]; b++) {
+                const Edge& e = C.E[ord[b]];
+                w.add(e.w);
+                h.s.xor_with(e.s);
+            }
+            h.w = w.get();
         } else {
-            if (!a.have_m) { a.wm = fp_from_u64(0); a.sm = BitVec::make(pk.prm.m_bits); a.have_m = true; }
-            a.wm = fp_add(a.wm, e.w);
-            a.sm.xor_with(e.s);
+            b = a + 1;
         }
+        if (ct::fp_is_nonzero(h.w) || h.s.popcnt() != 0) out.push_back(std::move(h));
     }
+    C.E.swap(out);
+}
 
-    auto nz = [](const Fp& w, const BitVec& s) { return ct::fp_is_nonzero(w) || s.popcnt() != 0; };
-
-    std::vector<Edge> out;
-    out.reserve(C.E.size());
-    for (size_t lid = 0; lid < L; lid++) {
-        for (int k = 0; k < B; k++) {
-            Agg& a = acc[lid * (size_t)B + k];
-            if (a.have_p && nz(a.wp, a.sp)) out.push_back({(uint32_t)lid, (uint16_t)k, SGN_P, a.wp, a.sp});
-            if (a.have_m && nz(a.wm, a.sm)) out.push_back({(uint32_t)lid, (uint16_t)k, SGN_M, a.wm, a.sm});
+// same order and rule as above. runs fold into a per thread scratch slab
+// (rows only, and no fresh multi MiB slab per call: that costs a page
+// fault per 4 KiB once malloc hands it back to the os), then the kept
+// rows go back into C's own slab
+inline void compact_edges(const PubKey& pk, CipherSoA& C) {
+    int B = pk.prm.B;
+    size_t n = C.size();
+    size_t stride = C.stride;
+    size_t words = C.words();
+    if (n == 0) return;
+
+    std::vector<uint64_t> key(n);
+    for (size_t i = 0; i < n; i++) key[i] = edge_key(B, C.layer_id[i], C.idx[i], C.ch[i]);
+    std::vector<uint32_t> ord = radix_sort_keys(key);
+
+    size_t rows = 1;
+    for (size_t i = 1; i < n; i++) rows += key[i] != key[i - 1];
+
+    thread_local SigmaSlab acc;
+    acc.resize(rows * stride);
+    std::vector<uint64_t> kk;
+    std::vector<Fp> w;
+    kk.reserve(rows);
+    w.reserve(rows);
+
+    for (size_t a = 0, b; a < n; a = b) {
+        uint64_t* d = acc.data() + kk.size() * stride;
+        std::memcpy(d, C.sigma(ord[a]), stride * sizeof(uint64_t));
+        FpAcc wacc;
+        wacc.add(C.w[ord[a]]);
+
+        for (b = a + 1; b < n && key[b] == key[a]; b++) {
+            const uint64_t* s = C.sigma(ord[b]);
+            for (size_t j = 0; j < words; j++) d[j] ^= s[j];
+            wacc.add(C.w[ord[b]]);
         }
+        Fp x = wacc.get();
+
+        bool nz = ct::fp_is_nonzero(x);
+        for (size_t j = 0; !nz && j < words; j++) nz = d[j] != 0;
+        if (!nz) continue;
+        kk.push_back(key[a]);
+        w.push_back(x);
     }
-    C.E.swap(out);
+
+    size_t keep = kk.size();
+    for (size_t r = 0; r < keep; r++) {
+        uint64_t k = kk[r] >> 1;
+        C.layer_id[r] = (uint32_t)(k / B);
+        C.idx[r] = (uint16_t)(k % B);
+        C.ch[r] = (uint8_t)(kk[r] & 1);
+        C.w[r] = w[r];
+    }
+    if (keep) std::memcpy(C.sigma(0), acc.data(), keep * stride * sizeof(uint64_t));
+    C.truncate(keep);
 }
 
-inline void compact_layers(Cipher& C) {
-    const size_t L = C.L.size();
+// drops layers no edge reaches (directly or through a product parent);
+// each_id(f) calls f(uint32_t&) on every edge's layer id
+template <class EachId>
+inline void compact_layer_list(std::vector<Layer>& Ls, EachId&& each_id) {
+    const size_t L = Ls.size();
     if (L == 0) return;
 
     std::vector<uint8_t> used(L, 0);
-    for (const auto& e : C.E) if (e.layer_id < L) used[e.layer_id] = 1;
+    each_id([&](uint32_t& id) { if (id < L) used[id] = 1; });
 
     for (bool changed = true; changed; ) {
         changed = false;
         for (size_t lid = 0; lid < L; ++lid) {
-            if (!used[lid] || C.L[lid].rule != RRule::PROD) continue;
+            if (!used[lid] || Ls[lid].rule != RRule::PROD) continue;
             auto mark = [&](uint32_t p) { if (p < L && !used[p]) { used[p] = 1; changed = true; } };
-            mark(C.L[lid].pa);
-            mark(C.L[lid].pb);
+            mark(Ls[lid].pa);
+            mark(Ls[lid].pb);
         }
     }
 
@@ -92,15 +203,23 @@ inline void compact_layers(Cipher& C) {
     newL.reserve(L);
 
     for (size_t lid = 0; lid < L; ++lid)
-        if (used[lid]) { remap[lid] = (uint32_t)newL.size(); newL.push_back(C.L[lid]); }
+        if (used[lid]) { remap[lid] = (uint32_t)newL.size(); newL.push_back(Ls[lid]); }
 
     if (newL.size() == L) return;
 
     for (auto& Lr : newL)
         if (Lr.rule == RRule::PROD) { Lr.pa = remap[Lr.pa]; Lr.pb = remap[Lr.pb]; }
-    for (auto& e : C.E) e.layer_id = remap[e.layer_id];
+    each_id([&](uint32_t& id) { id = remap[id]; });
 
-    C.L.swap(newL);
+    Ls.swap(newL);
+}
+
+inline void compact_layers(Cipher& C) {
+    compact_layer_list(C.L, [&](auto&& f) { for (auto& e : C.E) f(e.layer_id); });
+}
+
+inline void compact_layers(CipherSoA& C) {
+    compact_layer_list(C.L, [&](auto&& f) { for (auto& id : C.layer_id) f(id); });
 }
 
 inline void guard_budget(const PubKey& pk, Cipher& C, const char* where) {
@@ -110,6 +229,13 @@ inline void guard_budget(const PubKey& pk, Cipher& C, const char* where) {
     }
 }
 
+inline void guard_budget(const PubKey& pk, CipherSoA& C, const char* where) {
+    if (C.size() > pk.prm.edge_budget) {
+        if (g_dbg) std::cout << "[guard] " << where << ": " << C.size() << " -> compact\n";
+        compact_edges(pk, C);
+    }
+}
+
 // ndt (new)
 inline Fp prf_noise_delta(const PubKey& pk, const SecKey& sk,
                           const RSeed& base_seed, uint32_t group_id, uint8_t kind) {
@@ -159,7 +285,54 @@ inline void shuffle_edges(std::vector<Edge>& E) {
         std::swap(E[i], E[csprng_u64() % (i + 1)]);
 }
 
-inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int depth_hint) {
+// time spent per stage of encryption, summed over every thread that
+// did the work (so it can exceed the wall time)
+struct EncStats {
+    using Clock = std::chrono::steady_clock;
+    enum Stage { PRF, EDGES, COMPACT, COMBINE, N_STAGES };
+
+    std::atomic<uint64_t> ns[N_STAGES];
+
+    EncStats() { clear(); }
+
+    void clear() {
+        for (auto& x : ns) x.store(0);
+    }
+
+    // charge the time since t to stage s, t moves up to now
+    void lap(Stage s, Clock::time_point& t) {
+        auto now = Clock::now();
+        ns[s] += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - t).count();
+        t = now;
+    }
+
+    double ms(Stage s) const {
+        return ns[s].load() / 1e6;
+    }
+};
+
+// buffers of enc_fp_depth, one set per thread, reused across calls
+struct EncScratch {
+    std::unordered_set<int> used;
+    std::vector<int> idx;
+    std::vector<uint8_t> ch;
+    std::vector<Fp> r;
+    std::vector<Fp> delta;
+};
+
+inline EncScratch& enc_scratch() {
+    thread_local EncScratch sc;
+    return sc;
+}
+
+// rc, when given, gets the fresh layer's R so a later dec_value through
+// the same cache skips its prf_R. st, when given, collects stage times
+inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int depth_hint,
+                           RCache* rc = nullptr, EncStats* st = nullptr) {
+    EncStats::Clock::time_point tm;
+    if (st) tm = EncStats::Clock::now();
+
+    EncScratch& sc = enc_scratch();
     Cipher C;
 
     Layer L;
@@ -168,47 +341,52 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
     L.seed.ztag = prg_layer_ztag(pk.canon_tag, L.seed.nonce);
     C.L.push_back(L);
 
-    constexpr int S = 8;
-    std::unordered_set<int> used;
-    used.reserve(S * 2);
+    // every prf up front: the layer's R and one noise delta per group,
+    // the last group's delta cancels the rest
+    Fp R = prf_R_cached(pk, sk, L.seed, rc);
+
+    auto [Z2, Z3] = plan_noise(pk, depth_hint);
+    int total_groups = Z2 + Z3;
+    sc.delta.resize((size_t)total_groups);
+    Fp delta_acc = fp_from_u64(0);
+    for (int g = 0; g < total_groups; g++) {
+        if (g == total_groups - 1) {
+            sc.delta[g] = fp_neg(delta_acc);
+        } else {
+            sc.delta[g] = prf_noise_delta(pk, sk, L.seed, (uint32_t)g, g < Z2 ? 0 : 1);
+            delta_acc = fp_add(delta_acc, sc.delta[g]);
+        }
+    }
+    if (st) st->lap(EncStats::PRF, tm);
 
-    std::vector<int> idx(S);
-    std::vector<uint8_t> ch(S);
-    std::vector<Fp> r(S);
+    constexpr int S = 8;
+    sc.used.clear();
+    sc.used.reserve(S * 2);
+    sc.idx.resize(S);
+    sc.ch.resize(S);
+    sc.r.resize(S);
+    C.E.reserve((size_t)(S + 2 * Z2 + 3 * Z3));
 
     for (int j = 0; j < S; j++) {
-        idx[j] = pick_unique_idx(pk.prm.B, used);
-        ch[j] = csprng_u64() & 1;
+        sc.idx[j] = pick_unique_idx(pk.prm.B, sc.used);
+        sc.ch[j] = csprng_u64() & 1;
     }
 
     Fp sumg = fp_from_u64(0);
     for (int j = 0; j < S - 1; j++) {
-        r[j] = rand_fp_nonzero();
-        Fp term = fp_mul(r[j], pk.powg_B[idx[j]]);
-        sumg = sgn_val(ch[j]) > 0 ? fp_add(sumg, term) : fp_sub(sumg, term);
+        sc.r[j] = rand_fp_nonzero();
+        Fp term = fp_mul(sc.r[j], pk.powg_B[sc.idx[j]]);
+        sumg = sgn_val(sc.ch[j]) > 0 ? fp_add(sumg, term) : fp_sub(sumg, term);
     }
 
-    Fp g_last = pk.powg_B[idx[S-1]];
-    Fp r_last = fp_mul(fp_sub(v, sumg), fp_inv(g_last));
-    r[S-1] = sgn_val(ch[S-1]) < 0 ? fp_neg(r_last) : r_last;
-
-    Fp R = prf_R(pk, sk, L.seed);
+    Fp r_last = fp_mul(fp_sub(v, sumg), powg_inv(pk, sc.idx[S-1]));
+    sc.r[S-1] = sgn_val(sc.ch[S-1]) < 0 ? fp_neg(r_last) : r_last;
 
     for (int j = 0; j < S; j++)
-        C.E.push_back(make_edge(0, idx[j], ch[j], fp_mul(r[j], R), pk, L.seed));
+        C.E.push_back(make_edge(0, sc.idx[j], sc.ch[j], fp_mul(sc.r[j], R), pk, L.seed));
 
-    auto [Z2, Z3] = plan_noise(pk, depth_hint);
-    int total_groups = Z2 + Z3;
-    Fp delta_acc = fp_from_u64(0);
     int group_id = 0;
 
-    auto next_delta = [&](int groups_left, uint8_t kind) -> Fp {
-        if (groups_left <= 1) return fp_neg(delta_acc);
-        Fp d = prf_noise_delta(pk, sk, L.seed, group_id, kind);
-        delta_acc = fp_add(delta_acc, d);
-        return d;
-    };
-
     for (int t = 0; t < Z2; ++t, ++group_id) {
         int i = csprng_u64() % pk.prm.B;
         int j = pick_distinct_idx(pk.prm.B, i);
@@ -216,12 +394,12 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         uint8_t s1 = csprng_u64() & 1, s2 = s1 ^ 1;
         int sign1 = sgn_val(s1);
 
-        Fp Delta = next_delta(total_groups - group_id, 0);
+        Fp Delta = sc.delta[group_id];
         Fp Delta_prime = sign1 > 0 ? Delta : fp_neg(Delta);
 
-        Fp gi = pk.powg_B[i], gj = pk.powg_B[j];
+        Fp gi = pk.powg_B[i];
         Fp r_i = rand_fp_nonzero();
-        Fp r_j = fp_mul(fp_sub(fp_mul(r_i, gi), Delta_prime), fp_inv(gj));
+        Fp r_j = fp_mul(fp_sub(fp_mul(r_i, gi), Delta_prime), powg_inv(pk, j));
 
         C.E.push_back(make_edge(0, i, s1, fp_mul(r_i, R), pk, L.seed));
         C.E.push_back(make_edge(0, j, s2, fp_mul(r_j, R), pk, L.seed));
@@ -235,7 +413,7 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         uint8_t s1 = csprng_u64() & 1, s2 = csprng_u64() & 1, s3 = csprng_u64() & 1;
         int sign1 = sgn_val(s1), sign2 = sgn_val(s2), sign3 = sgn_val(s3);
 
-        Fp Delta = next_delta(total_groups - group_id, 1);
+        Fp Delta = sc.delta[group_id];
         Fp a = rand_fp_nonzero(), b = rand_fp_nonzero();
 
         Fp term1 = fp_mul(a, pk.powg_B[i]);
@@ -243,17 +421,18 @@ inline Cipher enc_fp_depth(const PubKey& pk, const SecKey& sk, const Fp& v, int
         if (sign1 < 0) term1 = fp_neg(term1);
         if (sign2 < 0) term2 = fp_neg(term2);
 
-        Fp gk_signed = sign3 > 0 ? pk.powg_B[k] : fp_neg(pk.powg_B[k]);
-        Fp c = fp_mul(fp_sub(Delta, fp_add(term1, term2)), fp_inv(gk_signed));
+        Fp c = fp_mul(fp_sub(Delta, fp_add(term1, term2)), powg_inv(pk, k, sign3 < 0));
 
         C.E.push_back(make_edge(0, i, s1, fp_mul(a, R), pk, L.seed));
         C.E.push_back(make_edge(0, j, s2, fp_mul(b, R), pk, L.seed));
         C.E.push_back(make_edge(0, k, s3, fp_mul(c, R), pk, L.seed));
     }
+    if (st) st->lap(EncStats::EDGES, tm);
 
     compact_edges(pk, C);
     guard_budget(pk, C, "enc");
     shuffle_edges(C.E);
+    if (st) st->lap(EncStats::COMPACT, tm);
     return C;
 }
 
@@ -278,12 +457,37 @@ inline Cipher combine_ciphers(const PubKey& pk, const Cipher& a, const Cipher& b
     return C;
 }
 
-inline Cipher enc_value_depth(const PubKey& pk, const SecKey& sk, uint64_t v, int depth_hint) {
+// both halves are temporaries in the callers below, b's edges move over
+inline Cipher combine_ciphers(const PubKey& pk, Cipher&& a, Cipher&& b) {
+    Cipher C = std::move(a);
+    uint32_t off = (uint32_t)C.L.size();
+
+    for (auto L : b.L) {
+        if (L.rule == RRule::PROD) { L.pa += off; L.pb += off; }
+        C.L.push_back(L);
+    }
+
+    C.E.reserve(C.E.size() + b.E.size());
+    for (auto& e : b.E) { e.layer_id += off; C.E.push_back(std::move(e)); }
+    b.E.clear();
+
+    guard_budget(pk, C, "combine");
+    compact_layers(C);
+    return C;
+}
+
+inline Cipher enc_value_depth(const PubKey& pk, const SecKey& sk, uint64_t v, int depth_hint,
+                              EncStats* st = nullptr) {
     Fp val = fp_from_u64(v);
     Fp mask = rand_fp_nonzero();
-    return combine_ciphers(pk,
-        enc_fp_depth(pk, sk, fp_add(val, mask), depth_hint),
-        enc_fp_depth(pk, sk, fp_neg(mask), depth_hint));
+    Cipher a = enc_fp_depth(pk, sk, fp_add(val, mask), depth_hint, nullptr, st);
+    Cipher b = enc_fp_depth(pk, sk, fp_neg(mask), depth_hint, nullptr, st);
+
+    EncStats::Clock::time_point tm;
+    if (st) tm = EncStats::Clock::now();
+    Cipher C = combine_ciphers(pk, std::move(a), std::move(b));
+    if (st) st->lap(EncStats::COMBINE, tm);
+    return C;
 }
 
 inline Cipher enc_value(const PubKey& pk, const SecKey& sk, uint64_t v) {
@@ -297,4 +501,41 @@ inline Cipher enc_zero_depth(const PubKey& pk, const SecKey& sk, int depth_hint)
         enc_fp_depth(pk, sk, fp_neg(mask), depth_hint));
 }
 
+// many values, one job per value on pool. each thread reuses its own
+// EncScratch, and the prf work of one value runs beside the edge and
+// sigma work of another
+inline std::vector<Cipher> enc_values(const PubKey& pk, const SecKey& sk, const uint64_t* v, size_t n,
+                                      int depth_hint = 0, ThreadPool* pool = &default_pool(),
+                                      EncStats* st = nullptr) {
+    std::vector<Cipher> out(n);
+    auto one = [&](size_t i) { out[i] = enc_value_depth(pk, sk, v[i], depth_hint, st); };
+    if (pool) {
+        pool->parallel_for(n, one);
+    } else {
+        for (size_t i = 0; i < n; i++) one(i);
+    }
+    return out;
+}
+
+inline std::vector<Cipher> enc_values(const PubKey& pk, const SecKey& sk, const std::vector<uint64_t>& v,
+                                      int depth_hint = 0, ThreadPool* pool = &default_pool(),
+                                      EncStats* st = nullptr) {
+    return enc_values(pk, sk, v.data(), v.size(), depth_hint, pool, st);
+}
+
+// same for raw field elements, one single layer cipher each as from
+// enc_fp_depth
+inline std::vector<Cipher> enc_fp_batch(const PubKey& pk, const SecKey& sk, const Fp* v, size_t n,
+                                        int depth_hint = 0, ThreadPool* pool = &default_pool(),
+                                        EncStats* st = nullptr) {
+    std::vector<Cipher> out(n);
+    auto one = [&](size_t i) { out[i] = enc_fp_depth(pk, sk, v[i], depth_hint, nullptr, st); };
+    if (pool) {
+        pool->parallel_for(n, one);
+    } else {
+        for (size_t i = 0; i < n; i++) one(i);
+    }
+    return out;
+}
+
 }
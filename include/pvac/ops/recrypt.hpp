@@ -23,6 +23,11 @@ inline bool sigma_needs_balance(const PubKey& pk, const Cipher& C) {
     return d < 0.495 || d > 0.505;
 }
 
+inline bool sigma_needs_balance(const PubKey& pk, const CipherSoA& C) {
+    double d = sigma_density(pk, C);
+    return d < 0.495 || d > 0.505;
+}
+
 inline Cipher ct_recrypt(const PubKey& pk, const EvalKey& ek, const Cipher& in) {
     if (ek.zero_pool.empty() || in.E.empty()) return in;
     
@@ -30,7 +35,24 @@ inline Cipher ct_recrypt(const PubKey& pk, const EvalKey& ek, const Cipher& in)
     
     for (int it = 0; it < 8 && sigma_needs_balance(pk, result); ++it) {
         size_t idx = csprng_u64() % ek.zero_pool.size();
-        result = ct_add(pk, result, ek.zero_pool[idx]);
+        ct_add_inplace(pk, result, ek.zero_pool[idx]);
+        ubk_apply(pk, result);
+        guard_budget(pk, result, "recrypt");
+    }
+    
+    compact_edges(pk, result);
+    compact_layers(result);
+    return result;
+}
+
+inline CipherSoA ct_recrypt(const PubKey& pk, const EvalKey& ek, const CipherSoA& in) {
+    if (ek.zero_pool.empty() || in.empty()) return in;
+    
+    CipherSoA result = in;
+    
+    for (int it = 0; it < 8 && sigma_needs_balance(pk, result); ++it) {
+        size_t idx = csprng_u64() % ek.zero_pool.size();
+        ct_add_inplace(pk, result, to_soa(pk, ek.zero_pool[idx]));
         ubk_apply(pk, result);
         guard_budget(pk, result, "recrypt");
     }
@@ -2,11 +2,16 @@
 
 
 #include "pvac/core/config.hpp"
+#include "pvac/core/cpu.hpp"
+#include "pvac/core/parallel.hpp"
+#include "pvac/core/aes_ctr.hpp"
 #include "pvac/core/random.hpp"
 #include "pvac/core/hash.hpp"
 #include "pvac/core/field.hpp"
+#include "pvac/core/fp_batch.hpp"
 #include "pvac/core/bitvec.hpp"
 #include "pvac/core/types.hpp"
+#include "pvac/core/cipher_soa.hpp"
 
 #include "pvac/crypto/toeplitz.hpp"
 #include "pvac/crypto/matrix.hpp"
@@ -21,6 +26,8 @@
 
 #include "pvac/utils/text.hpp"
 #include "pvac/utils/metrics.hpp"
+#include "pvac/utils/snapshot.hpp"
+#include "pvac/utils/stream.hpp"
 
 namespace pvac {
 
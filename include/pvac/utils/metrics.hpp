@@ -68,21 +68,20 @@ inline double sigma_shannon(const Cipher& C) {
 }
 
 inline Fp agg_layer_gsum(const PubKey & pk, const Cipher & X, uint32_t lid) {
-    Fp s = fp_from_u64(0);
+    FpAcc acc;
 
     for (const auto & e : X.E) {
         if (e.layer_id == lid) {
-            Fp term = fp_mul(e.w, pk.powg_B[e.idx]);
-
             if (e.ch == SGN_P) {
-                s = fp_add(s, term);
+                acc.mul_add(e.w, pk.powg_B[e.idx]);
             } else {
-                s = fp_sub(s, term);
+                acc.mul_sub(e.w, pk.powg_B[e.idx]);
             }
         }
     }
 
-    return s;
+    Fp s = acc.get();
+    return lid < X.L.size() ? fp_mul(s, X.L[lid].k) : s;
 }
 
 inline bool check_mul_gsum_all(
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+#include "../core/types.hpp"
+#include "../core/hash.hpp"
+#include "../core/parallel.hpp"
+#include "../crypto/matrix.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define PVAC_HAVE_MMAP 1
+#else
+#define PVAC_HAVE_MMAP 0
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "pk snapshots are little endian only"
+#endif
+
+// binary PubKey snapshot: everything keygen derives from canon_tag, with H
+// kept in csr form (6 MiB at default params). powg_B_inv is not stored,
+// it is rebuilt from powg_B with one batch inversion. loading maps the file, copies
+// the sections out, rebuilds the dense H and checks it against H_digest,
+// so a restarted worker skips gen_H entirely
+//
+// layout (le):
+//   u64 magic, u32 version, u32 flags
+//   params, canon_tag, H_digest[32], omega_B
+//   u64 B, powg_B[B]              (lo, hi)
+//   u64 m, ubk.perm[m]            (u32, padded to 8)
+//   u64 n + 1, H_colptr[n + 1]    (u32, padded to 8)
+//   u8 meta_sha[32]               (sha256 of everything above)
+//   u64 nnz, H_rows[nnz]          (u16, padded to 8)
+
+namespace pvac {
+
+namespace Snap {
+    constexpr uint64_t MAGIC = 0x31534b505f434150ull; // "PAC_PKS1"
+    constexpr uint32_t VER = 2;
+}
+
+struct SnapWriter {
+    std::vector<uint8_t> b;
+
+    void u64(uint64_t x) {
+        uint8_t t[8];
+        store_le64(t, x);
+        b.insert(b.end(), t, t + 8);
+    }
+
+    void u32(uint32_t x) {
+        for (int i = 0; i < 4; i++) b.push_back((uint8_t)(x >> (8 * i)));
+    }
+
+    void f64(double x) {
+        uint64_t u;
+        std::memcpy(&u, &x, 8);
+        u64(u);
+    }
+
+    void raw(const void * p, size_t n) {
+        const uint8_t * q = (const uint8_t *)p;
+        b.insert(b.end(), q, q + n);
+    }
+
+    void pad8() {
+        while (b.size() & 7) b.push_back(0);
+    }
+};
+
+struct SnapReader {
+    const uint8_t * p;
+    size_t n;
+    size_t off = 0;
+    bool ok = true;
+
+    bool need(size_t k) {
+        if (!ok || n - off < k) ok = false;
+        return ok;
+    }
+
+    uint64_t u64() {
+        if (!need(8)) return 0;
+        uint64_t x = load_le64(p + off);
+        off += 8;
+        return x;
+    }
+
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        uint32_t x = 0;
+        for (int i = 0; i < 4; i++) x |= (uint32_t)p[off + i] << (8 * i);
+        off += 4;
+        return x;
+    }
+
+    double f64() {
+        uint64_t u = u64();
+        double x;
+        std::memcpy(&x, &u, 8);
+        return x;
+    }
+
+    void raw(void * dst, size_t k) {
+        if (!need(k)) return;
+        std::memcpy(dst, p + off, k);
+        off += k;
+    }
+
+    void pad8() {
+        size_t k = (8 - (off & 7)) & 7;
+        if (need(k)) off += k;
+    }
+};
+
+inline void snap_put_params(SnapWriter & w, const Params & prm) {
+    w.u64((uint64_t)prm.B);
+    w.u64((uint64_t)prm.m_bits);
+    w.u64((uint64_t)prm.n_bits);
+    w.u64((uint64_t)prm.h_col_wt);
+    w.u64((uint64_t)prm.x_col_wt);
+    w.u64((uint64_t)prm.err_wt);
+    w.u64((uint64_t)prm.sampler_ver);
+    w.f64(prm.noise_entropy_bits);
+    w.f64(prm.tuple2_fraction);
+    w.f64(prm.depth_slope_bits);
+    w.u64((uint64_t)prm.edge_budget);
+    w.u64((uint64_t)prm.lpn_n);
+    w.u64((uint64_t)prm.lpn_t);
+    w.u64((uint64_t)prm.lpn_tau_num);
+    w.u64((uint64_t)prm.lpn_tau_den);
+    w.u64((uint64_t)prm.lpn_ver);
+    w.f64(prm.recrypt_lo);
+    w.f64(prm.recrypt_hi);
+    w.u64((uint64_t)prm.recrypt_rounds);
+}
+
+inline void snap_get_params(SnapReader & r, Params & prm) {
+    prm.B = (int)r.u64();
+    prm.m_bits = (int)r.u64();
+    prm.n_bits = (int)r.u64();
+    prm.h_col_wt = (int)r.u64();
+    prm.x_col_wt = (int)r.u64();
+    prm.err_wt = (int)r.u64();
+    prm.sampler_ver = (int)r.u64();
+    prm.noise_entropy_bits = r.f64();
+    prm.tuple2_fraction = r.f64();
+    prm.depth_slope_bits = r.f64();
+    prm.edge_budget = (size_t)r.u64();
+    prm.lpn_n = (int)r.u64();
+    prm.lpn_t = (int)r.u64();
+    prm.lpn_tau_num = (int)r.u64();
+    prm.lpn_tau_den = (int)r.u64();
+    prm.lpn_ver = (int)r.u64();
+    prm.recrypt_lo = r.f64();
+    prm.recrypt_hi = r.f64();
+    prm.recrypt_rounds = (int)r.u64();
+}
+
+inline bool save_pk_snapshot(const std::string & path, const PubKey & pk) {
+    if (!pk_has_sparse_H(pk)) {
+        std::cerr << "[snapshot] pk has no csr H, call pk_build_sparse_H\n";
+        return false;
+    }
+
+    SnapWriter w;
+    w.u64(Snap::MAGIC);
+    w.u32(Snap::VER);
+    w.u32(0);
+
+    snap_put_params(w, pk.prm);
+    w.u64(pk.canon_tag);
+    w.raw(pk.H_digest.data(), 32);
+    w.u64(pk.omega_B.lo);
+    w.u64(pk.omega_B.hi);
+
+    w.u64(pk.powg_B.size());
+    for (const auto & g : pk.powg_B) {
+        w.u64(g.lo);
+        w.u64(g.hi);
+    }
+
+    w.u64(pk.ubk.perm.size());
+    for (int x : pk.ubk.perm) w.u32((uint32_t)x);
+    w.pad8();
+
+    w.u64(pk.H_colptr.size());
+    for (uint32_t x : pk.H_colptr) w.u32(x);
+    w.pad8();
+
+    uint8_t meta[32];
+    sha256_bytes(w.b.data(), w.b.size(), meta);
+    w.raw(meta, 32);
+
+    w.u64(pk.H_rows.size());
+    w.raw(pk.H_rows.data(), pk.H_rows.size() * sizeof(uint16_t));
+    w.pad8();
+
+    // write aside and rename so readers never see a torn file
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f) return false;
+        f.write((const char *)w.b.data(), (std::streamsize)w.b.size());
+        if (!f) return false;
+    }
+
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+inline bool parse_pk_snapshot(const uint8_t * data, size_t len, PubKey & pk, bool verify) {
+    SnapReader r{data, len};
+
+    if (r.u64() != Snap::MAGIC) return false;
+    if (r.u32() != Snap::VER) return false;
+    (void)r.u32();
+
+    PubKey out;
+    snap_get_params(r, out.prm);
+    out.canon_tag = r.u64();
+    r.raw(out.H_digest.data(), 32);
+    out.omega_B.lo = r.u64();
+    out.omega_B.hi = r.u64();
+
+    int m = out.prm.m_bits;
+    int n = out.prm.n_bits;
+
+    if (!r.ok || out.prm.B <= 0 || m <= 0 || m > 65536 || n <= 0) return false;
+
+    uint64_t nb = r.u64();
+    if (nb != (uint64_t)out.prm.B || !r.need(nb * 16)) return false;
+    out.powg_B.resize(nb);
+    for (auto & g : out.powg_B) {
+        g.lo = r.u64();
+        g.hi = r.u64();
+    }
+    pk_build_powg_inv(out);
+
+    uint64_t np = r.u64();
+    if (np != (uint64_t)m || !r.need(np * 4)) return false;
+    out.ubk.perm.resize(np);
+    out.ubk.inv.assign(np, -1);
+    for (size_t i = 0; i < np; i++) {
+        uint32_t x = r.u32();
+        if (x >= np || out.ubk.inv[x] != -1) return false;
+        out.ubk.perm[i] = (int)x;
+        out.ubk.inv[x] = (int)i;
+    }
+    r.pad8();
+
+    uint64_t nc = r.u64();
+    if (nc != (uint64_t)n + 1 || !r.need(nc * 4)) return false;
+    out.H_colptr.resize(nc);
+    for (auto & x : out.H_colptr) x = r.u32();
+    r.pad8();
+
+    if (!r.ok) return false;
+
+    uint8_t meta[32], want[32];
+    sha256_bytes(data, r.off, meta);
+    r.raw(want, 32);
+    if (!r.ok || std::memcmp(meta, want, 32) != 0) return false;
+
+    uint64_t nnz = r.u64();
+    if (out.H_colptr[0] != 0 || out.H_colptr.back() != nnz) return false;
+    for (size_t c = 0; c < (size_t)n; c++) {
+        if (out.H_colptr[c] > out.H_colptr[c + 1]) return false;
+    }
+
+    if (!r.need(nnz * 2)) return false;
+    out.H_rows.resize(nnz);
+    r.raw(out.H_rows.data(), nnz * sizeof(uint16_t));
+
+    for (uint16_t x : out.H_rows) {
+        if (x >= m) return false;
+    }
+
+    out.H.assign((size_t)n, BitVec());
+    parallel_for((size_t)n, [&](size_t c) {
+        BitVec col = BitVec::make(m);
+        for (uint32_t t = out.H_colptr[c]; t < out.H_colptr[c + 1]; t++) {
+            uint16_t x = out.H_rows[t];
+            col.w[x >> 6] |= 1ull << (x & 63);
+        }
+        out.H[c] = std::move(col);
+    }, 256);
+
+    if (verify) {
+        uint8_t d[32];
+        h_digest(out, d);
+        if (std::memcmp(d, out.H_digest.data(), 32) != 0) {
+            std::cerr << "[snapshot] H_digest mismatch\n";
+            return false;
+        }
+    }
+
+    pk = std::move(out);
+    return true;
+}
+
+inline bool load_pk_snapshot(const std::string & path, PubKey & pk, bool verify = true) {
+#if PVAC_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t len = (size_t)st.st_size;
+    void * mp = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mp == MAP_FAILED) return false;
+
+    bool ok = parse_pk_snapshot((const uint8_t *)mp, len, pk, verify);
+    ::munmap(mp, len);
+    return ok;
+#else
+    std::ifstream f(path, std::ios::binary);
+    if (!f) return false;
+
+    std::vector<uint8_t> b((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    return parse_pk_snapshot(b.data(), b.size(), pk, verify);
+#endif
+}
+
+}
@@ -0,0 +1,442 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+#include <optional>
+
+#include "../core/types.hpp"
+#include "../core/hash.hpp"
+#include "../core/random.hpp"
+#include "../core/parallel.hpp"
+#include "../ops/encrypt.hpp"
+#include "../ops/decrypt.hpp"
+#include "../ops/arithmetic.hpp"
+#include "text.hpp"
+#include "snapshot.hpp"
+
+// streaming byte codec: 15 byte blocks are encrypted (or decrypted) on a
+// pool one window at a time and each cipher goes out as its own frame,
+// so memory depends on the window, never on the payload. every block is
+// encrypted at the same depth_hint. the block's byte count rides in bits
+// 120..123 of its plaintext, under the encryption.
+//
+// frames carry an hmac-sha256 tag (cut to 16 bytes) under a key derived
+// from the key pair, over the stream id, the frame index and the body;
+// the end frame is tagged with the frame count. a damaged, reordered,
+// spliced or truncated stream fails on its tag, before decryption
+//
+// layout (le):
+//   u64 magic, u32 version, u32 block bytes (15), u8 stream id[16]
+//   frames: u64 size (0 ends the stream), cipher, u8 tag[16]
+//   cipher: u32 nL, u32 nE, layers, edges
+//   layer:  u32 rule; BASE: u64 ztag, nonce lo, hi; PROD: u32 pa, pb
+//   edge:   u32 layer_id, u32 idx | ch << 16, w lo, hi, sigma words
+//           (m_bits of the key, padded to 64)
+
+namespace pvac {
+
+namespace Stream {
+    constexpr uint64_t MAGIC = 0x315358545f434150ull; // "PAC_TXS1"
+    constexpr uint32_t VER = 1;
+    constexpr uint32_t BLOCK = 15;
+    constexpr uint64_t MAX_FRAME = 1ull << 30;
+    constexpr size_t ID = 16;
+    constexpr size_t TAG = 16;
+}
+
+// hmac-sha256 with a 32 byte key; copies share the keyed prefix
+struct StreamMac {
+    Sha256 in, out;
+
+    explicit StreamMac(const uint8_t key[32]) {
+        uint8_t ip[64], op[64];
+        for (int i = 0; i < 64; i++) {
+            uint8_t k = i < 32 ? key[i] : 0;
+            ip[i] = k ^ 0x36;
+            op[i] = k ^ 0x5c;
+        }
+        in.init();
+        in.update(ip, 64);
+        out.init();
+        out.update(op, 64);
+    }
+
+    void update(const void * p, size_t n) {
+        in.update(p, n);
+    }
+
+    void u64(uint64_t x) {
+        uint8_t b[8];
+        store_le64(b, x);
+        in.update(b, 8);
+    }
+
+    void finish(uint8_t tag[32]) {
+        uint8_t d[32];
+        in.finish(d);
+        out.update(d, 32);
+        out.finish(tag);
+    }
+};
+
+// mac key of a key pair, bound to one stream id
+inline StreamMac stream_mac(const PubKey & pk, const SecKey & sk, const uint8_t id[Stream::ID]) {
+    Sha256 s;
+    s.init();
+    s.update(Dom::STREAM_MAC, std::strlen(Dom::STREAM_MAC));
+
+    uint8_t b[8];
+    for (uint64_t k : sk.prf_k) {
+        store_le64(b, k);
+        s.update(b, 8);
+    }
+    store_le64(b, pk.canon_tag);
+    s.update(b, 8);
+    s.update(pk.H_digest.data(), pk.H_digest.size());
+
+    uint8_t key[32];
+    s.finish(key);
+    StreamMac m(key);
+    m.update(id, Stream::ID);
+    return m;
+}
+
+// tag of frame idx; size 0 with no body is the end frame
+inline void stream_tag(const StreamMac & base, uint64_t idx, const uint8_t * body, size_t size,
+                       uint8_t tag[Stream::TAG]) {
+    StreamMac m = base;
+    m.u64(idx);
+    m.u64(size);
+    if (size) m.update(body, size);
+    uint8_t full[32];
+    m.finish(full);
+    std::memcpy(tag, full, Stream::TAG);
+}
+
+// weights go out with the layer factor folded in, so k is never stored
+inline void put_cipher(SnapWriter & w, const Cipher & C) {
+    w.u32((uint32_t)C.L.size());
+    w.u32((uint32_t)C.E.size());
+
+    for (const auto & L : C.L) {
+        w.u32((uint32_t)L.rule);
+        if (L.rule == RRule::BASE) {
+            w.u64(L.seed.ztag);
+            w.u64(L.seed.nonce.lo);
+            w.u64(L.seed.nonce.hi);
+        } else {
+            w.u32(L.pa);
+            w.u32(L.pb);
+        }
+    }
+
+    for (const auto & e : C.E) {
+        const Layer & L = C.L[e.layer_id];
+        Fp x = layer_k_is_one(L) ? e.w : fp_mul(e.w, L.k);
+        w.u32(e.layer_id);
+        w.u32((uint32_t)e.idx | ((uint32_t)e.ch << 16));
+        w.u64(x.lo);
+        w.u64(x.hi);
+        for (uint64_t s : e.s.w) w.u64(s);
+    }
+}
+
+// false on a short read or on anything out of range for pk. a PROD
+// layer has to name earlier layers, the order the library builds them
+// in, so a frame can never hand layers_R a cycle
+inline bool get_cipher(SnapReader & r, const PubKey & pk, Cipher & C) {
+    uint32_t nL = r.u32(), nE = r.u32();
+    size_t words = ((size_t)pk.prm.m_bits + 63) / 64;
+    if (!r.ok || (size_t)nL * 12 + (size_t)nE * (24 + 8 * words) > r.n - r.off) return false;
+
+    C.L.assign(nL, Layer{});
+    for (uint32_t i = 0; i < nL && r.ok; i++) {
+        Layer & L = C.L[i];
+        uint32_t rule = r.u32();
+        if (rule == (uint32_t)RRule::BASE) {
+            L.rule = RRule::BASE;
+            L.seed.ztag = r.u64();
+            L.seed.nonce.lo = r.u64();
+            L.seed.nonce.hi = r.u64();
+        } else if (rule == (uint32_t)RRule::PROD) {
+            L.rule = RRule::PROD;
+            L.pa = r.u32();
+            L.pb = r.u32();
+            if (L.pa >= i || L.pb >= i) return false;
+        } else {
+            return false;
+        }
+    }
+
+    C.E.resize(nE);
+    for (uint32_t i = 0; i < nE && r.ok; i++) {
+        Edge & e = C.E[i];
+        e.layer_id = r.u32();
+        uint32_t ic = r.u32();
+        e.idx = (uint16_t)(ic & 0xffff);
+        e.ch = (uint8_t)(ic >> 16);
+        e.w.lo = r.u64();
+        e.w.hi = r.u64();
+        e.s = BitVec::make(pk.prm.m_bits);
+        for (auto & s : e.s.w) s = r.u64();
+        if (e.layer_id >= nL || e.idx >= pk.prm.B || e.ch > SGN_M) return false;
+    }
+    return r.ok;
+}
+
+// byte count in bits 120..123, the 15 bytes below it
+inline Fp pack_stream_block(const uint8_t * p, size_t len) {
+    Fp x = pack_15_bytes_to_fp(p, len);
+    x.hi |= (uint64_t)len << 56;
+    return x;
+}
+
+// bytes of the block, 0 if x does not decode as one. the frame tags are
+// what catch damage, this is only a sanity check on the plaintext
+inline size_t unpack_stream_block(const Fp & x, uint8_t * out) {
+    size_t len = (size_t)(x.hi >> 56);
+    if (len == 0 || len > Stream::BLOCK) return 0;
+    unpack_fp_to_15_bytes(x, out);
+    for (size_t i = len; i < Stream::BLOCK; i++) {
+        if (out[i]) return 0;
+    }
+    return len;
+}
+
+// bytes in through write(), frames out once a window of blocks is full;
+// finish() sends the tail block and the end frame
+struct EncStreamWriter {
+    EncStreamWriter(const PubKey & pk, const SecKey & sk, std::ostream & out, int depth_hint = 2,
+                    size_t window = 256, ThreadPool * pool = &default_pool())
+        : pk(pk), sk(sk), out(out), depth_hint(depth_hint), window(std::max<size_t>(1, window)), pool(pool),
+          mac(new_stream(pk, sk, id)) {
+        SnapWriter w;
+        w.u64(Stream::MAGIC);
+        w.u32(Stream::VER);
+        w.u32(Stream::BLOCK);
+        w.raw(id, Stream::ID);
+        emit(w);
+        pend.reserve(this->window * Stream::BLOCK);
+    }
+
+    EncStreamWriter(const EncStreamWriter &) = delete;
+    EncStreamWriter & operator=(const EncStreamWriter &) = delete;
+
+    bool write(const void * data, size_t n) {
+        const uint8_t * p = (const uint8_t *)data;
+        size_t cap = window * Stream::BLOCK;
+        while (n && ok) {
+            size_t take = std::min(n, cap - pend.size());
+            pend.insert(pend.end(), p, p + take);
+            p += take;
+            n -= take;
+            if (pend.size() == cap) flush();
+        }
+        return ok;
+    }
+
+    bool finish() {
+        if (done) return ok;
+        flush();
+        uint8_t tag[Stream::TAG];
+        stream_tag(mac, nblocks, nullptr, 0, tag);
+        SnapWriter w;
+        w.u64(0);
+        w.raw(tag, Stream::TAG);
+        emit(w);
+        out.flush();
+        done = true;
+        return ok = ok && (bool)out;
+    }
+
+    uint64_t bytes() const { return nbytes; }
+    uint64_t blocks() const { return nblocks; }
+
+private:
+    static StreamMac new_stream(const PubKey & pk, const SecKey & sk, uint8_t id[Stream::ID]) {
+        csprng_bytes(id, Stream::ID);
+        return stream_mac(pk, sk, id);
+    }
+
+    void emit(const SnapWriter & w) {
+        out.write((const char *)w.b.data(), (std::streamsize)w.b.size());
+        if (!out) ok = false;
+    }
+
+    void flush() {
+        if (pend.empty() || !ok) return;
+
+        size_t nb = (pend.size() + Stream::BLOCK - 1) / Stream::BLOCK;
+        std::vector<Fp> v(nb);
+        for (size_t i = 0; i < nb; i++) {
+            size_t off = i * Stream::BLOCK;
+            v[i] = pack_stream_block(pend.data() + off, std::min<size_t>(Stream::BLOCK, pend.size() - off));
+        }
+
+        std::vector<Cipher> cs = enc_fp_batch(pk, sk, v.data(), nb, depth_hint, pool);
+
+        SnapWriter w;
+        uint8_t tag[Stream::TAG];
+        for (size_t i = 0; i < nb; i++) {
+            SnapWriter body;
+            put_cipher(body, cs[i]);
+            stream_tag(mac, nblocks + i, body.b.data(), body.b.size(), tag);
+            w.u64(body.b.size());
+            w.raw(body.b.data(), body.b.size());
+            w.raw(tag, Stream::TAG);
+        }
+        emit(w);
+
+        nbytes += pend.size();
+        nblocks += nb;
+        pend.clear();
+    }
+
+    const PubKey & pk;
+    const SecKey & sk;
+    std::ostream & out;
+    int depth_hint;
+    size_t window;
+    ThreadPool * pool;
+    uint8_t id[Stream::ID];
+    StreamMac mac;
+
+    std::vector<uint8_t> pend;
+    uint64_t nbytes = 0, nblocks = 0;
+    bool ok = true, done = false;
+};
+
+// frames in a window at a time, plaintext out through read(); read
+// returns 0 at the end frame or on error, ok() tells which
+struct DecStreamReader {
+    DecStreamReader(const PubKey & pk, const SecKey & sk, std::istream & in, size_t window = 256,
+                    ThreadPool * pool = &default_pool())
+        : pk(pk), sk(sk), in(in), window(std::max<size_t>(1, window)), pool(pool) {
+        uint8_t h[16 + Stream::ID];
+        if (!in.read((char *)h, sizeof(h))) {
+            good = false;
+            return;
+        }
+        SnapReader r{h, sizeof(h)};
+        uint64_t magic = r.u64();
+        uint32_t ver = r.u32(), block = r.u32();
+        if (magic != Stream::MAGIC || ver != Stream::VER || block != Stream::BLOCK) good = false;
+        mac.emplace(stream_mac(pk, sk, h + 16));
+    }
+
+    DecStreamReader(const DecStreamReader &) = delete;
+    DecStreamReader & operator=(const DecStreamReader &) = delete;
+
+    size_t read(void * dst, size_t n) {
+        uint8_t * p = (uint8_t *)dst;
+        size_t got = 0;
+        while (got < n) {
+            if (pos == buf.size()) {
+                if (end || !good || !fill()) break;
+                continue;
+            }
+            size_t take = std::min(n - got, buf.size() - pos);
+            std::memcpy(p + got, buf.data() + pos, take);
+            pos += take;
+            got += take;
+        }
+        return got;
+    }
+
+    bool ok() const { return good; }
+    bool eof() const { return end && pos == buf.size(); }
+
+private:
+    // tag of frame idx read from the stream and checked
+    bool check_tag(const uint8_t * body, size_t size) {
+        uint8_t got[Stream::TAG], want[Stream::TAG];
+        if (!in.read((char *)got, Stream::TAG)) return false;
+        stream_tag(*mac, idx, body, size, want);
+        uint8_t d = 0;
+        for (size_t i = 0; i < Stream::TAG; i++) d |= got[i] ^ want[i];
+        return d == 0;
+    }
+
+    // next window of frames, decrypted into buf
+    bool fill() {
+        std::vector<Cipher> cs;
+        std::vector<uint8_t> body;
+        while (cs.size() < window) {
+            uint8_t h[8];
+            if (!in.read((char *)h, 8)) return good = false;
+            uint64_t size = load_le64(h);
+            if (size == 0) {
+                if (!check_tag(nullptr, 0)) return good = false;
+                end = true;
+                break;
+            }
+            if (size > Stream::MAX_FRAME) return good = false;
+
+            body.resize((size_t)size);
+            if (!in.read((char *)body.data(), (std::streamsize)size)) return good = false;
+            if (!check_tag(body.data(), body.size())) return good = false;
+            idx++;
+            SnapReader r{body.data(), body.size()};
+            cs.emplace_back();
+            if (!get_cipher(r, pk, cs.back()) || r.off != r.n) return good = false;
+        }
+
+        std::vector<Fp> v = dec_values(pk, sk, cs, nullptr, pool);
+
+        buf.resize(v.size() * Stream::BLOCK);
+        size_t k = 0;
+        for (const auto & x : v) {
+            size_t len = unpack_stream_block(x, buf.data() + k);
+            if (!len) return good = false;
+            k += len;
+        }
+        buf.resize(k);
+        pos = 0;
+        return true;
+    }
+
+    const PubKey & pk;
+    const SecKey & sk;
+    std::istream & in;
+    size_t window;
+    ThreadPool * pool;
+
+    std::optional<StreamMac> mac;
+    uint64_t idx = 0;
+
+    std::vector<uint8_t> buf;
+    size_t pos = 0;
+    bool good = true, end = false;
+};
+
+// whole streams, chunk by chunk
+inline bool enc_stream(const PubKey & pk, const SecKey & sk, std::istream & in, std::ostream & out,
+                       int depth_hint = 2, size_t window = 256, ThreadPool * pool = &default_pool()) {
+    EncStreamWriter w(pk, sk, out, depth_hint, window, pool);
+    std::vector<char> chunk(1 << 16);
+    while (in) {
+        in.read(chunk.data(), (std::streamsize)chunk.size());
+        size_t n = (size_t)in.gcount();
+        if (n && !w.write(chunk.data(), n)) return false;
+    }
+    return !in.bad() && w.finish();
+}
+
+inline bool dec_stream(const PubKey & pk, const SecKey & sk, std::istream & in, std::ostream & out,
+                       size_t window = 256, ThreadPool * pool = &default_pool()) {
+    DecStreamReader r(pk, sk, in, window, pool);
+    std::vector<char> chunk(1 << 16);
+    size_t n;
+    while ((n = r.read(chunk.data(), chunk.size())) > 0) {
+        out.write(chunk.data(), (std::streamsize)n);
+        if (!out) return false;
+    }
+    return r.ok() && r.eof();
+}
+
+}
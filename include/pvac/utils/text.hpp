@@ -67,7 +67,9 @@ inline std::string dec_text(
 ) {
     if (cts.empty()) return {};
 
-    Fp flen = dec_value(pk, sk, cts[0]);
+    std::vector<Fp> v = dec_values(pk, sk, cts);
+
+    Fp flen = v[0];
     if (flen.hi != 0) std::cerr << "text length hi != 0, clipping\n";
 
     uint64_t len = flen.lo;
@@ -75,9 +77,8 @@ inline std::string dec_text(
     buf.reserve((size_t)len + 16);
 
     for (size_t i = 1; i < cts.size(); ++i) {
-        Fp fx = dec_value(pk, sk, cts[i]);
         uint8_t block[15];
-        unpack_fp_to_15_bytes(fx, block);
+        unpack_fp_to_15_bytes(v[i], block);
         for (int j = 0; j < 15; j++) buf.push_back(block[j]);
     }
 
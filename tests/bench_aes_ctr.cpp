@@ -0,0 +1,62 @@
+#include <pvac/core/aes_ctr.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <vector>
+#include <iostream>
+
+using namespace pvac;
+
+using Clock = std::chrono::steady_clock;
+
+static double bench(AesCtr256::Impl impl, size_t chunk, size_t total) {
+    uint8_t key[32];
+    for (int i = 0; i < 32; ++i) key[i] = (uint8_t)(i * 7 + 1);
+
+    AesCtr256 prg;
+    prg.init(key, 1);
+
+    std::vector<uint64_t> out(chunk);
+    uint64_t sink = 0;
+
+    auto t0 = Clock::now();
+    for (size_t done = 0; done < total; done += chunk) {
+        prg.fill_u64_with(out.data(), chunk, impl);
+        sink ^= out[chunk - 1];
+    }
+    double s = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    volatile uint64_t v = sink;
+    (void)v;
+    return (double)total * 8.0 / s / 1e9;
+}
+
+int main() {
+    std::cout << "- aes ctr bench -\n";
+
+#if PVAC_USE_AESNI
+    struct { const char * name; AesCtr256::Impl impl; } impls[] = {
+        {"x1", AesCtr256::Impl::X1},
+        {"x8", AesCtr256::Impl::X8},
+#if PVAC_USE_VAES
+        {"vaes", AesCtr256::Impl::VAES},
+#endif
+    };
+
+    // 65 words is one lpn row, 8192 a 64 KiB fill
+    const size_t chunks[] = {65, 1024, 8192};
+    const size_t total = (size_t)1 << 25;
+
+    for (size_t chunk : chunks) {
+        for (auto & it : impls) {
+            double gbs = bench(it.impl, chunk, total);
+            std::printf("%-5s chunk = %5zu words  %6.2f GB/s\n", it.name, chunk, gbs);
+        }
+    }
+#else
+    std::cout << "skipped (no AES-NI)\n";
+#endif
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <pvac/pvac.hpp>
+
+#include <new>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+
+#include <sys/resource.h>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// every heap allocation in the process goes through here; gcc can't see
+// that new and delete are replaced as a pair
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+static size_t g_allocs = 0;
+static size_t g_alloc_bytes = 0;
+
+void * operator new(size_t n) {
+    g_allocs++;
+    g_alloc_bytes += n;
+    if (void * p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void * operator new(size_t n, std::align_val_t al) {
+    g_allocs++;
+    g_alloc_bytes += n;
+    size_t a = (size_t)al;
+    if (void * p = std::aligned_alloc(a, (n + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete(void * p, size_t) noexcept { std::free(p); }
+void operator delete(void * p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void * p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+static long minor_faults() {
+    rusage r;
+    getrusage(RUSAGE_SELF, &r);
+    return r.ru_minflt;
+}
+
+struct Stat {
+    double us;
+    size_t allocs;
+    size_t bytes;
+    double faults;
+};
+
+template <class F>
+static Stat measure(F && fn, int reps) {
+    // a few rounds first so malloc settles on reusing the big slabs
+    // instead of mapping fresh pages every time
+    for (int i = 0; i < 3; i++) fn();
+    size_t a0 = g_allocs, b0 = g_alloc_bytes;
+    long f0 = minor_faults();
+    auto t0 = Clock::now();
+    for (int i = 0; i < reps; i++) fn();
+    auto t1 = Clock::now();
+    return Stat{
+        std::chrono::duration<double, std::micro>(t1 - t0).count() / reps,
+        (g_allocs - a0) / reps,
+        (g_alloc_bytes - b0) / reps,
+        (double)(minor_faults() - f0) / reps
+    };
+}
+
+static void row(const char * name, const Stat & aos, const Stat & soa) {
+    std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << aos.us << std::setw(12) << soa.us
+              << std::setw(10) << aos.allocs << std::setw(10) << soa.allocs
+              << std::setw(12) << aos.bytes / 1024 << std::setw(12) << soa.bytes / 1024
+              << std::setw(10) << aos.faults << std::setw(10) << soa.faults << "\n";
+}
+
+// bytes an op has to walk to see every edge with its sigma
+static size_t footprint(const Cipher & C) {
+    size_t b = C.E.capacity() * sizeof(Edge);
+    for (const auto & e : C.E) b += e.s.w.capacity() * sizeof(uint64_t);
+    return b;
+}
+
+static size_t footprint(const CipherSoA & C) {
+    return C.size() * (sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint8_t) + sizeof(Fp))
+         + C.sig.capacity() * sizeof(uint64_t);
+}
+
+int main() {
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher a = enc_value(pk, sk, 5);
+    Cipher b = enc_value(pk, sk, 7);
+    Cipher p = ct_mul(pk, a, b);
+    CipherSoA sa = to_soa(pk, a), sb = to_soa(pk, b), sp = to_soa(pk, p);
+    Cipher pp = ct_add(pk, p, p);
+    CipherSoA spp = to_soa(pk, pp);
+
+    std::cout << "- cipher layout bench -\n";
+    std::cout << "edges: a " << a.E.size() << ", p " << p.E.size() << "\n";
+    std::cout << "footprint p: aos " << footprint(p) / 1024 << " KiB, soa " << footprint(sp) / 1024 << " KiB\n\n";
+
+    std::cout << std::left << std::setw(10) << "op" << std::right
+              << std::setw(12) << "aos us" << std::setw(12) << "soa us"
+              << std::setw(10) << "aos new" << std::setw(10) << "soa new"
+              << std::setw(12) << "aos KiB" << std::setw(12) << "soa KiB"
+              << std::setw(10) << "aos pf" << std::setw(10) << "soa pf" << "\n";
+
+    Fp k = fp_from_u64(3);
+    volatile uint64_t sink = 0;
+
+    row("add",
+        measure([&] { sink = sink + ct_add(pk, p, p).E.size(); }, 100),
+        measure([&] { sink = sink + ct_add(pk, sp, sp).size(); }, 100));
+    row("scale",
+        measure([&] { sink = sink + ct_scale(pk, p, k).E.size(); }, 100),
+        measure([&] { sink = sink + ct_scale(pk, sp, k).size(); }, 100));
+    // compact times include copying the input
+    row("compact",
+        measure([&] { Cipher c = pp; compact_edges(pk, c); sink = sink + c.E.size(); }, 50),
+        measure([&] { CipherSoA c = spp; compact_edges(pk, c); sink = sink + c.size(); }, 50));
+    row("density",
+        measure([&] { sink = sink + (uint64_t)(sigma_density(pk, p) * 1e6); }, 200),
+        measure([&] { sink = sink + (uint64_t)(sigma_density(pk, sp) * 1e6); }, 200));
+    row("commit",
+        measure([&] { sink = sink + commit_ct(pk, p)[0]; }, 10),
+        measure([&] { sink = sink + commit_ct(pk, sp)[0]; }, 10));
+    row("mul",
+        measure([&] { sink = sink + ct_mul(pk, a, b).E.size(); }, 3),
+        measure([&] { sink = sink + ct_mul(pk, sa, sb).size(); }, 3));
+    row("decrypt",
+        measure([&] { sink = sink + dec_value(pk, sk, p).lo; }, 3),
+        measure([&] { sink = sink + dec_value(pk, sk, sp).lo; }, 3));
+
+    return 0;
+}
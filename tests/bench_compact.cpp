@@ -0,0 +1,109 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cassert>
+#include <iostream>
+#include <iomanip>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// the previous engine: one aggregation slot per (layer, idx), each with
+// its own pair of sigmas
+struct Agg { bool have_p = false, have_m = false; Fp wp, wm; BitVec sp, sm; };
+
+static size_t compact_dense(const PubKey& pk, Cipher& C) {
+    int B = pk.prm.B;
+    size_t L = C.L.size();
+    std::vector<Agg> acc(L * B);
+    size_t sig = 0;
+
+    for (const auto& e : C.E) {
+        Agg& a = acc[(size_t)e.layer_id * B + e.idx];
+        if (e.ch == SGN_P) {
+            if (!a.have_p) { a.wp = fp_from_u64(0); a.sp = BitVec::make(pk.prm.m_bits); a.have_p = true; sig++; }
+            a.wp = fp_add(a.wp, e.w);
+            a.sp.xor_with(e.s);
+        } else {
+            if (!a.have_m) { a.wm = fp_from_u64(0); a.sm = BitVec::make(pk.prm.m_bits); a.have_m = true; sig++; }
+            a.wm = fp_add(a.wm, e.w);
+            a.sm.xor_with(e.s);
+        }
+    }
+
+    auto nz = [](const Fp& w, const BitVec& s) { return ct::fp_is_nonzero(w) || s.popcnt() != 0; };
+
+    std::vector<Edge> out;
+    out.reserve(C.E.size());
+    for (size_t lid = 0; lid < L; lid++) {
+        for (int k = 0; k < B; k++) {
+            Agg& a = acc[lid * (size_t)B + k];
+            if (a.have_p && nz(a.wp, a.sp)) out.push_back({(uint32_t)lid, (uint16_t)k, SGN_P, a.wp, a.sp});
+            if (a.have_m && nz(a.wm, a.sm)) out.push_back({(uint32_t)lid, (uint16_t)k, SGN_M, a.wm, a.sm});
+        }
+    }
+    C.E.swap(out);
+    return acc.size() * sizeof(Agg) + sig * ((pk.prm.m_bits + 63) / 64) * 8;
+}
+
+static Cipher random_cipher(const PubKey& pk, size_t layers, size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    Cipher C;
+    C.L.resize(layers);
+    C.E.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        Edge e{(uint32_t)(rng() % layers), (uint16_t)(rng() % pk.prm.B), (uint8_t)(rng() & 1),
+               fp_from_u64(rng()), BitVec::make(pk.prm.m_bits)};
+        for (auto& x : e.s.w) x = rng();
+        C.E.push_back(std::move(e));
+    }
+    return C;
+}
+
+static double ms(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+// compact_edges against the dense table at 10k / 100k / 1M edges, one
+// layer per 100 edges. sigmas are cut to 1024 bits so the 1M case (and
+// its copy for the old engine) stays within a few hundred MiB
+int main() {
+    PubKey pk;
+    pk.prm.B = 337;
+    pk.prm.m_bits = 1024;
+
+    std::cout << "- compact_edges: radix sort vs dense table -\n";
+    std::cout << std::setw(9) << "edges" << std::setw(8) << "layers"
+              << std::setw(12) << "dense ms" << std::setw(12) << "sort ms"
+              << std::setw(14) << "dense MiB" << std::setw(12) << "sort MiB"
+              << std::setw(12) << "soa ms" << "\n";
+
+    for (size_t n : {10000, 100000, 1000000}) {
+        size_t layers = n / 100;
+        Cipher a = random_cipher(pk, layers, n, n);
+        Cipher b = a;
+        CipherSoA s = to_soa(pk, a);
+
+        auto t0 = Clock::now();
+        size_t dense_bytes = compact_dense(pk, a);
+        auto t1 = Clock::now();
+        compact_edges(pk, b);
+        auto t2 = Clock::now();
+        compact_edges(pk, s);
+        auto t3 = Clock::now();
+
+        assert(commit_ct(pk, a) == commit_ct(pk, b));
+        assert(commit_ct(pk, a) == commit_ct(pk, s));
+
+        // keys, sorted keys, two order arrays, and the kept edge headers
+        size_t sort_bytes = n * (8 + 8 + 4 + 4 + sizeof(Edge));
+
+        std::cout << std::setw(9) << n << std::setw(8) << layers << std::fixed << std::setprecision(1)
+                  << std::setw(12) << ms(t0, t1) << std::setw(12) << ms(t1, t2)
+                  << std::setw(14) << dense_bytes / 1048576.0 << std::setw(12) << sort_bytes / 1048576.0
+                  << std::setw(12) << ms(t2, t3) << "\n";
+    }
+    return 0;
+}
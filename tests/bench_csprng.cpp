@@ -0,0 +1,61 @@
+#include <pvac/pvac.hpp>
+#include <chrono>
+#include <iostream>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+static double ns_per(Clock::time_point a, Clock::time_point b, int n) {
+    return std::chrono::duration<double, std::nano>(b - a).count() / n;
+}
+
+int main() {
+    std::cout << "- csprng bench -\n";
+
+    const int N = 200000;
+    uint64_t sink = 0;
+
+    auto t0 = Clock::now();
+    for (int i = 0; i < N; i++) {
+        uint8_t b[8];
+        os_entropy_bytes(b, 8);
+        sink ^= load_le64(b);
+    }
+    auto t1 = Clock::now();
+    for (int i = 0; i < N; i++) sink ^= csprng_u64();
+    auto t2 = Clock::now();
+
+    std::cout << "os u64:   " << ns_per(t0, t1, N) << " ns\n";
+    std::cout << "drbg u64: " << ns_per(t1, t2, N) << " ns\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    const int E = 8;
+    csprng_stats_reset();
+    uint64_t os0 = g_os_entropy_calls.load();
+
+    auto t3 = Clock::now();
+    for (int i = 0; i < E; i++) {
+        Cipher c = enc_value(pk, sk, (uint64_t)i);
+        sink ^= c.E.size();
+    }
+    auto t4 = Clock::now();
+
+    CsprngStats st = csprng_stats();
+    uint64_t os1 = g_os_entropy_calls.load();
+
+    // before, every u64 and every bulk request was its own getrandom()
+    double before = (double)(st.u64_draws + st.byte_draws) / E;
+    double after = (double)(os1 - os0) / E;
+
+    std::cout << "\n- enc_value x" << E << " -\n";
+    std::cout << "syscalls / enc before: " << before << "\n";
+    std::cout << "syscalls / enc after:  " << after << "\n";
+    std::cout << "enc_value: " << ns_per(t3, t4, E) / 1e3 << " us\n";
+
+    if (sink == 42) std::cout << "";
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <vector>
+#include <cassert>
+#include <iostream>
+#include <iomanip>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// values/sec of dec_value in a loop against one dec_values call, for
+// fresh ciphers and for sums that share their base layers
+int main() {
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    std::cout << "- dec_value loop vs dec_values, values/sec -\n";
+    std::cout << std::setw(8) << "n" << std::setw(10) << "kind" << std::setw(12) << "loop"
+              << std::setw(12) << "batch" << "\n";
+
+    std::vector<Cipher> pool;
+    for (uint64_t i = 0; i < 16; i++) pool.push_back(enc_value(pk, sk, i + 1));
+
+    for (size_t n : {64, 512}) {
+        for (int shared = 0; shared < 2; shared++) {
+            std::vector<Cipher> cs;
+            for (size_t i = 0; i < n; i++) {
+                if (shared) {
+                    cs.push_back(ct_add(pk, pool[i % 16], pool[(i * 7 + 3) % 16]));
+                } else {
+                    cs.push_back(enc_value(pk, sk, i));
+                }
+            }
+
+            auto t0 = Clock::now();
+            std::vector<Fp> a;
+            for (const auto& c : cs) a.push_back(dec_value(pk, sk, c));
+            auto t1 = Clock::now();
+            std::vector<Fp> b = dec_values(pk, sk, cs);
+            auto t2 = Clock::now();
+            for (size_t i = 0; i < n; i++) assert(ct::fp_eq(a[i], b[i]));
+
+            double s0 = std::chrono::duration<double>(t1 - t0).count();
+            double s1 = std::chrono::duration<double>(t2 - t1).count();
+            std::cout << std::setw(8) << n << std::setw(10) << (shared ? "shared" : "fresh")
+                      << std::fixed << std::setprecision(1) << std::setw(12) << n / s0
+                      << std::setw(12) << n / s1 << "\n";
+        }
+    }
+    return 0;
+}
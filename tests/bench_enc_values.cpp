@@ -0,0 +1,43 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// values/sec of enc_value in a loop against enc_values, and where the
+// batch spends its time
+int main() {
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    const size_t n = 512;
+    std::vector<uint64_t> v(n);
+    for (size_t i = 0; i < n; i++) v[i] = csprng_u64();
+
+    std::cout << "- enc_value loop vs enc_values (n = " << n << ", pool of "
+              << default_pool().size() << ") -\n";
+
+    for (int depth : {0, 2}) {
+        auto t0 = Clock::now();
+        std::vector<Cipher> a;
+        for (uint64_t x : v) a.push_back(enc_value_depth(pk, sk, x, depth));
+        auto t1 = Clock::now();
+        EncStats st;
+        std::vector<Cipher> b = enc_values(pk, sk, v, depth, &default_pool(), &st);
+        auto t2 = Clock::now();
+
+        double s0 = std::chrono::duration<double>(t1 - t0).count();
+        double s1 = std::chrono::duration<double>(t2 - t1).count();
+        std::cout << "depth " << depth << std::fixed << std::setprecision(1)
+                  << ": loop " << n / s0 << " values/s, batch " << n / s1 << " values/s\n";
+        std::cout << "  stages (ms): prf " << st.ms(EncStats::PRF) << ", edges " << st.ms(EncStats::EDGES)
+                  << ", compact " << st.ms(EncStats::COMPACT) << ", combine " << st.ms(EncStats::COMBINE) << "\n";
+    }
+    return 0;
+}
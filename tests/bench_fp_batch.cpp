@@ -0,0 +1,69 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// ns per element of each batch op, every available backend
+int main() {
+    const size_t n = 4096;
+    const int reps = 400;
+
+    std::vector<Fp> a(n), b(n), r(n);
+    std::vector<uint8_t> ch(n);
+    for (size_t i = 0; i < n; i++) {
+        a[i] = rand_fp_nonzero();
+        b[i] = rand_fp_nonzero();
+        ch[i] = csprng_u64() & 1;
+    }
+    Fp s = rand_fp_nonzero();
+    uint64_t sink = 0;
+
+    auto ns = [&](auto&& fn) {
+        fn();
+        auto t0 = Clock::now();
+        for (int k = 0; k < reps; k++) fn();
+        auto t1 = Clock::now();
+        sink ^= r[n / 2].lo;
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / reps / n;
+    };
+
+    std::cout << "- fp batch ops, ns per element (n = " << n << ") -\n";
+    std::cout << std::setw(8) << "impl" << std::setw(10) << "mul_n" << std::setw(10) << "scale_n"
+              << std::setw(10) << "add_n" << std::setw(10) << "dot" << "\n";
+
+    bool ok[3];
+    fp_detail::avail(ok);
+    for (int k = 0; k < 3; k++) {
+        if (!ok[k]) continue;
+        FpBatchOps ops = fp_batch_ops((FpImpl)k);
+
+        double m = ns([&] { ops.mul_n(r.data(), a.data(), b.data(), n); });
+        double sc = ns([&] { ops.scale_n(r.data(), a.data(), s, n); });
+        double ad = ns([&] { ops.add_n(r.data(), a.data(), b.data(), n); });
+        double d = ns([&] { r[n / 2] = ops.dot_signed(a.data(), b.data(), ch.data(), n); });
+
+        std::cout << std::setw(8) << fp_detail::NAMES[k] << std::fixed << std::setprecision(2)
+                  << std::setw(10) << m << std::setw(10) << sc << std::setw(10) << ad
+                  << std::setw(10) << d << "\n";
+    }
+
+    // one long sum, reduced on every add against FpAcc
+    double chain = ns([&] {
+        Fp s = fp_from_u64(0);
+        for (size_t i = 0; i < n; i++) s = fp_add(s, a[i]);
+        r[n / 2] = s;
+    });
+    double lazy = ns([&] {
+        FpAcc s;
+        for (size_t i = 0; i < n; i++) s.add(a[i]);
+        r[n / 2] = s.get();
+    });
+    std::cout << "sum: fp_add " << chain << " ns, FpAcc " << lazy << " ns\n";
+    std::cout << "(" << (sink & 1) << ")\n";
+    return 0;
+}
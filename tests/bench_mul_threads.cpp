@@ -0,0 +1,57 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// ct_mul wall time against pool size, 1 .. hardware threads (at least 4)
+int main() {
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher a = enc_value(pk, sk, 3);
+    Cipher b = enc_value(pk, sk, 5);
+    Cipher p = ct_mul(pk, a, b, nullptr);
+
+    int hw = (int)std::thread::hardware_concurrency();
+    std::vector<int> sizes;
+    for (int n = 1; n <= std::max(4, hw); n *= 2) sizes.push_back(n);
+    if (hw > 4 && sizes.back() != hw) sizes.push_back(hw);
+
+    std::cout << "- ct_mul thread scaling -\n";
+    std::cout << "hardware threads: " << hw << "\n";
+    std::cout << "fresh x fresh: " << a.E.size() << " x " << b.E.size()
+              << " edges, product x fresh: " << p.E.size() << " x " << a.E.size() << " edges\n\n";
+
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "fresh ms"
+              << std::setw(14) << "product ms" << std::setw(10) << "speedup" << "\n";
+
+    double base = 0;
+    for (int nt : sizes) {
+        ThreadPool pool(nt);
+        const int reps = 3;
+
+        ct_mul(pk, a, b, &pool);
+        auto t0 = Clock::now();
+        for (int i = 0; i < reps; i++) ct_mul(pk, a, b, &pool);
+        auto t1 = Clock::now();
+        for (int i = 0; i < reps; i++) ct_mul(pk, p, a, &pool);
+        auto t2 = Clock::now();
+
+        double f = std::chrono::duration<double, std::milli>(t1 - t0).count() / reps;
+        double q = std::chrono::duration<double, std::milli>(t2 - t1).count() / reps;
+        if (nt == 1) base = q;
+
+        std::cout << std::setw(8) << nt << std::fixed << std::setprecision(1)
+                  << std::setw(14) << f << std::setw(14) << q
+                  << std::setw(9) << std::setprecision(2) << base / q << "x\n";
+    }
+    return 0;
+}
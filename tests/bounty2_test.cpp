@@ -110,10 +110,13 @@ namespace ser {
         return e;
     };
     auto putCipher = [](std::ostream& o, const Cipher& C) {
-        put32(o, (uint32_t)C.L.size());
-        put32(o, (uint32_t)C.E.size());
-        for (const auto& L : C.L) putLayer(o, L);
-        for (const auto& e : C.E) putEdge(o, e);
+        // the format has no layer k, fold it into the weights
+        Cipher N = C;
+        ct_normalize(N);
+        put32(o, (uint32_t)N.L.size());
+        put32(o, (uint32_t)N.E.size());
+        for (const auto& L : N.L) putLayer(o, L);
+        for (const auto& e : N.E) putEdge(o, e);
     };
     auto getCipher = [](std::istream& i) -> Cipher {
         Cipher C;
@@ -298,5 +301,13 @@ int main() {
     assert(fa.lo == a && fb.lo == b && fsum.lo == a + b);
     assert(fa.hi == 0 && fb.hi == 0 && fsum.hi == 0);
 
+    // ct_sub leaves k = -1 on b's layers, the file has to carry it
+    saveCts({ct_sub(pk, ct_b, ct_a)}, dir + "/diff.ct");
+    auto fdiff = dec_value(pk2, sk2, loadCts(dir + "/diff.ct")[0]);
+
+    std::cout << "dec b - a = " << fdiff.lo << "\n";
+
+    assert(fdiff.lo == b - a && fdiff.hi == 0);
+
     std::cout << "ok\n";
 }
\ No newline at end of file
@@ -116,10 +116,13 @@ Edge getEdge(std::istream& i) {
 }
 
 void putCipher(std::ostream& o, const Cipher& C) {
-    put32(o, (uint32_t)C.L.size());
-    put32(o, (uint32_t)C.E.size());
-    for (const auto& L : C.L) putLayer(o, L);
-    for (const auto& e : C.E) putEdge(o, e);
+    // the format has no layer k, fold it into the weights
+    Cipher N = C;
+    ct_normalize(N);
+    put32(o, (uint32_t)N.L.size());
+    put32(o, (uint32_t)N.E.size());
+    for (const auto& L : N.L) putLayer(o, L);
+    for (const auto& e : N.E) putEdge(o, e);
 }
 
 Cipher getCipher(std::istream& i) {
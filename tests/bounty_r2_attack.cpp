@@ -23,7 +23,8 @@ inline void fp_to_bytes(const Fp& f, uint8_t out[15]) {
 }
 
 inline Fp try_decrypt_layer(const PubKey& pk, const Cipher& ct, size_t layer_id, const Fp& R_cand) {
-    Fp R_inv = fp_inv(R_cand);
+    // effective weight is e.w * k, fold the layer's k in with R^-1
+    Fp R_inv = fp_mul(fp_inv(R_cand), ct.L[layer_id].k);
     Fp sum = fp_from_u64(0);
     for (const auto& e : ct.E) {
         if (e.layer_id != layer_id) continue;
@@ -4,6 +4,7 @@
 #include <cstring>
 #include <cassert>
 #include <iostream>
+#include <vector>
 
 using namespace pvac;
 
@@ -67,6 +68,58 @@ int main() {
     assert(diff_k1 != v1);
     std::cout << "key separation: ok\n";
 
+    // FIPS-197 C.3 single block
+    {
+        uint8_t k3[32], pt[16];
+        for (int i = 0; i < 32; ++i) k3[i] = (uint8_t)i;
+        for (int i = 0; i < 16; ++i) pt[i] = (uint8_t)(0x11 * i);
+        const uint8_t want[16] = {
+            0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf,
+            0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89
+        };
+        AesCtr256 e;
+        e.init(k3, 0);
+        uint8_t ct[16];
+        _mm_storeu_si128((__m128i*)ct, e.enc_block(_mm_loadu_si128((const __m128i*)pt)));
+        assert(std::memcmp(ct, want, 16) == 0);
+        std::cout << "fips-197 block: ok\n";
+    }
+
+    // every fill impl gives the next_u64 stream, across odd splits and
+    // a low-lane counter wrap
+    {
+        const AesCtr256::Impl impls[] = {
+            AesCtr256::Impl::X1, AesCtr256::Impl::X8, AesCtr256::Impl::VAES
+        };
+        const size_t splits[] = {1, 3, 16, 17, 33, 64, 250, 1, 513};
+        const uint64_t nonces[] = {0, 7, ~0ull - 20};
+
+        for (uint64_t nonce : nonces) {
+            size_t total = 0;
+            for (size_t s : splits) total += s;
+
+            std::vector<uint64_t> ref(total);
+            AesCtr256 r;
+            r.init(key, nonce);
+            for (size_t i = 0; i < total; ++i) ref[i] = r.next_u64();
+            uint64_t after = r.next_u64();
+
+            for (auto impl : impls) {
+                std::vector<uint64_t> got(total);
+                AesCtr256 g;
+                g.init(key, nonce);
+                size_t off = 0;
+                for (size_t s : splits) {
+                    g.fill_u64_with(got.data() + off, s, impl);
+                    off += s;
+                }
+                assert(got == ref);
+                assert(g.next_u64() == after);
+            }
+        }
+        std::cout << "fill impls match: ok (vaes " << (PVAC_USE_VAES ? "on" : "off") << ")\n";
+    }
+
     prg.init(key, 42);
     for (int i = 0; i < 1000; ++i) {
         uint64_t b = prg.bounded(100);
@@ -101,6 +101,42 @@ int main() {
     }
     std::cout << "popcnt/xor/dot: ok\n";
 
+    for (size_t words : {1u, 3u, 31u, 128u, 129u, 200u}) {
+        const size_t k = 37;
+        std::vector<std::vector<uint64_t>> cols(k, std::vector<uint64_t>(words));
+        std::vector<const uint64_t*> src(k);
+        for (size_t j = 0; j < k; ++j) {
+            for (auto& x : cols[j]) x = rng();
+            src[j] = cols[j].data();
+        }
+
+        std::vector<uint64_t> init(words);
+        for (auto& x : init) x = rng();
+
+        std::vector<uint64_t> ref = init;
+        for (size_t j = 0; j < k; ++j)
+            for (size_t i = 0; i < words; ++i) ref[i] ^= cols[j][i];
+
+        std::vector<uint64_t> out = init;
+        bv_xor_many_scalar(out.data(), src.data(), k, words);
+        assert(out == ref);
+
+#if defined(__AVX2__)
+        out = init;
+        bv_xor_many_avx2(out.data(), src.data(), k, words);
+        assert(out == ref);
+#endif
+#if defined(__AVX512F__)
+        out = init;
+        bv_xor_many_avx512(out.data(), src.data(), k, words);
+        assert(out == ref);
+#endif
+        out = init;
+        bv_xor_many(out.data(), src.data(), k, words);
+        assert(out == ref);
+    }
+    std::cout << "xor_many: ok\n";
+
     std::cout << "PASS\n";
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include <pvac/pvac.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+
+static bool same_meta(const std::vector<EdgeMeta>& a, const std::vector<EdgeMeta>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].layer_id != b[i].layer_id || a[i].idx != b[i].idx || a[i].ch != b[i].ch) return false;
+        if (!ct::fp_eq(a[i].w, b[i].w)) return false;
+    }
+    return true;
+}
+
+// exact match: layers, edge fields and every sigma word
+static bool same_ct(const PubKey& pk, const Cipher& A, const CipherSoA& S) {
+    if (commit_ct(pk, A) != commit_ct(pk, S)) return false;
+    return same_meta(ct_edge_meta(A), ct_edge_meta(S));
+}
+
+static uint64_t dec_u64(const PubKey& pk, const SecKey& sk, const CipherSoA& C) {
+    Fp v = dec_value(pk, sk, C);
+    assert(v.hi == 0);
+    return v.lo;
+}
+
+int main() {
+    std::cout << "- cipher soa test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher a = enc_value(pk, sk, 5);
+    Cipher b = enc_value(pk, sk, 7);
+    CipherSoA sa = to_soa(pk, a);
+    CipherSoA sb = to_soa(pk, b);
+
+    assert(sa.size() == a.E.size());
+    assert(sa.stride % 8 == 0 && sa.stride >= sa.words());
+    assert(((uintptr_t)sa.sig.data() & 63) == 0);
+    assert(same_ct(pk, a, sa));
+
+    Cipher back = from_soa(sa);
+    assert(back.L.size() == a.L.size());
+    for (size_t i = 0; i < a.E.size(); i++) {
+        assert(back.E[i].s.nbits == a.E[i].s.nbits);
+        assert(back.E[i].s.w == a.E[i].s.w);
+    }
+    assert(commit_ct(pk, back) == commit_ct(pk, a));
+    std::cout << "roundtrip: ok\n";
+
+    assert(std::fabs(sigma_density(pk, sa) - sigma_density(pk, a)) < 1e-12);
+    assert(dec_u64(pk, sk, sa) == 5);
+    std::cout << "density / decrypt: ok\n";
+
+    assert(same_ct(pk, ct_add(pk, a, b), ct_add(pk, sa, sb)));
+    assert(same_ct(pk, ct_sub(pk, a, b), ct_sub(pk, sa, sb)));
+    Fp k = fp_from_u64(3);
+    assert(same_ct(pk, ct_scale(pk, a, k), ct_scale(pk, sa, k)));
+    assert(same_ct(pk, ct_div_const(pk, a, k), ct_div_const(pk, sa, k)));
+    assert(dec_u64(pk, sk, ct_add(pk, sa, sb)) == 12);
+    std::cout << "add / sub / scale: ok\n";
+
+    // duplicate every slot so compaction has sums and sigma xors to do
+    Cipher d = ct_add(pk, a, ct_scale(pk, a, k));
+    d.L.resize(a.L.size());
+    for (auto& e : d.E) e.layer_id %= (uint32_t)a.L.size();
+    CipherSoA sd = to_soa(pk, d);
+    compact_edges(pk, d);
+    compact_edges(pk, sd);
+    assert(same_ct(pk, d, sd));
+
+    Cipher u = a;
+    CipherSoA su = sa;
+    ubk_apply(pk, u);
+    ubk_apply(pk, su);
+    assert(same_ct(pk, u, su));
+    std::cout << "compact / ubk: ok\n";
+
+    // mul draws fresh nonces, so only the weight side can match exactly
+    Cipher m = ct_mul(pk, a, b);
+    CipherSoA sm = ct_mul(pk, sa, sb);
+    assert(m.L.size() == sm.L.size());
+    assert(same_meta(ct_edge_meta(m), ct_edge_meta(sm)));
+    assert(dec_u64(pk, sk, sm) == 35);
+    double dm = sigma_density(pk, sm);
+    assert(dm > 0.45 && dm < 0.55);
+    std::cout << "mul: ok\n";
+
+    EvalKey ek = make_evalkey(pk, sk, 4, 0);
+    CipherSoA r = ct_recrypt(pk, ek, sm);
+    assert(dec_u64(pk, sk, r) == 35);
+    std::cout << "recrypt: ok\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <pvac/pvac.hpp>
+
+#include <map>
+#include <random>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+
+// edges packed onto few slots so runs are long, plus pairs that cancel
+static Cipher random_cipher(int B, int m, size_t layers, size_t n, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    Cipher C;
+    C.L.resize(layers);
+
+    for (size_t i = 0; i < n; i++) {
+        Edge e;
+        e.layer_id = (uint32_t)(rng() % layers);
+        e.idx = (uint16_t)(rng() % 8);
+        e.ch = (uint8_t)(rng() & 1);
+        e.w = fp_from_u64(rng() % 5);
+        e.s = BitVec::make(m);
+        for (auto& x : e.s.w) x = rng() & rng() & rng();
+        e.s.w.back() &= (m & 63) ? (1ull << (m & 63)) - 1 : ~0ull;
+
+        if (i % 7 == 0) {
+            e.idx = (uint16_t)(8 + i % (B - 8));
+            Edge f = e;
+            f.w = fp_neg(e.w);
+            C.E.push_back(f);
+        }
+        C.E.push_back(std::move(e));
+    }
+    return C;
+}
+
+// ordered map over (layer, idx, ch): what compaction has to give back
+static std::vector<Edge> compact_ref(int B, const Cipher& C) {
+    std::map<uint64_t, Edge> m;
+    for (const auto& e : C.E) {
+        uint64_t k = edge_key(B, e.layer_id, e.idx, e.ch);
+        auto it = m.find(k);
+        if (it == m.end()) {
+            m.emplace(k, e);
+        } else {
+            it->second.w = fp_add(it->second.w, e.w);
+            it->second.s.xor_with(e.s);
+        }
+    }
+
+    std::vector<Edge> out;
+    for (auto& kv : m) {
+        if (ct::fp_is_nonzero(kv.second.w) || kv.second.s.popcnt() != 0) out.push_back(kv.second);
+    }
+    return out;
+}
+
+static bool same_edges(const std::vector<Edge>& a, const std::vector<Edge>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].layer_id != b[i].layer_id || a[i].idx != b[i].idx || a[i].ch != b[i].ch) return false;
+        if (!ct::fp_eq(a[i].w, b[i].w) || a[i].s.w != b[i].s.w) return false;
+    }
+    return true;
+}
+
+int main() {
+    std::cout << "- compact edges test -\n";
+
+    // sort order over a wide key range, several digits deep
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> key(5000);
+    for (auto& k : key) k = rng() >> (rng() % 64);
+    std::vector<uint64_t> orig = key;
+    std::vector<uint32_t> ord = radix_sort_keys(key);
+    for (size_t i = 0; i < key.size(); i++) {
+        assert(orig[ord[i]] == key[i]);
+        if (i) assert(key[i - 1] < key[i] || (key[i - 1] == key[i] && ord[i - 1] < ord[i]));
+    }
+    std::cout << "radix sort: ok\n";
+
+    PubKey pk;
+    pk.prm.B = 337;
+    pk.prm.m_bits = 1000;
+
+    for (size_t layers : {1, 3, 500}) {
+        for (size_t n : {1, 50, 4000}) {
+            Cipher C = random_cipher(pk.prm.B, pk.prm.m_bits, layers, n, layers * 131 + n);
+            std::vector<Edge> want = compact_ref(pk.prm.B, C);
+
+            CipherSoA S = to_soa(pk, C);
+            compact_edges(pk, C);
+            assert(same_edges(C.E, want));
+
+            compact_edges(pk, S);
+            assert(same_edges(from_soa(S).E, want));
+            assert(((uintptr_t)S.sig.data() & 63) == 0);
+        }
+    }
+    std::cout << "matches reference: ok\n";
+
+    // a run that cancels completely leaves nothing
+    Cipher z;
+    z.L.resize(2);
+    Edge e{1, 5, SGN_M, fp_from_u64(3), BitVec::make(pk.prm.m_bits)};
+    e.s.w[0] = 0x55;
+    z.E.push_back(e);
+    e.w = fp_neg(e.w);
+    z.E.push_back(e);
+    CipherSoA zs = to_soa(pk, z);
+    compact_edges(pk, z);
+    compact_edges(pk, zs);
+    assert(z.E.empty() && zs.empty());
+    std::cout << "cancellation: ok\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
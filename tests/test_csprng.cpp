@@ -0,0 +1,94 @@
+#include <pvac/core/random.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <vector>
+#include <thread>
+#include <iostream>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace pvac;
+
+int main() {
+    std::cout << "- csprng test -\n";
+
+    // buffered draws must not hit the os per call
+    csprng_stats_reset();
+    uint64_t os0 = g_os_entropy_calls.load();
+
+    const int N = 100000;
+    uint64_t ones = 0;
+    for (int i = 0; i < N; ++i) {
+        ones += (uint64_t)__builtin_popcountll(csprng_u64());
+    }
+
+    uint64_t os1 = g_os_entropy_calls.load();
+    CsprngStats st = csprng_stats();
+    assert(st.u64_draws == (uint64_t)N);
+    assert(os1 - os0 <= 2);
+    std::cout << "draws = " << N << " os calls = " << (os1 - os0)
+              << " refills = " << st.refills << "\n";
+
+    double bal = (double)ones / (64.0 * N);
+    assert(bal > 0.49 && bal < 0.51);
+    std::cout << "bit balance = " << bal << "\n";
+
+    // reseed from the os after RESEED_BYTES of output
+    uint64_t words = Drbg::RESEED_BYTES / 8 + Drbg::BUF_WORDS;
+    for (uint64_t i = 0; i < words; ++i) (void)csprng_u64();
+    assert(csprng_stats().reseeds >= 2);
+    std::cout << "reseed: ok\n";
+
+    // bulk path, odd sizes and buffer crossings
+    std::vector<uint8_t> a(10007), b(10007);
+    csprng_bytes(a.data(), a.size());
+    csprng_bytes(b.data(), b.size());
+    assert(std::memcmp(a.data(), b.data(), a.size()) != 0);
+    for (size_t n : {1u, 7u, 9u, 4095u, 4097u}) {
+        std::vector<uint8_t> z(n, 0);
+        csprng_bytes(z.data(), n);
+    }
+    std::cout << "bytes: ok\n";
+
+    // every thread owns its own stream
+    uint64_t t1 = 0, t2 = 0;
+    std::thread th1([&] { t1 = csprng_u64(); });
+    std::thread th2([&] { t2 = csprng_u64(); });
+    th1.join();
+    th2.join();
+    assert(t1 != t2);
+    std::cout << "threads: ok\n";
+
+    // parent and child must diverge after fork even with a warm buffer
+    (void)csprng_u64();
+    int fds[2];
+    assert(pipe(fds) == 0);
+
+    pid_t pid = fork();
+    assert(pid >= 0);
+
+    if (pid == 0) {
+        uint64_t x = csprng_u64();
+        ssize_t w = write(fds[1], &x, sizeof(x));
+        _exit(w == (ssize_t)sizeof(x) ? 0 : 1);
+    }
+
+    uint64_t mine = csprng_u64();
+    uint64_t child = 0;
+    ssize_t r = read(fds[0], &child, sizeof(child));
+    int status = 0;
+    waitpid(pid, &status, 0);
+    close(fds[0]);
+    close(fds[1]);
+
+    assert(r == (ssize_t)sizeof(child));
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(mine != child);
+    std::cout << "fork: ok\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include <pvac/pvac.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+
+int main() {
+    std::cout << "- dec values test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher a = enc_value(pk, sk, 5);
+    Cipher b = enc_value(pk, sk, 9);
+
+    // sums, products, scaled and repeated ciphers, and an empty one
+    std::vector<Cipher> cs{a, ct_add(pk, a, b), ct_mul(pk, a, b), ct_scale(pk, b, fp_from_u64(3))};
+    cs.push_back(ct_sub(pk, cs[2], cs[1]));
+    cs.push_back(Cipher{});
+    cs.push_back(a);
+    std::vector<uint64_t> want{5, 14, 45, 27, 31, 0, 5};
+
+    std::vector<Fp> v = dec_values(pk, sk, cs);
+    assert(v.size() == cs.size());
+    for (size_t i = 0; i < cs.size(); i++) {
+        assert(v[i].hi == 0 && v[i].lo == want[i]);
+        assert(ct::fp_eq(v[i], dec_value(pk, sk, cs[i])));
+    }
+    std::vector<Fp> serial = dec_values(pk, sk, cs, nullptr, nullptr);
+    for (size_t i = 0; i < cs.size(); i++) assert(ct::fp_eq(v[i], serial[i]));
+    std::cout << "matches dec_value: ok\n";
+
+    // a, b and every cipher built from them share two base seeds
+    RCache rc(64);
+    std::vector<Fp> w = dec_values(pk, sk, cs, &rc);
+    for (size_t i = 0; i < cs.size(); i++) assert(ct::fp_eq(v[i], w[i]));
+    assert(rc.misses() == a.L.size() + b.L.size());
+    std::cout << "seeds shared across the batch: ok\n";
+
+    assert(dec_values(pk, sk, std::vector<Cipher>{}).empty());
+
+    std::string msg = "batched decryption of a longer message, several blocks";
+    assert(dec_text(pk, sk, enc_text(pk, sk, msg)) == msg);
+    std::cout << "dec_text: ok\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
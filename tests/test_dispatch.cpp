@@ -0,0 +1,81 @@
+#include <pvac/pvac.hpp>
+
+#include <string>
+#include <cstdlib>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+
+static void test_spec() {
+    assert(impl_spec_lookup(nullptr, "aes") == "");
+    assert(impl_spec_lookup("", "aes") == "");
+    assert(impl_spec_lookup("scalar", "aes") == "scalar");
+    assert(impl_spec_lookup("scalar", "toeplitz") == "scalar");
+    assert(impl_spec_lookup("toeplitz=scalar,aes=x8", "aes") == "x8");
+    assert(impl_spec_lookup("toeplitz=scalar,aes=x8", "toeplitz") == "scalar");
+    assert(impl_spec_lookup("toeplitz=scalar,aes=x8", "bitvec") == "");
+    assert(impl_spec_lookup("aes:x1", "aes") == "x1");
+    assert(impl_spec_lookup("scalar,aes=vaes", "aes") == "vaes");
+    assert(impl_spec_lookup("scalar,aes=vaes", "bitvec") == "scalar");
+    assert(impl_spec_lookup("aesx=x1", "aes") == "");
+    std::cout << "spec parsing: ok\n";
+}
+
+static void test_pick() {
+    const char * names[3] = {"slow", "mid", "fast"};
+    bool ok[3] = {true, true, false};
+
+    if (std::getenv("PVAC_IMPL")) {
+        std::cout << "pick: skipped (PVAC_IMPL set)\n";
+        return;
+    }
+    assert(impl_pick("test.family", names, ok, 3, 1) == 1);
+    std::cout << "pick: ok\n";
+}
+
+static void test_report() {
+    std::string r = impl_report();
+    std::cout << r;
+
+    assert(r.find("cpu: ") == 0);
+    assert(r.find("toeplitz: ") != std::string::npos);
+    assert(r.find("aes: ") != std::string::npos);
+    assert(r.find("sha256: ") != std::string::npos);
+    assert(r.find("bitvec: ") != std::string::npos);
+    assert(r.find("fp: ") != std::string::npos);
+
+    // the pick is stable and one of the available ones
+    assert(toep_impl() == toep_impl());
+    assert(toep_impl_avail().find(toep_impl_name()) != std::string::npos);
+    assert(aes_impl_avail().find(aes_impl_name()) != std::string::npos);
+    assert(bv_impl_avail().find(bv_impl_name()) != std::string::npos);
+    assert(sha_impl_avail().find(sha_impl_name()) != std::string::npos);
+
+    const CpuFeatures & f = cpu_features();
+#if defined(__AES__)
+    assert(f.aes);
+#endif
+#if defined(__PCLMUL__)
+    assert(f.pclmul);
+#endif
+#if defined(__AVX2__)
+    assert(f.avx2);
+#endif
+#if defined(__AVX512F__)
+    assert(f.avx512f);
+#endif
+    (void)f;
+    std::cout << "report: ok\n";
+}
+
+int main() {
+    std::cout << "- dispatch test -\n";
+
+    test_spec();
+    test_pick();
+    test_report();
+
+    std::cout << "PASS\n";
+    return 0;
+}
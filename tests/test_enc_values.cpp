@@ -0,0 +1,54 @@
+#include <pvac/pvac.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+
+int main() {
+    std::cout << "- enc values test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    std::vector<uint64_t> v;
+    for (uint64_t i = 0; i < 24; i++) v.push_back(i * i * 1000003ull);
+    v.push_back(~0ull);
+
+    EncStats st;
+    std::vector<Cipher> cs = enc_values(pk, sk, v, 0, &default_pool(), &st);
+    assert(cs.size() == v.size());
+    std::vector<Fp> d = dec_values(pk, sk, cs);
+    for (size_t i = 0; i < v.size(); i++) {
+        assert(d[i].lo == v[i] && d[i].hi == 0);
+        assert(cs[i].L.size() == 2);
+    }
+    for (int s = 0; s < EncStats::N_STAGES; s++) assert(st.ns[s] > 0);
+    std::cout << "round trip: ok\n";
+
+    // serial, with noise for a deeper circuit
+    std::vector<Cipher> deep = enc_values(pk, sk, v.data(), 4, 3, nullptr);
+    Cipher p = ct_mul(pk, ct_mul(pk, deep[1], deep[2]), deep[3]);
+    Fp want = fp_mul(fp_mul(fp_from_u64(v[1]), fp_from_u64(v[2])), fp_from_u64(v[3]));
+    assert(ct::fp_eq(dec_value(pk, sk, p), want));
+    std::vector<Fp> dd = dec_values(pk, sk, deep);
+    for (size_t i = 0; i < 4; i++) assert(dd[i].lo == v[i]);
+    std::cout << "serial, depth 3: ok\n";
+
+    std::vector<Fp> f{fp_from_u64(7), fp_neg(fp_from_u64(1)), Fp{123, 456}};
+    std::vector<Cipher> fc = enc_fp_batch(pk, sk, f.data(), f.size());
+    for (size_t i = 0; i < f.size(); i++) {
+        assert(fc[i].L.size() == 1);
+        assert(ct::fp_eq(dec_value(pk, sk, fc[i]), f[i]));
+    }
+    std::cout << "fp batch: ok\n";
+
+    assert(enc_values(pk, sk, std::vector<uint64_t>{}).empty());
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <pvac/pvac.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+
+static bool eq(const Fp& a, const Fp& b) {
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+// random elements with the awkward ones mixed in: 0, 1, p - 1, 2^126,
+// all ones limbs
+static Fp pick(uint64_t r) {
+    switch (r % 8) {
+    case 0: return fp_from_u64(0);
+    case 1: return fp_from_u64(1);
+    case 2: return fp_neg(fp_from_u64(1));
+    case 3: return Fp{0, 1ull << 62};
+    case 4: return Fp{~0ull, MASK63 >> 1};
+    default: return rand_fp_nonzero();
+    }
+}
+
+static void check(FpImpl impl, size_t n) {
+    FpBatchOps ops = fp_batch_ops(impl);
+
+    std::vector<Fp> a(n), b(n), r(n);
+    std::vector<uint8_t> ch(n);
+    for (size_t i = 0; i < n; i++) {
+        a[i] = pick(csprng_u64());
+        b[i] = pick(csprng_u64());
+        ch[i] = csprng_u64() & 1;
+    }
+    Fp s = rand_fp_nonzero();
+
+    ops.mul_n(r.data(), a.data(), b.data(), n);
+    for (size_t i = 0; i < n; i++) assert(eq(r[i], fp_mul(a[i], b[i])));
+
+    ops.scale_n(r.data(), a.data(), s, n);
+    for (size_t i = 0; i < n; i++) assert(eq(r[i], fp_mul(a[i], s)));
+
+    ops.add_n(r.data(), a.data(), b.data(), n);
+    for (size_t i = 0; i < n; i++) assert(eq(r[i], fp_add(a[i], b[i])));
+
+    Fp want = fp_from_u64(0);
+    for (size_t i = 0; i < n; i++) {
+        Fp t = fp_mul(a[i], b[i]);
+        want = ch[i] == SGN_M ? fp_sub(want, t) : fp_add(want, t);
+    }
+    assert(eq(ops.dot_signed(a.data(), b.data(), ch.data(), n), want));
+
+    // in place
+    r = a;
+    ops.mul_n(r.data(), r.data(), b.data(), n);
+    for (size_t i = 0; i < n; i++) assert(eq(r[i], fp_mul(a[i], b[i])));
+}
+
+int main() {
+    std::cout << "- fp batch test -\n";
+
+    bool ok[3];
+    fp_detail::avail(ok);
+    for (int k = 0; k < 3; k++) {
+        if (!ok[k]) {
+            std::cout << fp_detail::NAMES[k] << ": not available\n";
+            continue;
+        }
+        for (size_t n : {0, 1, 3, 7, 8, 9, 15, 16, 31, 100, 1000, 20000}) check((FpImpl)k, n);
+        std::cout << fp_detail::NAMES[k] << ": ok\n";
+    }
+    std::cout << "fp: " << fp_impl_name() << "\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
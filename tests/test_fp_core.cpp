@@ -1,6 +1,7 @@
 #include <pvac/pvac.hpp>
 
 #include <cstdint>
+#include <vector>
 #include <cmath>
 #include <cassert>
 #include <iostream>
@@ -70,6 +71,42 @@ int main() {
     }
     std::cout << "inv: ok\n";
 
+    for (size_t n : {0, 1, 2, 3, 17, 1000}) {
+        std::vector<Fp> a(n);
+        for (auto& x : a) x = fp_rand_any();
+        std::vector<Fp> b = a;
+        fp_batch_inv(b);
+        for (size_t i = 0; i < n; ++i) assert(fp_eq(b[i], fp_inv(a[i])));
+    }
+    std::cout << "batch inv: ok\n";
+
+    // FpAcc against the reduced chain, including enough p - 1 terms to
+    // carry into the top word
+    for (int round = 0; round < 200; ++round) {
+        FpAcc acc;
+        Fp want = fp_zero();
+        int n = round < 100 ? round : 5000;
+        for (int i = 0; i < n; ++i) {
+            Fp a = round & 1 ? fp_neg(fp_one()) : fp_rand_any();
+            Fp b = fp_rand_any();
+            switch (i & 3) {
+            case 0: acc.add(a); want = fp_add(want, a); break;
+            case 1: acc.sub(a); want = fp_sub(want, a); break;
+            case 2: acc.mul_add(a, b); want = fp_add(want, fp_mul(a, b)); break;
+            default: acc.mul_sub(a, b); want = fp_sub(want, fp_mul(a, b)); break;
+            }
+        }
+        FpAcc two = acc;
+        two.add(acc);
+        assert(fp_eq(acc.get(), want));
+        assert(fp_eq(two.get(), fp_add(want, want)));
+    }
+    FpAcc big;
+    for (int i = 0; i < 100000; ++i) big.add(fp_neg(fp_one()));
+    assert(big.w2 != 0);
+    assert(fp_eq(big.get(), fp_neg(fp_from_u64(100000))));
+    std::cout << "lazy acc: ok\n";
+
     const u128 P = (((u128)1) << 127) - 1;
     const int N4 = 2000;
 
@@ -0,0 +1,124 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+static uint64_t dec_u64(const PubKey& pk, const SecKey& sk, const Cipher& C) {
+    Fp v = dec_value(pk, sk, C);
+    assert(v.hi == 0);
+    return v.lo;
+}
+
+static double ms(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+int main() {
+    std::cout << "- in place arithmetic test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher a = enc_value(pk, sk, 9);
+    Cipher b = enc_value(pk, sk, 4);
+    Fp k = fp_from_u64(5);
+
+    // in place forms give exactly what the copying ones give
+    Cipher x = a;
+    ct_add_inplace(pk, x, b);
+    assert(commit_ct(pk, x) == commit_ct(pk, ct_add(pk, a, b)));
+
+    x = a;
+    ct_sub_inplace(pk, x, b);
+    assert(commit_ct(pk, x) == commit_ct(pk, ct_add(pk, a, ct_neg(pk, b))));
+    assert(commit_ct(pk, x) == commit_ct(pk, ct_sub(pk, a, b)));
+    assert(dec_u64(pk, sk, x) == 5);
+
+    x = a;
+    ct_scale_inplace(pk, x, k);
+    assert(commit_ct(pk, x) == commit_ct(pk, ct_scale(pk, a, k)));
+    assert(dec_u64(pk, sk, x) == 45);
+
+    x = a;
+    ct_neg_inplace(pk, x);
+    assert(commit_ct(pk, x) == commit_ct(pk, ct_neg(pk, a)));
+    std::cout << "in place == copying: ok\n";
+
+    // rvalue forms steal storage: the edge array (and every sigma) of the
+    // moved operand ends up in the result
+    auto want_add = commit_ct(pk, ct_add(pk, a, b));
+    auto want_sub = commit_ct(pk, ct_sub(pk, a, b));
+
+    x = a;
+    const Edge* xe = x.E.data();
+    const uint64_t* xs = x.E[0].s.w.data();
+    Cipher r = ct_add(pk, std::move(x), b);
+    assert(commit_ct(pk, r) == want_add);
+    assert(r.E.data() == xe && r.E[0].s.w.data() == xs);
+
+    Cipher y = b;
+    const uint64_t* ys = y.E[0].s.w.data();
+    r = ct_add(pk, Cipher(a), std::move(y));
+    assert(commit_ct(pk, r) == want_add);
+    assert(r.E[a.E.size()].s.w.data() == ys);
+    assert(y.E.empty());
+
+    r = ct_sub(pk, Cipher(a), Cipher(b));
+    assert(commit_ct(pk, r) == want_sub);
+    r = ct_sub(pk, Cipher(a), b);
+    assert(commit_ct(pk, r) == want_sub);
+
+    x = a;
+    xs = x.E[0].s.w.data();
+    r = ct_scale(pk, std::move(x), k);
+    assert(commit_ct(pk, r) == commit_ct(pk, ct_scale(pk, a, k)));
+    assert(r.E[0].s.w.data() == xs);
+    std::cout << "rvalue overloads: ok\n";
+
+    // accumulate == chain of adds
+    std::vector<Cipher> terms;
+    uint64_t sum = 0;
+    for (uint64_t v = 1; v <= 30; v++) {
+        terms.push_back(v & 1 ? ct_scale(pk, a, fp_from_u64(v)) : ct_scale(pk, b, fp_from_u64(v)));
+        sum += v * (v & 1 ? 9 : 4);
+    }
+
+    auto t0 = Clock::now();
+    Cipher chain = terms[0];
+    for (size_t i = 1; i < terms.size(); i++) chain = ct_add(pk, chain, terms[i]);
+    auto t1 = Clock::now();
+    Cipher inpl = terms[0];
+    for (size_t i = 1; i < terms.size(); i++) ct_add_inplace(pk, inpl, terms[i]);
+    auto t2 = Clock::now();
+    Cipher acc = ct_accumulate(pk, terms);
+    auto t3 = Clock::now();
+
+    assert(commit_ct(pk, acc) == commit_ct(pk, chain));
+    assert(commit_ct(pk, inpl) == commit_ct(pk, chain));
+    assert(dec_u64(pk, sk, acc) == sum);
+    std::cout << "accumulate: ok\n";
+    std::cout << "30 term sum (" << acc.E.size() << " edges): chained ct_add " << ms(t0, t1)
+              << " ms, ct_add_inplace " << ms(t1, t2) << " ms, ct_accumulate " << ms(t2, t3) << " ms\n";
+
+    // same forms over the slab layout
+    CipherSoA sa = to_soa(pk, a), sb = to_soa(pk, b);
+    CipherSoA sx = sa;
+    ct_sub_inplace(pk, sx, sb);
+    assert(commit_ct(pk, sx) == want_sub);
+    sx = sa;
+    ct_add_inplace(pk, sx, sb);
+    assert(commit_ct(pk, sx) == want_add);
+    assert(commit_ct(pk, ct_sub(pk, CipherSoA(sa), sb)) == want_sub);
+    std::cout << "soa in place: ok\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include <pvac/pvac.hpp>
+
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// the original loop form of keccak-f[1600], kept here as the reference
+static void keccakf_ref(uint64_t st[25]) {
+    static const int ROT[5][5] = {
+        {  0, 36,  3, 41, 18 },
+        {  1, 44, 10, 45,  2 },
+        { 62,  6, 43, 15, 61 },
+        { 28, 55, 25, 21, 56 },
+        { 27, 20, 39,  8, 14 }
+    };
+    auto rotl = [](uint64_t x, int r) { return r ? (x << r) | (x >> (64 - r)) : x; };
+
+    for (int round = 0; round < 24; ++round) {
+        uint64_t C[5], D[5], B[25];
+        for (int x = 0; x < 5; x++) C[x] = st[x] ^ st[x + 5] ^ st[x + 10] ^ st[x + 15] ^ st[x + 20];
+        for (int x = 0; x < 5; x++) D[x] = C[(x + 4) % 5] ^ rotl(C[(x + 1) % 5], 1);
+        for (int x = 0; x < 5; x++)
+            for (int y = 0; y < 5; y++) st[x + 5 * y] ^= D[x];
+        for (int x = 0; x < 5; x++)
+            for (int y = 0; y < 5; y++) B[y + 5 * ((2 * x + 3 * y) % 5)] = rotl(st[x + 5 * y], ROT[x][y]);
+        for (int x = 0; x < 5; x++)
+            for (int y = 0; y < 5; y++)
+                st[x + 5 * y] = B[x + 5 * y] ^ ((~B[(x + 1) % 5 + 5 * y]) & B[(x + 2) % 5 + 5 * y]);
+        st[0] ^= keccak_detail::RC[round];
+    }
+}
+
+// byte at a time shake256 over the reference permutation
+static std::vector<uint8_t> shake_ref(const std::vector<uint8_t>& m, size_t outlen) {
+    const size_t rate = 136;
+    std::vector<uint8_t> p = m;
+    p.push_back(0x1F);
+    while (p.size() % rate) p.push_back(0);
+    p.back() ^= 0x80;
+
+    uint64_t st[25] = {0};
+    for (size_t b = 0; b < p.size(); b += rate) {
+        for (size_t i = 0; i < rate; i++) st[i / 8] ^= (uint64_t)p[b + i] << (8 * (i % 8));
+        keccakf_ref(st);
+    }
+
+    std::vector<uint8_t> out;
+    for (;;) {
+        for (size_t i = 0; i < rate; i++) {
+            out.push_back((uint8_t)(st[i / 8] >> (8 * (i % 8))));
+            if (out.size() == outlen) return out;
+        }
+        keccakf_ref(st);
+    }
+}
+
+static std::vector<uint8_t> shake(const std::vector<uint8_t>& m, size_t outlen, size_t step) {
+    Shake256 s;
+    s.init();
+    for (size_t i = 0; i < m.size(); i += step) s.absorb(m.data() + i, std::min(step, m.size() - i));
+    std::vector<uint8_t> out(outlen);
+    for (size_t i = 0; i < outlen; i += step) s.squeeze(out.data() + i, std::min(step, outlen - i));
+    return out;
+}
+
+static void test_kat() {
+    auto h = shake({}, 32, 1);
+    assert(hex8(h.data(), 32) == "46b9dd2b0ba88d13233b3feb743eeb243fcd52ea62b81b82b50c27646ed5762f");
+
+    auto a = shake({'a', 'b', 'c'}, 32, 3);
+    assert(hex8(a.data(), 32) == "483366601360a8771c6863080cc4114d8db44530f8f1e1ee4f94ea37e78b5739");
+
+    std::cout << "shake256 kat: ok\n";
+}
+
+static void test_permutation(std::mt19937_64& rng) {
+    for (int it = 0; it < 100; it++) {
+        uint64_t a[25], b[25];
+        for (int i = 0; i < 25; i++) a[i] = b[i] = rng();
+        keccakf1600(a);
+        keccakf_ref(b);
+        assert(std::memcmp(a, b, sizeof a) == 0);
+    }
+
+#if defined(__AVX2__)
+    for (int it = 0; it < 50; it++) {
+        uint64_t s[4][25];
+        __m256i v[25];
+        for (int j = 0; j < 4; j++)
+            for (int i = 0; i < 25; i++) s[j][i] = rng();
+        for (int i = 0; i < 25; i++) v[i] = _mm256_set_epi64x((long long)s[3][i], (long long)s[2][i], (long long)s[1][i], (long long)s[0][i]);
+
+        keccakf1600_x4(v);
+        for (int j = 0; j < 4; j++) keccakf_ref(s[j]);
+
+        for (int i = 0; i < 25; i++) {
+            alignas(32) uint64_t l[4];
+            _mm256_store_si256((__m256i*)l, v[i]);
+            for (int j = 0; j < 4; j++) assert(l[j] == s[j][i]);
+        }
+    }
+#endif
+    std::cout << "keccak-f unrolled / x4 == reference: ok\n";
+}
+
+static void test_sponge(std::mt19937_64& rng) {
+    for (size_t len : {0, 1, 7, 8, 135, 136, 137, 272, 300}) {
+        std::vector<uint8_t> m(len);
+        for (auto& x : m) x = (uint8_t)rng();
+        auto want = shake_ref(m, 500);
+        for (size_t step : {1, 5, 8, 64, 1000}) assert(shake(m, 500, step) == want);
+    }
+    std::cout << "word-wise absorb / squeeze: ok\n";
+}
+
+static void test_xof4(std::mt19937_64& rng) {
+    for (size_t n : {0, 1, 4, 16, 17, 40}) {
+        std::vector<uint64_t> seeds[4];
+        for (auto& s : seeds) {
+            s.resize(n);
+            for (auto& w : s) w = rng();
+        }
+
+        const std::string label = "pvac.test.xof4";
+        XofShake4 x4;
+        x4.init(label, seeds);
+
+        XofShake x1[4];
+        for (int j = 0; j < 4; j++) x1[j].init(label, seeds[j]);
+
+        for (int k = 0; k < 100; k++) {
+            uint64_t o[4];
+            x4.take_u64(o);
+            for (int j = 0; j < 4; j++) assert(o[j] == x1[j].take_u64());
+        }
+    }
+    std::cout << "xof4 (" << keccak4_impl_name() << ") == 4 x xof: ok\n";
+}
+
+static void bench() {
+    uint64_t a[25] = {1};
+    auto time_ns = [](auto fn, int reps) {
+        fn();
+        auto t0 = Clock::now();
+        for (int i = 0; i < reps; i++) fn();
+        return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / reps;
+    };
+
+    double r = time_ns([&] { keccakf_ref(a); }, 20000);
+    double u = time_ns([&] { keccakf1600(a); }, 20000);
+    std::cout << "keccak-f: loop " << r << " ns, unrolled " << u << " ns";
+
+#if defined(__AVX2__)
+    __m256i v[25];
+    for (auto& x : v) x = _mm256_set1_epi64x((long long)a[0]);
+    double w = time_ns([&] { keccakf1600_x4(v); }, 20000);
+    std::cout << ", x4 " << w / 4 << " ns per state";
+#endif
+    std::cout << "\n";
+
+    std::vector<uint64_t> seeds[4] = {{1, 2}, {3, 4}, {5, 6}, {7, 8}};
+    uint64_t o[4], sink = 0;
+    const int W = 1 << 16;
+    double one = time_ns([&] {
+        XofShake x;
+        x.init("bench", seeds[0]);
+        for (int i = 0; i < W; i++) sink ^= x.take_u64();
+    }, 5) / W;
+    double four = time_ns([&] {
+        XofShake4 x;
+        x.init("bench", seeds);
+        for (int i = 0; i < W; i++) { x.take_u64(o); sink ^= o[0] ^ o[3]; }
+    }, 5) / (4.0 * W);
+    std::cout << "xof words: one stream " << one << " ns, xof4 " << four << " ns per word\n";
+
+    volatile uint64_t v2 = sink ^ a[0];
+    (void)v2;
+}
+
+int main() {
+    std::cout << "- keccak test -\n";
+
+    std::mt19937_64 rng(0x4ecca4ull);
+
+    test_kat();
+    test_permutation(rng);
+    test_sponge(rng);
+    test_xof4(rng);
+    bench();
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+#include <sys/resource.h>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+static Layer base_layer(uint64_t i) {
+    return Layer{RRule::BASE, RSeed{i * 7919, Nonce128{i, ~i}}, 0, 0};
+}
+
+static Layer prod_layer(uint32_t a, uint32_t b) {
+    return Layer{RRule::PROD, RSeed{}, a, b};
+}
+
+// the per-layer walk, one layer at a time
+static std::vector<Fp> layers_R_ref(const PubKey& pk, const SecKey& sk, const std::vector<Layer>& Ls) {
+    std::vector<int> vis(Ls.size(), 0);
+    std::vector<Fp> cache(Ls.size(), fp_from_u64(0));
+    std::vector<Fp> R(Ls.size());
+    for (uint32_t x = 0; x < (uint32_t)Ls.size(); x++) R[x] = layer_R_cached(pk, sk, Ls, x, vis, cache);
+    return R;
+}
+
+static bool same(const std::vector<Fp>& a, const std::vector<Fp>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!ct::fp_eq(a[i], b[i])) return false;
+    }
+    return true;
+}
+
+static double ms(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+static double cpu_ms(int who) {
+    rusage r;
+    getrusage(who, &r);
+    return (r.ru_utime.tv_sec + r.ru_stime.tv_sec) * 1e3 + (r.ru_utime.tv_usec + r.ru_stime.tv_usec) / 1e3;
+}
+
+int main() {
+    std::cout << "- layers R test -\n";
+
+    // a few workers even on one core, so the default pool has someone to hand work to
+    g_threads = std::max(g_threads, 4);
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    // random dag with parents anywhere in the list, repeated seeds
+    std::mt19937_64 rng(3);
+    std::vector<Layer> Ls;
+    for (uint64_t i = 0; i < 12; i++) Ls.push_back(base_layer(i % 8));
+    for (uint32_t i = 0; i < 300; i++) {
+        uint32_t n = (uint32_t)Ls.size();
+        Ls.push_back(prod_layer((uint32_t)(rng() % n), (uint32_t)(rng() % n)));
+    }
+    std::vector<uint32_t> perm(Ls.size()), pos(Ls.size());
+    for (uint32_t i = 0; i < perm.size(); i++) perm[i] = i;
+    std::shuffle(perm.begin(), perm.end(), rng);
+    for (uint32_t i = 0; i < perm.size(); i++) pos[perm[i]] = i;
+    std::vector<Layer> Sh(Ls.size());
+    for (uint32_t i = 0; i < Ls.size(); i++) {
+        Layer L = Ls[i];
+        if (L.rule == RRule::PROD) {
+            L.pa = pos[L.pa];
+            L.pb = pos[L.pb];
+        }
+        Sh[pos[i]] = L;
+    }
+
+    std::vector<Fp> want = layers_R_ref(pk, sk, Sh);
+    assert(same(layers_R(pk, sk, Sh), want));
+    assert(same(layers_R(pk, sk, Sh, nullptr, nullptr), want));
+
+    RCache rc(64);
+    assert(same(layers_R(pk, sk, Sh, &rc), want));
+    assert(rc.misses() == 8 && rc.size() == 8);
+    assert(same(layers_R(pk, sk, Sh, &rc), want));
+    assert(rc.misses() == 8 && rc.hits() == 8);
+
+    std::vector<Fp> inv = layers_R_inv(pk, sk, Sh);
+    for (size_t i = 0; i < inv.size(); i++) assert(ct::fp_is_one(fp_mul(inv[i], want[i])));
+    std::cout << "shuffled dag: ok\n";
+
+    // a product chain far deeper than any call stack would take
+    std::vector<Layer> deep{base_layer(1), base_layer(2)};
+    for (uint32_t i = 2; i < 300000; i++) deep.push_back(prod_layer(i - 1, i & 1));
+    std::reverse(deep.begin(), deep.end());
+    uint32_t n = (uint32_t)deep.size();
+    for (auto& L : deep) {
+        if (L.rule == RRule::PROD) {
+            L.pa = n - 1 - L.pa;
+            L.pb = n - 1 - L.pb;
+        }
+    }
+    std::vector<Fp> R = layers_R(pk, sk, deep);
+    Fp r1 = R[n - 1], r2 = R[n - 2], x = r2;
+    for (uint32_t i = 2; i < n; i++) x = fp_mul(x, i & 1 ? r2 : r1);
+    assert(ct::fp_eq(R[0], x));
+    assert(same(layers_R_ref(pk, sk, deep), R));
+    std::cout << "deep chain: ok\n";
+
+    // ciphertexts, against dec through the old path
+    Cipher a = enc_value(pk, sk, 6);
+    Cipher b = enc_value(pk, sk, 7);
+    Cipher c = ct_mul(pk, ct_add(pk, a, b), ct_mul(pk, a, b));
+    assert(same(layers_R(pk, sk, c.L), layers_R_ref(pk, sk, c.L)));
+    assert(dec_value(pk, sk, c).lo == 13 * 42);
+    std::cout << "cipher layers: ok\n";
+
+    // one cipher, no pool argument: its base layers go to default_pool(),
+    // so some of the cpu time is spent outside this thread
+    Cipher m = enc_value(pk, sk, 1);
+    for (uint64_t i = 2; i <= 16; i++) m = ct_add(pk, m, enc_value(pk, sk, i));
+    double self0 = cpu_ms(RUSAGE_SELF), th0 = cpu_ms(RUSAGE_THREAD);
+    Fp v = dec_value(pk, sk, m);
+    double self1 = cpu_ms(RUSAGE_SELF), th1 = cpu_ms(RUSAGE_THREAD);
+    assert(v.lo == 136 && v.hi == 0);
+    assert(ct::fp_eq(v, dec_value(pk, sk, m, nullptr, nullptr)));
+    double off = (self1 - self0) - (th1 - th0);
+    std::cout << "dec of " << m.L.size() << " layers: " << (th1 - th0) << " ms here, " << off << " ms on "
+              << default_pool().size() - 1 << " workers\n";
+    assert(off > 0.2 * (th1 - th0));
+    std::cout << "dec_value default pool: ok\n";
+
+    // base layers one after another vs over the pool
+    std::vector<Layer> wide;
+    for (uint64_t i = 0; i < 32; i++) wide.push_back(base_layer(100 + i));
+    for (uint32_t i = 0; i < 32; i++) wide.push_back(prod_layer(i, (i + 1) % 32));
+    auto t0 = Clock::now();
+    std::vector<Fp> w0 = layers_R(pk, sk, wide, nullptr, nullptr);
+    auto t1 = Clock::now();
+    std::vector<Fp> w1 = layers_R(pk, sk, wide);
+    auto t2 = Clock::now();
+    assert(same(w0, w1));
+    std::cout << "32 base layers: serial " << ms(t0, t1) << " ms, pool of " << default_pool().size()
+              << " " << ms(t1, t2) << " ms\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
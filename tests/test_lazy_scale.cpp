@@ -0,0 +1,117 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+static uint64_t dec_u64(const PubKey& pk, const SecKey& sk, const Cipher& C) {
+    Fp v = dec_value(pk, sk, C);
+    assert(v.hi == 0);
+    return v.lo;
+}
+
+static double us(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::micro>(b - a).count();
+}
+
+// the old behaviour: every weight multiplied on the spot
+static Cipher scale_eager(const Cipher& A, const Fp& s) {
+    Cipher C = A;
+    for (auto& e : C.E) e.w = fp_mul(e.w, s);
+    return C;
+}
+
+static bool all_k_one(const std::vector<Layer>& Ls) {
+    for (const auto& L : Ls) {
+        if (!layer_k_is_one(L)) return false;
+    }
+    return true;
+}
+
+int main() {
+    std::cout << "- lazy scale test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher a = enc_value(pk, sk, 9);
+    Cipher b = enc_value(pk, sk, 4);
+    Fp three = fp_from_u64(3), five = fp_from_u64(5);
+
+    // lazy scale only touches layers but reads back like the eager one
+    Cipher x = ct_scale(pk, a, three);
+    assert(!all_k_one(x.L));
+    for (size_t i = 0; i < a.E.size(); i++) assert(ct::fp_eq(x.E[i].w, a.E[i].w));
+    assert(commit_ct(pk, x) == commit_ct(pk, scale_eager(a, three)));
+    assert(dec_u64(pk, sk, x) == 27);
+
+    Cipher y = x;
+    ct_normalize(y);
+    assert(all_k_one(y.L));
+    assert(commit_ct(pk, y) == commit_ct(pk, x));
+    assert(dec_u64(pk, sk, y) == 27);
+    std::cout << "scale / normalize: ok\n";
+
+    // stacked factors through add, sub, neg, div and compact
+    Cipher z = ct_sub(pk, ct_scale(pk, a, five), ct_scale(pk, b, three));
+    assert(dec_u64(pk, sk, z) == 45 - 12);
+    z = ct_add(pk, ct_neg(pk, z), ct_scale(pk, a, fp_from_u64(4)));
+    assert(dec_u64(pk, sk, z) == 36 - 33);
+    z = ct_div_const(pk, ct_scale(pk, z, fp_from_u64(14)), fp_from_u64(7));
+    assert(dec_u64(pk, sk, z) == 6);
+
+    compact_edges(pk, z);
+    assert(dec_u64(pk, sk, z) == 6);
+    Cipher zn = z;
+    ct_normalize(zn);
+    assert(commit_ct(pk, zn) == commit_ct(pk, z));
+    std::cout << "add / sub / div / compact: ok\n";
+
+    // products take k_a * k_b on the new layer
+    Cipher p = ct_mul(pk, ct_scale(pk, a, three), ct_scale(pk, b, five));
+    assert(dec_u64(pk, sk, p) == 9 * 4 * 15);
+    Cipher q = ct_mul(pk, ct_sub(pk, a, b), ct_neg(pk, b));
+    assert(ct::fp_eq(dec_value(pk, sk, q), fp_neg(fp_from_u64(20))));
+    std::cout << "mul: ok\n";
+
+    // slab layout carries the same factors
+    CipherSoA sx = to_soa(pk, a);
+    ct_scale_inplace(pk, sx, three);
+    assert(commit_ct(pk, sx) == commit_ct(pk, x));
+    assert(ct::fp_eq(dec_value(pk, sk, sx), fp_from_u64(27)));
+    ct_normalize(sx);
+    assert(all_k_one(sx.L));
+    assert(commit_ct(pk, sx) == commit_ct(pk, x));
+    assert(commit_ct(pk, from_soa(sx)) == commit_ct(pk, x));
+    std::cout << "soa: ok\n";
+
+    // cost of a scale on a wide cipher, copy excluded
+    std::vector<Cipher> terms;
+    for (int i = 0; i < 40; i++) terms.push_back(i & 1 ? a : b);
+    Cipher big = ct_accumulate(pk, terms);
+
+    const int reps = 200;
+    Cipher w1 = big, w2 = big;
+    auto t0 = Clock::now();
+    for (int i = 0; i < reps; i++) ct_scale_inplace(pk, w1, three);
+    auto t1 = Clock::now();
+    for (int i = 0; i < reps; i++) {
+        for (auto& e : w2.E) e.w = fp_mul(e.w, three);
+    }
+    auto t2 = Clock::now();
+    ct_normalize(w1);
+    assert(commit_ct(pk, w1) == commit_ct(pk, w2));
+
+    std::cout << "scale of " << big.E.size() << " edges / " << big.L.size() << " layers: lazy "
+              << us(t0, t1) / reps << " us, eager " << us(t1, t2) / reps << " us\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
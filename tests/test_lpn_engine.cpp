@@ -0,0 +1,170 @@
+#include <pvac/pvac.hpp>
+
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// only what derive_aes_key and the lpn sweep read, no gen_H needed
+static void make_keys(int n, int t, int num, int den, int ver, std::mt19937_64& rng,
+                      PubKey& pk, SecKey& sk) {
+    pk.prm.lpn_n = n;
+    pk.prm.lpn_t = t;
+    pk.prm.lpn_tau_num = num;
+    pk.prm.lpn_tau_den = den;
+    pk.prm.lpn_ver = ver;
+    pk.canon_tag = rng();
+    for (auto& b : pk.H_digest) b = (uint8_t)rng();
+
+    for (auto& k : sk.prf_k) k = rng();
+    sk.lpn_s_bits.assign(((size_t)n + 63) / 64, 0);
+    for (auto& w : sk.lpn_s_bits) w = rng();
+    if (n & 63) sk.lpn_s_bits.back() &= (1ull << (n & 63)) - 1;
+}
+
+static RSeed make_seed(std::mt19937_64& rng) {
+    RSeed s;
+    s.ztag = rng();
+    s.nonce.lo = rng();
+    s.nonce.hi = rng();
+    return s;
+}
+
+static void test_kernels(std::mt19937_64& rng) {
+    for (size_t words = 1; words <= 70; words++) {
+        std::vector<uint64_t> s(words), a(8 * words);
+        for (auto& x : s) x = rng();
+        for (auto& x : a) x = rng();
+
+        const uint64_t* rows[8];
+        for (int j = 0; j < 8; j++) rows[j] = a.data() + j * words;
+
+        for (int nr = 1; nr <= 8; nr++) {
+            uint64_t want = lpn_dot_rows_scalar(rows, nr, s.data(), words);
+            assert(lpn_dot_rows(rows, nr, s.data(), words) == want);
+#if defined(__AVX2__)
+            assert(lpn_dot_rows_avx2(rows, nr, s.data(), words) == want);
+#endif
+#if defined(__AVX512F__)
+            assert(lpn_dot_rows_avx512(rows, nr, s.data(), words) == want);
+#endif
+        }
+    }
+    std::cout << "dot kernels: ok\n";
+}
+
+static void test_v1_matches_ref(std::mt19937_64& rng) {
+    struct Cfg { int n, t, num, den; };
+    const Cfg cfgs[] = {
+        {4096, 16384, 1, 8},
+        {4000, 1001, 1, 8},
+        {100, 77, 3, 8},
+        {64, 130, 1, 6},
+        {130, 200, 1, 1},
+        {4096, 300, 0, 8},
+    };
+
+    for (const auto& c : cfgs) {
+        PubKey pk;
+        SecKey sk;
+        make_keys(c.n, c.t, c.num, c.den, 1, rng, pk, sk);
+
+        for (int i = 0; i < 3; i++) {
+            RSeed seed = make_seed(rng);
+            std::vector<uint64_t> a, b;
+            lpn_make_ybits_ref(pk, sk, seed, Dom::PRF_R1, a);
+            lpn_make_ybits(pk, sk, seed, Dom::PRF_R1, b);
+            assert(a == b);
+        }
+    }
+    std::cout << "v1 bit identical to row walk: ok\n";
+}
+
+static void test_v2(std::mt19937_64& rng) {
+    PubKey pk;
+    SecKey sk;
+    make_keys(4096, 16384, 1, 8, 2, rng, pk, sk);
+    RSeed seed = make_seed(rng);
+
+    std::vector<uint64_t> a, b, c;
+    lpn_make_ybits(pk, sk, seed, Dom::PRF_R1, a);
+    lpn_make_ybits(pk, sk, seed, Dom::PRF_R1, b);
+    assert(a == b);
+
+    lpn_make_ybits(pk, sk, seed, Dom::PRF_R2, c);
+    assert(a != c);
+
+    pk.prm.lpn_ver = 1;
+    lpn_make_ybits(pk, sk, seed, Dom::PRF_R1, c);
+    assert(a != c);
+    pk.prm.lpn_ver = 2;
+
+    // zero secret leaves y = e, the error rate has to sit near tau
+    const int T = 16384 * 8;
+    pk.prm.lpn_t = 16384;
+    std::fill(sk.lpn_s_bits.begin(), sk.lpn_s_bits.end(), 0);
+    size_t ones = 0;
+    for (int i = 0; i < T / 16384; i++) {
+        lpn_make_ybits(pk, sk, make_seed(rng), Dom::PRF_R1, a);
+        for (uint64_t w : a) ones += (size_t)__builtin_popcountll(w);
+    }
+    double rate = (double)ones / T;
+    assert(rate > 0.12 && rate < 0.13);
+
+    pk.prm.lpn_tau_num = 3;
+    ones = 0;
+    for (int i = 0; i < T / 16384; i++) {
+        lpn_make_ybits(pk, sk, make_seed(rng), Dom::PRF_R1, a);
+        for (uint64_t w : a) ones += (size_t)__builtin_popcountll(w);
+    }
+    rate = (double)ones / T;
+    assert(rate > 0.37 && rate < 0.38);
+
+    // bits past t stay clear
+    pk.prm.lpn_tau_num = 1;
+    pk.prm.lpn_t = 100;
+    lpn_make_ybits(pk, sk, seed, Dom::PRF_R1, a);
+    assert(a.size() == 2 && (a[1] >> 36) == 0);
+
+    std::cout << "v2 determinism / error rate: ok\n";
+}
+
+static void bench(std::mt19937_64& rng) {
+    PubKey pk;
+    SecKey sk;
+    make_keys(4096, 16384, 1, 8, 1, rng, pk, sk);
+    RSeed seed = make_seed(rng);
+    std::vector<uint64_t> y;
+
+    const int R = 20;
+    auto run = [&](const char* name, auto fn) {
+        fn();
+        auto t0 = Clock::now();
+        for (int i = 0; i < R; i++) fn();
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / R;
+        std::cout << name << us << " us\n";
+    };
+
+    run("ref: ", [&] { lpn_make_ybits_ref(pk, sk, seed, Dom::PRF_R1, y); });
+    run("v1:  ", [&] { lpn_make_ybits_v1(pk, sk, seed, Dom::PRF_R1, y); });
+    run("v2:  ", [&] { lpn_make_ybits_v2(pk, sk, seed, Dom::PRF_R1, y); });
+}
+
+int main() {
+    std::cout << "- lpn engine test -\n";
+
+    std::mt19937_64 rng(0x1f2e3d4c5b6a7988ull);
+
+    test_kernels(rng);
+    test_v1_matches_ref(rng);
+    test_v2(rng);
+    bench(rng);
+
+    std::cout << "PASS\n";
+    return 0;
+}
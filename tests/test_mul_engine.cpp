@@ -0,0 +1,208 @@
+#include <pvac/pvac.hpp>
+
+#include <map>
+#include <tuple>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+#include <unordered_map>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+// the hash map accumulation ct_mul used before the bucket engine
+static std::vector<EdgeMeta> mul_terms_ref(int Bmod, const std::vector<EdgeMeta>& A,
+                                           const std::vector<EdgeMeta>& B, uint32_t LB, uint32_t base) {
+    struct Agg { Fp wp{}, wm{}; bool ip = false, im = false; };
+    std::unordered_map<uint64_t, Agg> acc;
+
+    for (const auto& ea : A) {
+        for (const auto& eb : B) {
+            uint64_t k = ((uint64_t)(ea.layer_id * LB + eb.layer_id) << 32) | ((ea.idx + eb.idx) % Bmod);
+            Agg& a = acc[k];
+            Fp ww = fp_mul(ea.w, eb.w);
+            if (ea.ch == eb.ch) {
+                if (!a.ip) { a.wp = fp_from_u64(0); a.ip = true; }
+                a.wp = fp_add(a.wp, ww);
+            } else {
+                if (!a.im) { a.wm = fp_from_u64(0); a.im = true; }
+                a.wm = fp_add(a.wm, ww);
+            }
+        }
+    }
+
+    std::vector<EdgeMeta> out;
+    for (const auto& [k, a] : acc) {
+        uint32_t lid = base + (uint32_t)(k >> 32);
+        uint16_t idx = (uint16_t)(k & 0xFFFF);
+        if (a.ip && ct::fp_is_nonzero(a.wp)) out.push_back(EdgeMeta{lid, idx, SGN_P, a.wp});
+        if (a.im && ct::fp_is_nonzero(a.wm)) out.push_back(EdgeMeta{lid, idx, SGN_M, a.wm});
+    }
+    return out;
+}
+
+using Key = std::tuple<uint32_t, uint16_t, uint8_t>;
+
+static std::map<Key, Fp> as_map(const std::vector<EdgeMeta>& v) {
+    std::map<Key, Fp> m;
+    for (const auto& e : v) {
+        auto r = m.emplace(Key{e.layer_id, e.idx, e.ch}, e.w);
+        assert(r.second);
+    }
+    return m;
+}
+
+static bool same_terms(const std::vector<EdgeMeta>& a, const std::vector<EdgeMeta>& b) {
+    auto ma = as_map(a), mb = as_map(b);
+    if (ma.size() != mb.size()) return false;
+    for (const auto& [k, w] : ma) {
+        auto it = mb.find(k);
+        if (it == mb.end() || !ct::fp_eq(it->second, w)) return false;
+    }
+    return true;
+}
+
+static Fp rand_fp(std::mt19937_64& rng) {
+    return fp_from_words(rng(), rng() & MASK63);
+}
+
+// n edges over `layers` layers; small weights from a few values so some
+// slots cancel to zero
+static std::vector<EdgeMeta> rand_edges(std::mt19937_64& rng, int B, uint32_t layers, size_t n, bool small) {
+    std::vector<EdgeMeta> E;
+    for (size_t i = 0; i < n; i++) {
+        EdgeMeta e;
+        e.layer_id = (uint32_t)(rng() % layers);
+        e.idx = (uint16_t)(rng() % B);
+        e.ch = (uint8_t)(rng() & 1);
+        e.w = small ? fp_from_u64(rng() % 3) : rand_fp(rng);
+        if (small && (rng() & 1)) e.w = fp_neg(e.w);
+        E.push_back(e);
+    }
+    return E;
+}
+
+static void test_poly(std::mt19937_64& rng) {
+    for (size_t n : {1, 2, 31, 32, 33, 64, 100, 337}) {
+        std::vector<Fp> a(n), b(n), r(2 * n - 1), want(2 * n - 1, fp_from_u64(0));
+        for (auto& x : a) x = rand_fp(rng);
+        for (auto& x : b) x = rand_fp(rng);
+
+        for (size_t i = 0; i < n; i++)
+            for (size_t j = 0; j < n; j++) want[i + j] = fp_add(want[i + j], fp_mul(a[i], b[j]));
+
+        fp_poly_mul(a.data(), b.data(), n, r.data());
+        for (size_t i = 0; i < r.size(); i++) assert(ct::fp_eq(r[i], want[i]));
+    }
+    std::cout << "karatsuba == schoolbook: ok\n";
+}
+
+static void test_terms(std::mt19937_64& rng, const PubKey& pk) {
+    int B = pk.prm.B;
+    struct Case { uint32_t la, lb; size_t na, nb; bool small; };
+    const Case cases[] = {
+        {1, 1, 1, 1, false},
+        {2, 2, 40, 40, false},
+        {3, 2, 200, 7, true},
+        {2, 3, 900, 900, false},
+        {2, 2, 1500, 1500, true},
+        {4, 1, 3000, 40, false},
+    };
+
+    for (const auto& c : cases) {
+        auto A = rand_edges(rng, B, c.la, c.na, c.small);
+        auto Bv = rand_edges(rng, B, c.lb, c.nb, c.small);
+        uint32_t base = c.la + c.lb;
+
+        auto got = ct_mul_terms(pk, A, c.la, Bv, c.lb, base);
+        assert(same_terms(got, mul_terms_ref(B, A, Bv, c.lb, base)));
+    }
+    std::cout << "bucket engine == hash map: ok\n";
+}
+
+// the chunked grid has to give the serial answer, in the same order
+static void test_pool(std::mt19937_64& rng, const PubKey& pk) {
+    int B = pk.prm.B;
+    auto A = rand_edges(rng, B, 5, 600, false);
+    auto Bv = rand_edges(rng, B, 3, 2000, true);
+    auto want = ct_mul_terms(pk, A, 5, Bv, 3, 8);
+
+    for (int nt : {1, 2, 4, 7}) {
+        ThreadPool pool(nt);
+        auto got = ct_mul_terms(pk, A, 5, Bv, 3, 8, &pool);
+        assert(got.size() == want.size());
+        for (size_t i = 0; i < got.size(); i++) {
+            assert(got[i].layer_id == want[i].layer_id && got[i].idx == want[i].idx);
+            assert(got[i].ch == want[i].ch && ct::fp_eq(got[i].w, want[i].w));
+        }
+    }
+    std::cout << "pooled terms == serial: ok\n";
+}
+
+static void test_ct_mul_threads() {
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    Cipher a = enc_value(pk, sk, 6);
+    Cipher b = enc_value(pk, sk, 7);
+    Cipher want = ct_mul(pk, a, b, nullptr);
+    auto wm = ct_edge_meta(want);
+
+    for (int nt : {2, 4}) {
+        ThreadPool pool(nt);
+        Cipher c = ct_mul(pk, a, b, &pool);
+        Fp v = dec_value(pk, sk, c);
+        assert(v.lo == 42 && v.hi == 0);
+
+        auto cm = ct_edge_meta(c);
+        assert(cm.size() == wm.size());
+        for (size_t i = 0; i < cm.size(); i++) {
+            assert(cm[i].layer_id == wm[i].layer_id && cm[i].idx == wm[i].idx && cm[i].ch == wm[i].ch);
+            assert(c.E[i].s.popcnt() > 0);
+        }
+
+        CipherSoA sc = ct_mul(pk, to_soa(pk, a), to_soa(pk, b), &pool);
+        v = dec_value(pk, sk, sc);
+        assert(v.lo == 42 && v.hi == 0);
+    }
+    std::cout << "threaded ct_mul: ok\n";
+}
+
+static void bench(std::mt19937_64& rng, const PubKey& pk) {
+    int B = pk.prm.B;
+    for (size_t n : {40, 400, 4000}) {
+        auto A = rand_edges(rng, B, 4, n, false);
+        auto Bv = rand_edges(rng, B, 4, n, false);
+
+        auto t0 = Clock::now();
+        auto r = mul_terms_ref(B, A, Bv, 4, 8);
+        auto t1 = Clock::now();
+        auto g = ct_mul_terms(pk, A, 4, Bv, 4, 8);
+        auto t2 = Clock::now();
+
+        std::cout << "4x4 layers, " << n << " edges each: hash map "
+                  << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms, buckets "
+                  << std::chrono::duration<double, std::milli>(t2 - t1).count() << " ms ("
+                  << r.size() << " / " << g.size() << " terms)\n";
+    }
+}
+
+int main() {
+    std::cout << "- mul engine test -\n";
+
+    std::mt19937_64 rng(0x6d756c);
+    PubKey pk;
+
+    test_poly(rng);
+    test_terms(rng, pk);
+    test_pool(rng, pk);
+    test_ct_mul_threads();
+    bench(rng, pk);
+
+    std::cout << "PASS\n";
+    return 0;
+}
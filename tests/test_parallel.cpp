@@ -0,0 +1,93 @@
+#include <pvac/core/parallel.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace pvac;
+
+int main() {
+    std::cout << "- thread pool test -\n";
+
+    for (int nt : {1, 2, 4, 7}) {
+        ThreadPool pool(nt);
+        assert(pool.size() == nt);
+
+        for (size_t n : {0u, 1u, 5u, 1000u, 100003u}) {
+            std::vector<uint8_t> hit(n, 0);
+            pool.parallel_for(n, [&](size_t i) { hit[i]++; }, 17);
+            for (size_t i = 0; i < n; ++i) assert(hit[i] == 1);
+        }
+
+        // nested calls run inline instead of deadlocking
+        std::atomic<uint64_t> sum{0};
+        pool.parallel_for(64, [&](size_t i) {
+            pool.parallel_for(10, [&](size_t j) { sum += i * 10 + j; });
+        });
+        assert(sum == 640ull * 639 / 2);
+
+        // several external threads sharing one pool
+        std::atomic<uint64_t> tot{0};
+        std::vector<std::thread> ext;
+        for (int t = 0; t < 3; ++t) {
+            ext.emplace_back([&] {
+                for (int r = 0; r < 20; ++r)
+                    pool.parallel_for(100, [&](size_t) { tot++; }, 3);
+            });
+        }
+        for (auto& t : ext) t.join();
+        assert(tot == 3 * 20 * 100);
+
+        // a caller that finds the pool busy runs inline instead of waiting
+        if (nt > 1) {
+            std::atomic<bool> started{false}, release{false};
+            std::thread hold([&] {
+                pool.parallel_for(nt, [&](size_t) {
+                    started = true;
+                    while (!release) std::this_thread::yield();
+                });
+            });
+            while (!started) std::this_thread::yield();
+            std::atomic<int> side{0};
+            pool.parallel_for(100, [&](size_t) { side++; });
+            assert(side == 100);
+            release = true;
+            hold.join();
+        }
+
+        std::cout << "threads = " << nt << ": ok\n";
+    }
+
+    std::atomic<int> cnt{0};
+    parallel_for(1000, [&](size_t) { cnt++; }, 8);
+    assert(cnt == 1000);
+    std::cout << "default pool (" << default_pool().size() << "): ok\n";
+
+    // a child of a process whose pools have run jobs: no workers there,
+    // jobs run inline, and the pools tear down without joining
+    ThreadPool four(4);
+    four.parallel_for(100, [&](size_t) { cnt++; });
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        std::atomic<int> c{0};
+        four.parallel_for(1000, [&](size_t) { c++; });
+        parallel_for(1000, [&](size_t) { c++; }, 8);
+        ThreadPool fresh(3);
+        fresh.parallel_for(1000, [&](size_t) { c++; });
+        std::exit(c == 3000 ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    std::cout << "fork: ok\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
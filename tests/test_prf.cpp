@@ -81,17 +81,66 @@ static bool test_prf_R_domains() {
     return hw > 40 && hw < 88;
 }
 
+// prf_R_core as it was: separate key derivations, row at a time lpn
+static Fp prf_R_core_ref(const PubKey& pk, const SecKey& sk, const RSeed& seed, const char* dom) {
+    std::vector<uint64_t> ybits;
+    lpn_make_ybits_ref(pk, sk, seed, dom, ybits);
+
+    uint8_t key[32];
+    uint64_t nonce;
+    derive_aes_key(pk, sk, seed, Dom::TOEP, key, nonce);
+
+    AesCtr256 prg;
+    prg.init(key, nonce ^ fnv1a_domain(dom));
+
+    std::vector<uint64_t> top(((size_t)pk.prm.lpn_t + 127u + 63u) / 64u);
+    prg.fill_u64(top.data(), top.size());
+
+    uint64_t lo = 0, hi = 0;
+    toep_127(top, ybits, lo, hi);
+    return hash_to_fp_nonzero(lo, hi);
+}
+
+static bool test_prf_R_multi() {
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    RSeed seed;
+    seed.ztag = csprng_u64();
+    seed.nonce = make_nonce128();
+
+    const char* doms[3] = {Dom::PRF_R1, Dom::PRF_R2, Dom::PRF_R3};
+    Fp ref[3];
+    for (int i = 0; i < 3; i++) ref[i] = prf_R_core_ref(pk, sk, seed, doms[i]);
+
+    Fp a[3], b[3];
+    ThreadPool pool(3);
+    prf_R_multi(pk, sk, seed, doms, 3, a);
+    prf_R_multi(pk, sk, seed, doms, 3, b, &pool);
+
+    for (int i = 0; i < 3; i++) {
+        if (!ct::fp_eq(a[i], ref[i]) || !ct::fp_eq(b[i], ref[i])) return false;
+    }
+
+    Fp r = prf_R(pk, sk, seed);
+    return ct::fp_eq(r, fp_mul(fp_mul(ref[0], ref[1]), ref[2]));
+}
+
 int main() {
     bool ok1 = test_sha256_abc();
     bool ok2 = test_xof_basic();
     bool ok3 = test_prf_R_domains();
+    bool ok4 = test_prf_R_multi();
 
     std::cout << "- prf/hash tests -\n";
     std::cout << "sha256(abc): " << (ok1 ? "ok" : "FAIL") << "\n";
     std::cout << "xof: " << (ok2 ? "ok" : "FAIL") << "\n";
     std::cout << "prf_R domains: " << (ok3 ? "ok" : "FAIL") << "\n";
+    std::cout << "prf_R_multi: " << (ok4 ? "ok" : "FAIL") << "\n";
 
-    bool all = ok1 && ok2 && ok3;
+    bool all = ok1 && ok2 && ok3 && ok4;
     std::cout << "\nresult: " << (all ? "PASS" : "FAIL") << "\n";
 
     return all ? 0 : 1;
@@ -0,0 +1,140 @@
+#include <pvac/pvac.hpp>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+static RSeed seed_n(uint64_t i) {
+    return RSeed{i * 7919, Nonce128{i, ~i}};
+}
+
+static double ms(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+static void test_clock() {
+    RCache rc(8);
+    Fp x;
+
+    assert(!rc.get(seed_n(1), x));
+    rc.put(seed_n(1), fp_from_u64(11));
+    assert(rc.get(seed_n(1), x) && x.lo == 11);
+    assert(rc.hits() == 1 && rc.misses() == 1);
+
+    // a key read between every insert survives a stream of cold keys
+    rc.put(seed_n(1000), fp_from_u64(1000));
+    for (uint64_t i = 2; i < 200; i++) {
+        assert(rc.get(seed_n(1000), x) && x.lo == 1000);
+        rc.put(seed_n(i), fp_from_u64(i));
+        assert(rc.size() <= rc.capacity());
+    }
+    assert(rc.size() == 8);
+    assert(rc.evictions() > 0);
+    assert(!rc.get(seed_n(2), x));
+    assert(rc.get(seed_n(199), x) && x.lo == 199);
+
+    // same nonce, other ztag is another key
+    RSeed s = seed_n(199);
+    s.ztag ^= 1;
+    assert(!rc.get(s, x));
+
+    rc.clear();
+    assert(rc.size() == 0 && !rc.get(seed_n(199), x));
+    std::cout << "clock eviction: ok\n";
+}
+
+int main() {
+    std::cout << "- R cache test -\n";
+    test_clock();
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    RCache rc(256);
+
+    Cipher a = enc_value(pk, sk, 12);
+    Cipher b = enc_value(pk, sk, 30);
+
+    assert(dec_value(pk, sk, a, &rc).lo == 12);
+    uint64_t m0 = rc.misses();
+    assert(m0 == a.L.size());
+    assert(dec_value(pk, sk, a, &rc).lo == 12);
+    assert(rc.misses() == m0 && rc.hits() == a.L.size());
+
+    // a's layers come back inside a sum and a product
+    Cipher s = ct_add(pk, a, b);
+    assert(dec_value(pk, sk, s, &rc).lo == 42);
+    assert(rc.misses() == m0 + b.L.size());
+    Cipher p = ct_mul(pk, a, b);
+    uint64_t h0 = rc.hits();
+    assert(dec_value(pk, sk, p, &rc).lo == 360);
+    assert(rc.hits() > h0);
+    std::cout << "dec through cache: ok\n";
+
+    // encrypting through the cache leaves the fresh layer's R in it
+    Cipher e = enc_fp_depth(pk, sk, fp_from_u64(5), 0, &rc);
+    uint64_t m1 = rc.misses();
+    assert(dec_value(pk, sk, e, &rc).lo == 5);
+    assert(rc.misses() == m1);
+    std::cout << "enc fills cache: ok\n";
+
+    // shared between threads
+    std::vector<std::thread> th;
+    std::vector<uint64_t> got(4, 0);
+    for (int t = 0; t < 4; t++) {
+        th.emplace_back([&, t] { got[t] = dec_value(pk, sk, t & 1 ? s : p, &rc).lo; });
+    }
+    for (auto& x : th) x.join();
+    for (int t = 0; t < 4; t++) assert(got[t] == (t & 1 ? 42u : 360u));
+    std::cout << "threads: ok\n";
+
+    // a second key pair through the same cache: same seeds, other R
+    PubKey pk2;
+    SecKey sk2;
+    keygen(prm, pk2, sk2);
+    assert(rcache_key_id(pk, sk) != rcache_key_id(pk2, sk2));
+    Fp r1 = prf_R_cached(pk, sk, a.L[0].seed, &rc);
+    Fp r2 = prf_R_cached(pk2, sk2, a.L[0].seed, &rc);
+    assert(ct::fp_eq(r1, prf_R(pk, sk, a.L[0].seed)));
+    assert(ct::fp_eq(r2, prf_R(pk2, sk2, a.L[0].seed)));
+    assert(!ct::fp_eq(r1, r2));
+    Cipher c2 = enc_value(pk2, sk2, 77);
+    assert(dec_value(pk2, sk2, c2, &rc).lo == 77);
+    assert(dec_value(pk, sk, a, &rc).lo == 12);
+    std::cout << "two key pairs: ok\n";
+
+    // same keys, other lpn stream: the entries above must not be reused
+    PubKey pk3 = pk;
+    pk3.prm.lpn_ver = 2;
+    assert(rcache_key_id(pk, sk) != rcache_key_id(pk3, sk));
+    Fp r3 = prf_R_cached(pk3, sk, a.L[0].seed, &rc);
+    assert(ct::fp_eq(r3, prf_R(pk3, sk, a.L[0].seed)));
+    assert(!ct::fp_eq(r3, r1));
+    PubKey pk4 = pk;
+    pk4.prm.lpn_tau_num = 2;
+    assert(rcache_key_id(pk, sk) != rcache_key_id(pk4, sk));
+    pk4 = pk;
+    pk4.prm.lpn_t += 64;
+    assert(rcache_key_id(pk, sk) != rcache_key_id(pk4, sk));
+    std::cout << "lpn params in key id: ok\n";
+
+    auto t0 = Clock::now();
+    Fp v0 = dec_value(pk, sk, s);
+    auto t1 = Clock::now();
+    Fp v1 = dec_value(pk, sk, s, &rc);
+    auto t2 = Clock::now();
+    assert(ct::fp_eq(v0, v1));
+    std::cout << "dec of a " << s.L.size() << " layer sum: " << ms(t0, t1) << " ms, cached "
+              << ms(t1, t2) << " ms (" << rc.hits() << " hits / " << rc.misses() << " misses)\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
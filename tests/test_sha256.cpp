@@ -0,0 +1,145 @@
+#include <pvac/pvac.hpp>
+
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+static std::string hex_of(const std::string& m) {
+    uint8_t d[32];
+    sha256_bytes(m.data(), m.size(), d);
+    return hex8(d, 32);
+}
+
+static void test_kat() {
+    assert(hex_of("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    assert(hex_of("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    assert(hex_of("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq")
+           == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    assert(hex_of(std::string(1000000, 'a'))
+           == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+    // same digest however the input is split up
+    std::string m(1000, 'x');
+    for (size_t i = 0; i < m.size(); i++) m[i] = (char)(i * 37 + 11);
+    uint8_t a[32], b[32];
+    sha256_bytes(m.data(), m.size(), a);
+    for (size_t step : {1, 7, 63, 64, 65, 200}) {
+        Sha256 s;
+        s.init();
+        for (size_t p = 0; p < m.size(); p += step) s.update(m.data() + p, std::min(step, m.size() - p));
+        s.finish(b);
+        assert(std::memcmp(a, b, 32) == 0);
+    }
+    std::cout << "kat (" << sha_impl_name() << "): ok\n";
+}
+
+static void test_shani_vs_scalar(std::mt19937_64& rng) {
+#if PVAC_USE_SHANI
+    if (!cpu_features().sha) {
+        std::cout << "sha-ni: skipped (no cpu support)\n";
+        return;
+    }
+    for (int it = 0; it < 200; it++) {
+        uint8_t blk[4 * 64];
+        for (auto& x : blk) x = (uint8_t)rng();
+        size_t nb = 1 + (size_t)(rng() % 4);
+
+        Sha256 s;
+        s.init();
+        for (auto& w : s.h) w = (uint32_t)rng();
+
+        uint32_t st[8];
+        std::memcpy(st, s.h, sizeof st);
+        Sha256::process_shani(st, blk, nb);
+        for (size_t b = 0; b < nb; b++) s.process_scalar(blk + 64 * b);
+
+        assert(std::memcmp(st, s.h, sizeof st) == 0);
+    }
+    std::cout << "sha-ni == scalar rounds: ok\n";
+#else
+    (void)rng;
+    std::cout << "sha-ni: not built\n";
+#endif
+}
+
+static void test_many(std::mt19937_64& rng) {
+    for (size_t len : {0, 1, 37, 55, 56, 63, 64, 100, 200}) {
+        for (size_t n : {1, 2, 3, 7, 8, 9, 17}) {
+            std::vector<uint8_t> data(len * n + 1);
+            for (auto& x : data) x = (uint8_t)rng();
+
+            std::vector<const uint8_t*> msg(n);
+            for (size_t i = 0; i < n; i++) msg[i] = data.data() + i * len;
+
+            std::vector<uint8_t> got(32 * n), want(32 * n);
+            sha256_many(msg.data(), len, (uint8_t (*)[32])got.data(), n);
+            for (size_t i = 0; i < n; i++) sha256_bytes(msg[i], len, want.data() + 32 * i);
+            assert(got == want);
+
+#if defined(__AVX2__)
+            if (n <= 8) {
+                std::vector<uint8_t> x8(32 * n);
+                sha256_x8(msg.data(), len, (uint8_t (*)[32])x8.data(), n);
+                assert(x8 == want);
+            }
+#endif
+        }
+    }
+
+    std::vector<Nonce128> nonces(37);
+    for (auto& nn : nonces) nn = {rng(), rng()};
+    std::vector<uint64_t> z(nonces.size());
+    prg_layer_ztags(0x1234, nonces.data(), z.data(), nonces.size());
+    for (size_t i = 0; i < nonces.size(); i++) assert(z[i] == prg_layer_ztag(0x1234, nonces[i]));
+
+    std::cout << "many (" << sha_many_impl_name() << ") / ztags: ok\n";
+}
+
+static void bench() {
+    const size_t N = 4096;
+    const size_t LEN = 37;
+
+    std::vector<uint8_t> data(N * LEN);
+    for (size_t i = 0; i < data.size(); i++) data[i] = (uint8_t)(i * 131 + 7);
+    std::vector<const uint8_t*> msg(N);
+    for (size_t i = 0; i < N; i++) msg[i] = data.data() + i * LEN;
+    std::vector<uint8_t> out(32 * N);
+
+    auto time_ns = [&](auto fn) {
+        fn();
+        auto t0 = Clock::now();
+        for (int r = 0; r < 10; r++) fn();
+        return std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / (10.0 * N);
+    };
+
+    double one = time_ns([&] {
+        for (size_t i = 0; i < N; i++) sha256_bytes(msg[i], LEN, out.data() + 32 * i);
+    });
+    double many = time_ns([&] {
+        sha256_many(msg.data(), LEN, (uint8_t (*)[32])out.data(), N);
+    });
+
+    std::cout << "37 byte msgs: one at a time " << one << " ns, sha256_many " << many << " ns\n";
+}
+
+int main() {
+    std::cout << "- sha256 test -\n";
+
+    std::mt19937_64 rng(0x5a256ull);
+
+    test_kat();
+    test_shani_vs_scalar(rng);
+    test_many(rng);
+    bench();
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <pvac/pvac.hpp>
+
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+int main() {
+    std::cout << "- sparse H test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    int n = pk.prm.n_bits;
+    int wt = pk.prm.h_col_wt;
+
+    assert(pk_has_sparse_H(pk));
+    assert(pk.H_colptr.size() == (size_t)n + 1);
+    assert(pk.H_rows.size() == (size_t)n * wt);
+
+    for (int c = 0; c < n; ++c) {
+        BitVec col = BitVec::make(pk.prm.m_bits);
+        for (uint32_t t = pk.H_colptr[c]; t < pk.H_colptr[c + 1]; ++t) {
+            uint16_t r = pk.H_rows[t];
+            col.w[r >> 6] |= 1ull << (r & 63);
+        }
+        assert(col.w == pk.H[c].w);
+    }
+    std::cout << "csr == dense: ok\n";
+
+    PubKey pk2 = pk;
+    pk2.H_colptr.clear();
+    pk2.H_rows.clear();
+    assert(!pk_has_sparse_H(pk2));
+    pk_build_sparse_H(pk2);
+    assert(pk2.H_colptr == pk.H_colptr);
+    assert(pk2.H_rows == pk.H_rows);
+    std::cout << "rebuild: ok\n";
+
+    size_t words = ((size_t)pk.prm.m_bits + 63) / 64;
+    double t_xor = 0, t_sc = 0;
+    const int R = 500;
+
+    for (int r = 0; r < R; ++r) {
+        auto cols = prg_choose_k(pk.prm.x_col_wt, n, Dom::X_SEED, {(uint64_t)r, 9}, pk.prm.sampler_ver);
+
+        std::vector<uint64_t> ref(words, 0), a(words, 0), b(words, 0);
+        for (int c : cols)
+            for (size_t i = 0; i < words; ++i) ref[i] ^= pk.H[c].w[i];
+
+        auto t0 = Clock::now();
+        sigma_accumulate_cols(pk, cols, a.data(), SigmaKernel::XOR);
+        auto t1 = Clock::now();
+        sigma_accumulate_cols(pk, cols, b.data(), SigmaKernel::SCATTER);
+        auto t2 = Clock::now();
+
+        assert(a == ref);
+        assert(b == ref);
+
+        t_xor += std::chrono::duration<double, std::micro>(t1 - t0).count();
+        t_sc += std::chrono::duration<double, std::micro>(t2 - t1).count();
+    }
+    std::cout << "kernels agree: ok\n";
+
+    size_t dense_b = pk.H.size() * words * 8;
+    size_t csr_b = pk.H_rows.size() * 2 + pk.H_colptr.size() * 4;
+    const char* pick = sigma_kernel_for(pk) == SigmaKernel::XOR ? "xor" : "scatter";
+
+    std::cout << "dense = " << (dense_b >> 20) << " MiB csr = " << (csr_b >> 20) << " MiB"
+              << " llc = " << (llc_bytes() >> 20) << " MiB pick = " << pick << "\n";
+    std::cout << "xor: " << t_xor / R << " us scatter: " << t_sc / R << " us\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include <pvac/pvac.hpp>
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+
+static std::string payload(size_t n, uint64_t seed) {
+    std::string s(n, '\0');
+    for (size_t i = 0; i < n; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        s[i] = (char)(seed >> 56);
+    }
+    return s;
+}
+
+static std::string enc_str(const PubKey& pk, const SecKey& sk, const std::string& msg, size_t window) {
+    std::istringstream in(msg);
+    std::ostringstream out;
+    bool ok = enc_stream(pk, sk, in, out, 2, window);
+    assert(ok);
+    return out.str();
+}
+
+static bool dec_str(const PubKey& pk, const SecKey& sk, const std::string& ct, std::string& msg, size_t window) {
+    std::istringstream in(ct);
+    std::ostringstream out;
+    bool ok = dec_stream(pk, sk, in, out, window);
+    msg = out.str();
+    return ok;
+}
+
+int main() {
+    std::cout << "- stream codec test -\n";
+
+    Params prm;
+    PubKey pk;
+    SecKey sk;
+    keygen(prm, pk, sk);
+
+    // block edges, zero bytes inside and at the end, windows of 1 and more
+    for (size_t n : {0, 1, 14, 15, 16, 30, 31, 100}) {
+        std::string msg = payload(n, n);
+        if (n > 3) msg[n - 1] = msg[n / 2] = '\0';
+        for (size_t window : {1, 3, 64}) {
+            std::string ct = enc_str(pk, sk, msg, window);
+            std::string back;
+            assert(dec_str(pk, sk, ct, back, window == 1 ? 5 : 1));
+            assert(back == msg);
+        }
+    }
+    std::cout << "round trip: ok\n";
+
+    // writer fed in odd sized chunks, reader drained a few bytes at a time
+    std::string msg = payload(700, 9);
+    std::ostringstream out;
+    EncStreamWriter w(pk, sk, out, 2, 8);
+    for (size_t pos = 0; pos < msg.size(); pos += 37) w.write(msg.data() + pos, std::min<size_t>(37, msg.size() - pos));
+    assert(w.finish());
+    assert(w.bytes() == 700 && w.blocks() == 47);
+
+    std::istringstream in(out.str());
+    DecStreamReader r(pk, sk, in, 4);
+    std::string back;
+    char buf[11];
+    size_t n;
+    while ((n = r.read(buf, sizeof(buf))) > 0) back.append(buf, n);
+    assert(r.ok() && r.eof() && back == msg);
+    std::cout << "chunked: ok\n";
+
+    // every block at the same depth, so frames stay the same size
+    std::string ct = out.str();
+    std::cout << "700 bytes -> " << ct.size() << " bytes of frames\n";
+
+    // truncated, damaged, or read with another key
+    std::string bad;
+    assert(!dec_str(pk, sk, ct.substr(0, ct.size() - 1), bad, 4));
+    assert(!dec_str(pk, sk, ct.substr(0, 16), bad, 4));
+    std::string flip = ct;
+    flip[3] ^= 1;
+    assert(!dec_str(pk, sk, flip, bad, 4) && bad.empty());
+    flip = ct;
+    flip[16 + 8 + 4] ^= 0x7f;
+    assert(!dec_str(pk, sk, flip, bad, 4));
+
+    // layers whose parents are not behind them never get to decryption
+    for (uint32_t pa : {0u, 1u, 2u}) {
+        SnapWriter fw;
+        fw.u32(2);
+        fw.u32(0);
+        fw.u32((uint32_t)RRule::BASE);
+        fw.u64(1);
+        fw.u64(2);
+        fw.u64(3);
+        fw.u32((uint32_t)RRule::PROD);
+        fw.u32(pa);
+        fw.u32(0);
+        SnapReader fr{fw.b.data(), fw.b.size()};
+        Cipher fc;
+        assert(get_cipher(fr, pk, fc) == (pa == 0));
+    }
+
+    // tags catch what decryption cannot see: a sigma bit, frames out of
+    // order, a stream cut at a frame boundary
+    size_t f0 = 16 + Stream::ID, len0 = (size_t)load_le64((const uint8_t*)ct.data() + f0);
+    size_t f1 = f0 + 8 + len0 + Stream::TAG;
+    flip = ct;
+    flip[f1 - Stream::TAG - 1] ^= 1;
+    assert(!dec_str(pk, sk, flip, bad, 4));
+    std::string swapped = ct.substr(0, f0) + ct.substr(f1, f1 - f0) + ct.substr(f0, f1 - f0) + ct.substr(2 * f1 - f0);
+    assert(swapped.size() == ct.size());
+    assert(!dec_str(pk, sk, swapped, bad, 4));
+    std::string cut = ct.substr(0, f1) + ct.substr(ct.size() - 8 - Stream::TAG);
+    assert(!dec_str(pk, sk, cut, bad, 4));
+
+    PubKey pk2;
+    SecKey sk2;
+    keygen(prm, pk2, sk2);
+    assert(!dec_str(pk2, sk2, ct, bad, 4));
+    std::cout << "rejects bad input: ok\n";
+
+    std::cout << "PASS\n";
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include <pvac/pvac.hpp>
+
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+
+using namespace pvac;
+using Clock = std::chrono::steady_clock;
+
+using Vec = std::vector<uint64_t>;
+
+static Vec rand_words(size_t n, std::mt19937_64& rng) {
+    Vec v(n);
+    for (auto& x : v) x = rng();
+    return v;
+}
+
+static void check_same(const Vec& top, const Vec& y) {
+    uint64_t lo, hi, l2, h2;
+    toep_127_scalar(top, y, lo, hi);
+
+    toep_127_trunc_scalar(top, y, l2, h2);
+    assert(l2 == lo && h2 == hi);
+
+#if defined(__PCLMUL__)
+    toep_127_clmul(top, y, l2, h2);
+    assert(l2 == lo && h2 == hi);
+
+    toep_127_trunc_clmul(top, y, l2, h2);
+    assert(l2 == lo && h2 == hi);
+#endif
+
+    toep_127(top, y, l2, h2);
+    assert(l2 == lo && h2 == hi);
+}
+
+template <class F>
+static double time_us(F fn, int reps) {
+    fn();
+    auto t0 = Clock::now();
+    for (int i = 0; i < reps; i++) fn();
+    return std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / reps;
+}
+
+int main() {
+    std::cout << "- toeplitz test -\n";
+
+    std::mt19937_64 rng(0x70e91177ull);
+
+    // prf_R shapes: lpn_t = 16384 gives 256 y words, 258 top words
+    for (int i = 0; i < 20; i++) check_same(rand_words(258, rng), rand_words(256, rng));
+
+    // short and empty operands (the full kernels need two product words)
+    for (size_t a = 0; a <= 4; a++) {
+        for (size_t b = 0; b <= 4; b++) {
+            if (a + b >= 2) check_same(rand_words(a, rng), rand_words(b, rng));
+        }
+    }
+
+    // sparse words, high bits set
+    check_same({~0ull, ~0ull, 1}, {~0ull, 1ull << 63});
+    check_same({1ull << 63, 0, 0}, {0, ~0ull});
+    std::cout << "truncated == full convolution: ok\n";
+
+    Vec top = rand_words(258, rng);
+    Vec y = rand_words(256, rng);
+    uint64_t lo, hi, sink = 0;
+
+#if defined(__PCLMUL__)
+    double full = time_us([&] { toep_127_clmul(top, y, lo, hi); sink ^= lo; }, 20);
+    double trunc = time_us([&] { toep_127_trunc_clmul(top, y, lo, hi); sink ^= lo; }, 100000);
+    std::cout << "clmul full: " << full << " us  truncated: " << trunc * 1000.0 << " ns\n";
+#endif
+    double sc = time_us([&] { toep_127_trunc_scalar(top, y, lo, hi); sink ^= lo; }, 100000);
+    std::cout << "scalar truncated: " << sc * 1000.0 << " ns\n";
+
+    volatile uint64_t v = sink;
+    (void)v;
+
+    std::cout << "PASS\n";
+    return 0;
+}